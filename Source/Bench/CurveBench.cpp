@@ -0,0 +1,683 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+/*
+    curve_bench: drives the processing engine with fixed buffers over a matrix of
+    block sizes, sample rates, channel counts and precisions, and reports the time
+    per sample, the callback time percentiles, and the heap allocations made during
+    the measured callbacks, as JSON.
+
+        curve_bench [--preset=file.filtergraph | --synthetic=<chains>x<length>]
+                    [--block-sizes=64,256,1024] [--rates=44100,48000,96000]
+                    [--channels=2,8] [--precisions=float,double] [--callbacks=n]
+                    [--output=results.json] [--baseline=results.json] [--tolerance=percent]
+
+    The graph runs through the same GraphRenderEngine and HostedPluginInstance
+    wrapper as in the app. The synthetic graph is a number of parallel chains of
+    small biquad filters. Given a baseline from an earlier run, every configuration
+    in both is compared, and the exit code is 1 if any got slower by more than the
+    tolerance or started allocating.
+*/
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <vector>
+#include "../Plugins/GraphRenderEngine.h"
+#include "../Plugins/HostedPluginInstance.h"
+
+#if JUCE_MAC
+ #include <malloc/malloc.h>
+ #include <mach/mach.h>
+#elif JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+//==============================================================================
+// Every allocation made anywhere in the process while a measured callback runs.
+//
+// On Linux with glibc, malloc, calloc, realloc and the aligned allocators are replaced for the
+// whole process, so HeapBlock, plugins' own malloc calls and new all count. On macOS the default
+// malloc zone's functions are wrapped, which catches the same. Elsewhere only the operator new and
+// delete replacements below count, so memory taken straight from malloc (HeapBlock, C libraries)
+// goes unseen. Nowhere are valloc, pvalloc, other malloc zones or mmap counted.
+static std::atomic<bool> countingAllocations { false };
+static std::atomic<int64> numAllocations { 0 };
+
+static void countAllocation() noexcept
+{
+    if (countingAllocations.load (std::memory_order_relaxed))
+        numAllocations.fetch_add (1, std::memory_order_relaxed);
+}
+
+#if JUCE_LINUX && defined (__GLIBC__)
+ static constexpr bool isMallocCounted = true;
+
+ // glibc's own entry points, for the replacements to hand on to
+ extern "C" void* __libc_malloc (size_t);
+ extern "C" void* __libc_calloc (size_t, size_t);
+ extern "C" void* __libc_realloc (void*, size_t);
+ extern "C" void* __libc_memalign (size_t, size_t);
+
+ extern "C" void* malloc (size_t size) noexcept                    { countAllocation(); return __libc_malloc (size); }
+ extern "C" void* calloc (size_t num, size_t size) noexcept        { countAllocation(); return __libc_calloc (num, size); }
+ extern "C" void* realloc (void* p, size_t size) noexcept          { countAllocation(); return __libc_realloc (p, size); }
+ extern "C" void* memalign (size_t alignment, size_t size) noexcept { countAllocation(); return __libc_memalign (alignment, size); }
+ extern "C" void* aligned_alloc (size_t alignment, size_t size) noexcept { return memalign (alignment, size); }
+
+ extern "C" int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+ {
+     if (alignment % sizeof (void*) != 0 || ! isPowerOfTwo (alignment))
+         return EINVAL;
+
+     *result = memalign (alignment, size);
+     return *result != nullptr ? 0 : ENOMEM;
+ }
+
+ static void installAllocationCounter() {}
+#elif JUCE_MAC
+ static constexpr bool isMallocCounted = true;
+
+ static malloc_zone_t originalZone;
+
+ static void* countingMalloc (malloc_zone_t* zone, size_t size)                      { countAllocation(); return originalZone.malloc (zone, size); }
+ static void* countingCalloc (malloc_zone_t* zone, size_t num, size_t size)          { countAllocation(); return originalZone.calloc (zone, num, size); }
+ static void* countingRealloc (malloc_zone_t* zone, void* p, size_t size)            { countAllocation(); return originalZone.realloc (zone, p, size); }
+ static void* countingMemalign (malloc_zone_t* zone, size_t alignment, size_t size)  { countAllocation(); return originalZone.memalign (zone, alignment, size); }
+
+ // the zone's function table is read-only, so it's unprotected just long enough to wrap it
+ static void installAllocationCounter()
+ {
+     auto* zone = malloc_default_zone();
+     originalZone = *zone;
+
+     const auto address = (vm_address_t) zone & ~(vm_address_t) (vm_page_size - 1);
+     const auto length = (vm_size_t) ((vm_address_t) zone + sizeof (malloc_zone_t) - address);
+
+     if (vm_protect (mach_task_self(), address, length, false, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS)
+     {
+         std::cerr << "Couldn't wrap the malloc zone; only operator new will be counted" << std::endl;
+         return;
+     }
+
+     zone->malloc = countingMalloc;
+     zone->calloc = countingCalloc;
+     zone->realloc = countingRealloc;
+
+     if (zone->version >= 5 && zone->memalign != nullptr)
+         zone->memalign = countingMemalign;
+
+     vm_protect (mach_task_self(), address, length, false, VM_PROT_READ);
+ }
+#else
+ static constexpr bool isMallocCounted = false;
+
+ static void installAllocationCounter() {}
+#endif
+
+static void* allocate (std::size_t size, std::size_t alignment, bool throwOnFailure)
+{
+    // with malloc counted, counting here too would count every new twice
+    if (! isMallocCounted)
+        countAllocation();
+
+    size = size == 0 ? 1 : size;
+
+   #if JUCE_WINDOWS
+    auto* p = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? _aligned_malloc (size, alignment) : std::malloc (size);
+   #else
+    void* p = nullptr;
+
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        p = std::malloc (size);
+    else if (posix_memalign (&p, alignment, size) != 0)
+        p = nullptr;
+   #endif
+
+    if (p == nullptr && throwOnFailure)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+static void deallocate (void* p, std::size_t alignment) noexcept
+{
+   #if JUCE_WINDOWS
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return _aligned_free (p);
+   #else
+    ignoreUnused (alignment);
+   #endif
+
+    std::free (p);
+}
+
+static constexpr std::size_t defaultAlignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* operator new (std::size_t size)                                                       { return allocate (size, defaultAlignment, true); }
+void* operator new[] (std::size_t size)                                                     { return allocate (size, defaultAlignment, true); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept                       { return allocate (size, defaultAlignment, false); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept                     { return allocate (size, defaultAlignment, false); }
+void* operator new (std::size_t size, std::align_val_t a)                                   { return allocate (size, (std::size_t) a, true); }
+void* operator new[] (std::size_t size, std::align_val_t a)                                 { return allocate (size, (std::size_t) a, true); }
+void* operator new (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept   { return allocate (size, (std::size_t) a, false); }
+void* operator new[] (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate (size, (std::size_t) a, false); }
+
+void operator delete (void* p) noexcept                                                     { deallocate (p, defaultAlignment); }
+void operator delete[] (void* p) noexcept                                                   { deallocate (p, defaultAlignment); }
+void operator delete (void* p, std::size_t) noexcept                                        { deallocate (p, defaultAlignment); }
+void operator delete[] (void* p, std::size_t) noexcept                                      { deallocate (p, defaultAlignment); }
+void operator delete (void* p, const std::nothrow_t&) noexcept                              { deallocate (p, defaultAlignment); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept                            { deallocate (p, defaultAlignment); }
+void operator delete (void* p, std::align_val_t a) noexcept                                 { deallocate (p, (std::size_t) a); }
+void operator delete[] (void* p, std::align_val_t a) noexcept                               { deallocate (p, (std::size_t) a); }
+void operator delete (void* p, std::size_t, std::align_val_t a) noexcept                    { deallocate (p, (std::size_t) a); }
+void operator delete[] (void* p, std::size_t, std::align_val_t a) noexcept                  { deallocate (p, (std::size_t) a); }
+void operator delete (void* p, std::align_val_t a, const std::nothrow_t&) noexcept          { deallocate (p, (std::size_t) a); }
+void operator delete[] (void* p, std::align_val_t a, const std::nothrow_t&) noexcept        { deallocate (p, (std::size_t) a); }
+
+//==============================================================================
+/** A small, steady load for the synthetic graph: a biquad low-pass per channel. */
+class SyntheticLoad final : public AudioPluginInstance
+{
+public:
+    SyntheticLoad()
+        : AudioPluginInstance (BusesProperties().withInput  ("Input",  AudioChannelSet::stereo())
+                                                .withOutput ("Output", AudioChannelSet::stereo()))
+    {
+    }
+
+    const String getName() const override                   { return "Synthetic Load"; }
+
+    void fillInPluginDescription (PluginDescription& d) const override
+    {
+        d.name = d.descriptiveName = d.fileOrIdentifier = getName();
+        d.pluginFormatName = "Bench";
+        d.numInputChannels = d.numOutputChannels = 2;
+    }
+
+    void prepareToPlay (double sampleRate, int) override
+    {
+        // RBJ low-pass at 5 kHz, Q 0.707
+        const auto w = MathConstants<double>::twoPi * 5000.0 / sampleRate;
+        const auto alpha = std::sin (w) / (2.0 * 0.707);
+        const auto a0 = 1.0 + alpha;
+
+        b0 = (1.0 - std::cos (w)) / 2.0 / a0;
+        b1 = (1.0 - std::cos (w)) / a0;
+        b2 = b0;
+        a1 = -2.0 * std::cos (w) / a0;
+        a2 = (1.0 - alpha) / a0;
+
+        reset();
+    }
+
+    void reset() override
+    {
+        for (auto& s : state)
+            s = {};
+    }
+
+    void releaseResources() override {}
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override   { process (buffer); }
+    void processBlock (AudioBuffer<double>& buffer, MidiBuffer&) override  { process (buffer); }
+    bool supportsDoublePrecisionProcessing() const override                { return true; }
+
+    bool isBusesLayoutSupported (const BusesLayout& layout) const override
+    {
+        return layout.getMainInputChannels() == layout.getMainOutputChannels()
+            && layout.getMainOutputChannels() <= maxChannels;
+    }
+
+    double getTailLengthSeconds() const override            { return 0.0; }
+    bool acceptsMidi() const override                       { return false; }
+    bool producesMidi() const override                      { return false; }
+    AudioProcessorEditor* createEditor() override           { return nullptr; }
+    bool hasEditor() const override                         { return false; }
+    int getNumPrograms() override                           { return 1; }
+    int getCurrentProgram() override                        { return 0; }
+    void setCurrentProgram (int) override                   {}
+    const String getProgramName (int) override              { return {}; }
+    void changeProgramName (int, const String&) override    {}
+    void getStateInformation (MemoryBlock&) override        {}
+    void setStateInformation (const void*, int) override    {}
+
+private:
+    static constexpr int maxChannels = 64;
+
+    struct State { double z1 = 0.0, z2 = 0.0; };
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& buffer)
+    {
+        for (int ch = 0; ch < jmin (maxChannels, buffer.getNumChannels()); ++ch)
+        {
+            auto* data = buffer.getWritePointer (ch);
+            auto& s = state[(size_t) ch];
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                const auto in = (double) data[i];
+                const auto out = b0 * in + s.z1;
+                s.z1 = b1 * in - a1 * out + s.z2;
+                s.z2 = b2 * in - a2 * out;
+                data[i] = (SampleType) out;
+            }
+        }
+    }
+
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    std::array<State, maxChannels> state;
+};
+
+//==============================================================================
+using NodeID = AudioProcessorGraph::NodeID;
+using IOProcessor = AudioProcessorGraph::AudioGraphIOProcessor;
+
+static void buildSyntheticGraph (AudioProcessorGraph& graph, int numChains, int chainLength, int numChannels)
+{
+    graph.clear();
+
+    const auto input  = graph.addNode (std::make_unique<IOProcessor> (IOProcessor::audioInputNode))->nodeID;
+    const auto output = graph.addNode (std::make_unique<IOProcessor> (IOProcessor::audioOutputNode))->nodeID;
+
+    for (int chain = 0; chain < numChains; ++chain)
+    {
+        auto previous = input;
+
+        for (int i = 0; i < chainLength; ++i)
+        {
+            auto load = std::make_unique<SyntheticLoad>();
+            load->setPlayConfigDetails (numChannels, numChannels, 48000.0, 512);
+
+            auto hosted = std::make_unique<HostedPluginInstance> (std::move (load));
+            const auto node = graph.addNode (std::move (hosted))->nodeID;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                graph.addConnection ({ { previous, ch }, { node, ch } });
+
+            previous = node;
+        }
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            graph.addConnection ({ { previous, ch }, { output, ch } });
+    }
+}
+
+// the same format PluginGraph saves; Curve's internal nodes are only the graph's own IO
+static Result loadPreset (AudioProcessorGraph& graph, AudioPluginFormatManager& formats, const File& file,
+                          double& processingRate, int& maxBlockSize)
+{
+    auto xml = parseXMLIfTagMatches (file, "FILTERGRAPH");
+
+    if (xml == nullptr)
+        return Result::fail ("Not a valid graph file");
+
+    graph.clear();
+    processingRate = xml->getDoubleAttribute ("processingRate", 0.0);
+    maxBlockSize = jmax (0, xml->getIntAttribute ("maxBlockSize"));
+
+    for (auto* e : xml->getChildWithTagNameIterator ("FILTER"))
+    {
+        PluginDescription description;
+
+        for (auto* child : e->getChildIterator())
+            if (description.loadFromXml (*child))
+                break;
+
+        std::unique_ptr<AudioProcessor> processor;
+
+        if (description.pluginFormatName == "Internal")
+        {
+            static const std::pair<const char*, IOProcessor::IODeviceType> ioTypes[] {
+                { "Audio Input",  IOProcessor::audioInputNode },
+                { "Audio Output", IOProcessor::audioOutputNode },
+                { "Midi Input",   IOProcessor::midiInputNode },
+                { "Midi Output",  IOProcessor::midiOutputNode }
+            };
+
+            for (auto& [name, type] : ioTypes)
+                if (description.name == name)
+                    processor = std::make_unique<IOProcessor> (type);
+        }
+        else
+        {
+            // sandboxed plugins run in-process here; the sandbox transport has its own benchmark
+            String error;
+
+            if (auto instance = formats.createPluginInstance (description, 48000.0, 512, error))
+            {
+                auto hosted = std::make_unique<HostedPluginInstance> (std::move (instance));
+                hosted->setBlockSizeOptions (e->getIntAttribute ("fixedBlockSize"), e->getIntAttribute ("maxBlockSize"));
+                hosted->setPrecisionPreference (HostedPluginInstance::precisionPreferenceFromString (e->getStringAttribute ("precision", "auto")));
+                hosted->setDenormalsAllowed (e->getBoolAttribute ("allowDenormals"));
+                processor = std::move (hosted);
+            }
+            else
+            {
+                return Result::fail ("Couldn't load " + description.name + ": " + error);
+            }
+        }
+
+        if (processor == nullptr)
+            return Result::fail ("Unknown internal node " + description.name.quoted());
+
+        if (auto node = graph.addNode (std::move (processor), NodeID ((uint32) e->getIntAttribute ("uid"))))
+        {
+            if (auto* state = e->getChildByName ("STATE"))
+            {
+                MemoryBlock m;
+                m.fromBase64Encoding (state->getAllSubText());
+                node->getProcessor()->setStateInformation (m.getData(), (int) m.getSize());
+            }
+        }
+    }
+
+    for (auto* e : xml->getChildWithTagNameIterator ("CONNECTION"))
+        graph.addConnection ({ { NodeID ((uint32) e->getIntAttribute ("srcFilter")), e->getIntAttribute ("srcChannel") },
+                               { NodeID ((uint32) e->getIntAttribute ("dstFilter")), e->getIntAttribute ("dstChannel") } });
+
+    graph.removeIllegalConnections();
+    return Result::ok();
+}
+
+//==============================================================================
+struct Config
+{
+    int blockSize;
+    double sampleRate;
+    int numChannels;
+    bool isDouble;
+
+    String getKey() const
+    {
+        return String (blockSize) + "/" + String (roundToInt (sampleRate)) + "/" + String (numChannels) + "/" + (isDouble ? "double" : "float");
+    }
+};
+
+struct Measurement
+{
+    double nsPerSample = 0.0, p50Us = 0.0, p99Us = 0.0, p999Us = 0.0, maxUs = 0.0;
+    int64 allocations = 0;
+};
+
+template <typename SampleType>
+static Measurement measure (GraphRenderEngine& engine, const Config& config, int numCallbacks)
+{
+    constexpr int numWarmUpCallbacks = 200;
+
+    // the same noise every run, so that runs are comparable
+    AudioBuffer<SampleType> source (config.numChannels, config.blockSize), buffer (config.numChannels, config.blockSize);
+    Random random (1234);
+
+    for (int ch = 0; ch < config.numChannels; ++ch)
+        for (int i = 0; i < config.blockSize; ++i)
+            source.setSample (ch, i, (SampleType) (random.nextFloat() * 0.5f - 0.25f));
+
+    MidiBuffer midi;
+    std::vector<double> callbackNs;
+    callbackNs.reserve ((size_t) numCallbacks);
+
+    const auto nsPerTick = 1.0e9 / (double) Time::getHighResolutionTicksPerSecond();
+
+    for (int i = -numWarmUpCallbacks; i < numCallbacks; ++i)
+    {
+        buffer.makeCopyOf (source, true);
+        midi.clear();
+
+        if (i == 0)
+        {
+            numAllocations = 0;
+            countingAllocations = true;
+        }
+
+        const auto start = Time::getHighResolutionTicks();
+        engine.processBlock (buffer, midi);
+        const auto end = Time::getHighResolutionTicks();
+
+        if (i >= 0)
+            callbackNs.push_back ((double) (end - start) * nsPerTick);
+    }
+
+    countingAllocations = false;
+
+    Measurement m;
+    m.allocations = numAllocations.load();
+
+    double totalNs = 0.0;
+
+    for (auto ns : callbackNs)
+        totalNs += ns;
+
+    std::sort (callbackNs.begin(), callbackNs.end());
+
+    auto percentileUs = [&] (double p)
+    {
+        return callbackNs[jmin (callbackNs.size() - 1, (size_t) ((double) callbackNs.size() * p))] / 1000.0;
+    };
+
+    m.nsPerSample = totalNs / ((double) numCallbacks * config.blockSize);
+    m.p50Us  = percentileUs (0.5);
+    m.p99Us  = percentileUs (0.99);
+    m.p999Us = percentileUs (0.999);
+    m.maxUs  = callbackNs.back() / 1000.0;
+    return m;
+}
+
+//==============================================================================
+static Array<int> parseInts (const String& list, Array<int> defaults)
+{
+    if (list.isEmpty())
+        return defaults;
+
+    Array<int> values;
+
+    for (auto& s : StringArray::fromTokens (list, ",", {}))
+        if (s.getIntValue() > 0)
+            values.add (s.getIntValue());
+
+    return values;
+}
+
+// compares against a baseline's results, and returns the number of configurations that regressed
+static int compareWithBaseline (const var& results, const var& baseline, double tolerancePercent)
+{
+    std::map<String, const DynamicObject*> previous;
+
+    if (auto* list = baseline["results"].getArray())
+        for (auto& r : *list)
+            if (auto* o = r.getDynamicObject())
+                previous[o->getProperty ("config").toString()] = o;
+
+    int numRegressions = 0;
+
+    std::cerr << "config                        ns/sample  baseline   change   p99 us  baseline   change" << std::endl;
+
+    for (auto& r : *results.getArray())
+    {
+        auto* now = r.getDynamicObject();
+        const auto key = now->getProperty ("config").toString();
+        auto it = previous.find (key);
+
+        if (it == previous.end())
+            continue;
+
+        auto change = [&] (const char* property)
+        {
+            const auto before = (double) it->second->getProperty (property);
+            return before > 0.0 ? 100.0 * ((double) now->getProperty (property) - before) / before : 0.0;
+        };
+
+        const auto timeChange = change ("nsPerSample");
+        const auto p99Change = change ("p99Us");
+        const auto startedAllocating = (int64) now->getProperty ("allocations") > 0 && (int64) it->second->getProperty ("allocations") == 0;
+        const auto regressed = timeChange > tolerancePercent || p99Change > tolerancePercent || startedAllocating;
+
+        if (regressed)
+            ++numRegressions;
+
+        std::cerr << key.paddedRight (' ', 26)
+                  << String ((double) now->getProperty ("nsPerSample"), 2).paddedLeft (' ', 13)
+                  << String ((double) it->second->getProperty ("nsPerSample"), 2).paddedLeft (' ', 10)
+                  << (String (timeChange, 1) + "%").paddedLeft (' ', 9)
+                  << String ((double) now->getProperty ("p99Us"), 1).paddedLeft (' ', 9)
+                  << String ((double) it->second->getProperty ("p99Us"), 1).paddedLeft (' ', 10)
+                  << (String (p99Change, 1) + "%").paddedLeft (' ', 9)
+                  << (regressed ? (startedAllocating ? "  REGRESSED (allocates)" : "  REGRESSED") : "") << std::endl;
+    }
+
+    return numRegressions;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    installAllocationCounter();
+
+    const ScopedJuceInitialiser_GUI juceInitialiser;
+    const ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cerr << "curve_bench [--preset=file.filtergraph | --synthetic=4x8] [--block-sizes=64,256,1024] [--rates=44100,48000,96000]" << std::endl
+                  << "            [--channels=2,8] [--precisions=float,double] [--callbacks=n] [--output=file] [--baseline=file] [--tolerance=10]" << std::endl;
+        return 0;
+    }
+
+    const auto blockSizes  = parseInts (args.getValueForOption ("--block-sizes"), { 64, 256, 1024 });
+    const auto rates       = parseInts (args.getValueForOption ("--rates"), { 44100, 48000, 96000 });
+    const auto channels    = parseInts (args.getValueForOption ("--channels"), { 2, 8 });
+    const auto precisions  = StringArray::fromTokens (args.containsOption ("--precisions") ? args.getValueForOption ("--precisions") : "float,double", ",", {});
+    const auto numCallbacks = jmax (100, args.containsOption ("--callbacks") ? args.getValueForOption ("--callbacks").getIntValue() : 2000);
+    const auto presetPath  = args.getValueForOption ("--preset");
+
+    AudioPluginFormatManager formats;
+    addDefaultFormatsToManager (formats);
+
+    AudioProcessorGraph graph;
+    GraphRenderEngine engine (graph);
+    String graphName;
+
+    if (presetPath.isNotEmpty())
+    {
+        double processingRate = 0.0;
+        int maxBlockSize = 0;
+        const auto file = File::getCurrentWorkingDirectory().getChildFile (presetPath);
+        const auto result = loadPreset (graph, formats, file, processingRate, maxBlockSize);
+
+        if (result.failed())
+        {
+            std::cerr << file.getFullPathName() << ": " << result.getErrorMessage() << std::endl;
+            return 2;
+        }
+
+        engine.setProcessingRate (processingRate);
+        engine.setMaxGraphBlockSize (maxBlockSize);
+        graphName = file.getFileName();
+    }
+
+    const auto synthetic = args.containsOption ("--synthetic") ? args.getValueForOption ("--synthetic") : String ("4x8");
+    const auto numChains = jmax (1, synthetic.upToFirstOccurrenceOf ("x", false, true).getIntValue());
+    const auto chainLength = jmax (1, synthetic.fromFirstOccurrenceOf ("x", false, true).getIntValue());
+
+    if (graphName.isEmpty())
+        graphName = "synthetic " + String (numChains) + "x" + String (chainLength);
+
+    Array<var> results;
+
+    for (auto numChannels : channels)
+    {
+        // the synthetic nodes' buses follow the channel count
+        if (presetPath.isEmpty())
+            buildSyntheticGraph (graph, numChains, chainLength, numChannels);
+
+        for (auto& precision : precisions)
+        {
+            for (auto rate : rates)
+            {
+                for (auto blockSize : blockSizes)
+                {
+                    const Config config { blockSize, (double) rate, numChannels, precision.trim() == "double" };
+
+                    engine.releaseGraph();
+                    engine.setProcessingPrecision (config.isDouble ? AudioProcessor::doublePrecision : AudioProcessor::singlePrecision);
+                    engine.setPlayConfigDetails (numChannels, numChannels, config.sampleRate, blockSize);
+                    engine.prepareToPlay (config.sampleRate, blockSize);
+
+                    const auto m = config.isDouble ? measure<double> (engine, config, numCallbacks)
+                                                   : measure<float>  (engine, config, numCallbacks);
+
+                    std::cerr << config.getKey().paddedRight (' ', 26) << String (m.nsPerSample, 2) << " ns/sample, p99 "
+                              << String (m.p99Us, 1) << " us, " << m.allocations << " allocations" << std::endl;
+
+                    auto* o = new DynamicObject();
+                    o->setProperty ("config", config.getKey());
+                    o->setProperty ("blockSize", blockSize);
+                    o->setProperty ("sampleRate", rate);
+                    o->setProperty ("channels", numChannels);
+                    o->setProperty ("precision", config.isDouble ? "double" : "float");
+                    o->setProperty ("nsPerSample", m.nsPerSample);
+                    o->setProperty ("p50Us", m.p50Us);
+                    o->setProperty ("p99Us", m.p99Us);
+                    o->setProperty ("p999Us", m.p999Us);
+                    o->setProperty ("maxUs", m.maxUs);
+                    o->setProperty ("allocations", m.allocations);
+                    results.add (var (o));
+                }
+            }
+        }
+    }
+
+    engine.releaseGraph();
+
+    auto* root = new DynamicObject();
+    root->setProperty ("version", 1);
+    root->setProperty ("graph", graphName);
+    root->setProperty ("callbacks", numCallbacks);
+    root->setProperty ("cpu", SystemStats::getCpuModel());
+    root->setProperty ("results", results);
+
+    const var json (root);
+    const auto text = JSON::toString (json);
+
+    if (args.containsOption ("--output"))
+        File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output")).replaceWithText (text);
+    else
+        std::cout << text << std::endl;
+
+    if (! args.containsOption ("--baseline"))
+        return 0;
+
+    const auto baselineFile = File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--baseline"));
+    const auto baseline = JSON::parse (baselineFile);
+
+    if (! baseline.isObject())
+    {
+        std::cerr << "Couldn't read the baseline " << baselineFile.getFullPathName() << std::endl;
+        return 2;
+    }
+
+    const auto tolerance = args.containsOption ("--tolerance") ? args.getValueForOption ("--tolerance").getDoubleValue() : 10.0;
+    const auto numRegressions = compareWithBaseline (root->getProperty ("results"), baseline, tolerance);
+
+    if (numRegressions > 0)
+        std::cerr << numRegressions << " configuration(s) regressed by more than " << tolerance << "%" << std::endl;
+
+    return numRegressions > 0 ? 1 : 0;
+}
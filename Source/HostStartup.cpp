@@ -47,8 +47,13 @@
 #include <JuceHeader.h>
 #include "UI/MainHostWindow.h"
 #include "Plugins/InternalPlugins.h"
+#include "Plugins/SandboxedPluginInstance.h"
+#include "Plugins/OfflineRenderer.h"
 #include "UI/TrayIconController.h"
 #include "UI/AudioResilienceManager.h"
+#include "UI/StartupProfiler.h"
+#include "UI/RecoveryBenchmark.h"
+#include "UI/HeadlessHost.h"
 
 #if ! (JUCE_PLUGINHOST_VST || JUCE_PLUGINHOST_VST3 || JUCE_PLUGINHOST_AU)
  #error "If you're building the audio plugin host, you probably want to enable VST and/or AU support"
@@ -163,20 +168,74 @@ public:
 
         if (scannerSubprocess->initialiseFromCommandLine (commandLine, processUID))
         {
+            // scanning is never urgent enough to compete with the audio thread
+            Process::setPriority (Process::LowPriority);
             storedScannerSubprocess = std::move (scannerSubprocess);
             return;
         }
 
+        auto sandboxProcess = std::make_unique<SandboxWorkerProcess>();
+
+        if (sandboxProcess->initialiseFromCommandLine (commandLine, sandboxProcessUID))
+        {
+            storedSandboxProcess = std::move (sandboxProcess);
+            return;
+        }
+
+        if (commandLine.contains ("--benchmark-sandbox"))
+        {
+            setApplicationReturnValue (SandboxedPluginInstance::runBenchmark());
+            quit();
+            return;
+        }
+
+        // launched as a login item: get the last graph playing first, and leave everything
+        // that's only needed once someone opens the editor until after audio is running
+        deferNonAudioStartup = commandLine.contains ("--login");
+
         // initialise our settings file..
 
+        // the recovery benchmark scripts the saved device, so it gets a settings file of its own
+        const auto benchmarkRecovery = commandLine.contains ("--benchmark-recovery");
+
         PropertiesFile::Options options;
-        options.applicationName     = "Curve";
+        options.applicationName     = benchmarkRecovery ? "Curve Recovery Benchmark" : "Curve";
         options.filenameSuffix      = "settings";
         options.osxLibrarySubFolder = "Preferences";
 
         appProperties.reset (new ApplicationProperties());
         appProperties->setStorageParameters (options);
 
+        if (benchmarkRecovery)
+        {
+            recoveryBenchmark = std::make_unique<RecoveryBenchmark>();
+            return;
+        }
+
+        if (commandLine.contains ("--render"))
+        {
+            offlineRenderer = std::make_unique<OfflineRenderer>();
+
+            if (! offlineRenderer->start (getCommandLineParameterArray()))
+            {
+                setApplicationReturnValue (1);
+                quit();
+            }
+
+            return;
+        }
+
+        // no window, tray icon or editor: just the graph on the saved device, and a control socket
+        if (commandLine.contains ("--headless"))
+        {
+            const auto portArgument = commandLine.fromFirstOccurrenceOf ("--control-port=", false, false);
+
+            headlessHost = std::make_unique<HeadlessHost> (portArgument.isNotEmpty() ? portArgument.getIntValue()
+                                                                                       : HeadlessHost::defaultControlPort);
+            triggerAsyncUpdate();
+            return;
+        }
+
         // create presets folder if it doesn't exist
         auto appDataDir = juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory).getChildFile ("Application Support").getChildFile(JUCEApplication::getInstance()->getApplicationName());
         auto presetsDir = appDataDir.getChildFile("Presets");
@@ -185,7 +244,9 @@ public:
         if (! presetsDir.exists())
             presetsDir.createDirectory();
 
-        mainWindow.reset (new MainHostWindow());
+        startupProfiler.mark ("settings");
+
+        mainWindow.reset (new MainHostWindow (deferNonAudioStartup));
 
         // hide editor window initially
         mainWindow->setVisible(false);
@@ -197,19 +258,26 @@ public:
         auto& deviceManager = mainWindow->getDeviceManager();
         resilienceManager.reset(new AudioResilienceManager(deviceManager, [this]
         {
-            // lambda function to reload the current preset (used by resilienceManager)
+            // the graph survives the device going away; the render engine only re-prepares it if the
+            // new device runs at a different rate or block size, and the IO nodes follow its channels
+            if (mainWindow != nullptr)
+                mainWindow->handleDeviceReconnected();
+        },
+        [this]
+        {
+            Array<AudioResilienceManager::DeviceChoice> choices;
+
             if (mainWindow != nullptr && mainWindow->graphHolder != nullptr && mainWindow->graphHolder->graph != nullptr)
-            {
-                auto f = mainWindow->graphHolder->graph->getFile();
-                if (f.existsAsFile())
-                    mainWindow->loadPreset (f);
-            }
+                for (auto& d : mainWindow->graphHolder->graph->getFailoverDevices())
+                    choices.add ({ d.typeName, d.inputDeviceName, d.outputDeviceName });
+
+            return choices;
         }));
 
-        commandManager.registerAllCommandsForTarget (this);
-        commandManager.registerAllCommandsForTarget (mainWindow.get());
+        startupProfiler.mark ("tray icon and resilience manager");
 
-        mainWindow->menuItemsChanged();
+        if (! deferNonAudioStartup)
+            registerCommands();
 
         // Important note! We're going to use an async update here so that if we need
         // to re-open a file and instantiate some plugins, it will happen AFTER this
@@ -223,6 +291,37 @@ public:
     }
 
     void handleAsyncUpdate() override
+    {
+        auto fileToOpen = getFileToOpen();
+
+        if (headlessHost != nullptr)
+        {
+            if (fileToOpen.existsAsFile())
+                headlessHost->loadPreset (fileToOpen);
+
+            return;
+        }
+
+        if (fileToOpen.existsAsFile())
+            if (auto* graph = mainWindow->graphHolder.get())
+                if (auto* ioGraph = graph->graph.get())
+                    ioGraph->loadFrom (fileToOpen, true);
+
+        mainWindow->handleDeviceReconnected();
+        startupProfiler.mark ("last graph");
+
+        startupProfiler.whenAudioIsRunning (mainWindow->getDeviceManager(), [this]
+        {
+            if (! deferNonAudioStartup || mainWindow == nullptr)
+                return;
+
+            mainWindow->finishStartup();
+            registerCommands();
+        });
+    }
+
+    // the first preset named on the command line, or else the last one opened
+    File getFileToOpen() const
     {
         File fileToOpen;
 
@@ -247,14 +346,25 @@ public:
                 fileToOpen = recentFiles.getFile (0);
         }
 
-        if (fileToOpen.existsAsFile())
-            if (auto* graph = mainWindow->graphHolder.get())
-                if (auto* ioGraph = graph->graph.get())
-                    ioGraph->loadFrom (fileToOpen, true);
+        return fileToOpen;
+    }
+
+    void registerCommands()
+    {
+        commandManager.registerAllCommandsForTarget (this);
+        commandManager.registerAllCommandsForTarget (mainWindow.get());
+
+        mainWindow->menuItemsChanged();
+        startupProfiler.mark ("commands");
     }
 
     void shutdown() override
     {
+        startupProfiler.stopWaiting();
+        headlessHost = nullptr;
+        offlineRenderer = nullptr;
+        recoveryBenchmark = nullptr;
+        storedSandboxProcess = nullptr;
         trayIcon = nullptr;
         resilienceManager = nullptr;
         mainWindow = nullptr;
@@ -293,18 +403,25 @@ public:
 
     ApplicationCommandManager commandManager;
     std::unique_ptr<ApplicationProperties> appProperties;
+    StartupProfiler startupProfiler;
 
 private:
     std::unique_ptr<MainHostWindow> mainWindow;
     std::unique_ptr<PluginScannerSubprocess> storedScannerSubprocess;
+    std::unique_ptr<SandboxWorkerProcess> storedSandboxProcess;
     std::unique_ptr<TrayIconController> trayIcon;
     std::unique_ptr<AudioResilienceManager> resilienceManager;
+    std::unique_ptr<RecoveryBenchmark> recoveryBenchmark;
+    std::unique_ptr<HeadlessHost> headlessHost;
+    std::unique_ptr<OfflineRenderer> offlineRenderer;
+    bool deferNonAudioStartup = false;
 };
 
 static PluginHostApp& getApp()                    { return *dynamic_cast<PluginHostApp*> (JUCEApplication::getInstance()); }
 
 ApplicationProperties& getAppProperties()         { return *getApp().appProperties; }
 ApplicationCommandManager& getCommandManager()    { return getApp().commandManager; }
+StartupProfiler& getStartupProfiler()             { return getApp().startupProfiler; }
 
 bool isOnTouchDevice()
 {
@@ -0,0 +1,146 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Splits a block that is larger than maxBlockSize into consecutive sub-blocks
+    and passes each one to processChunk, along with the MIDI that falls inside it.
+
+    The two scratch MidiBuffers must be preallocated by the caller so that no
+    allocation happens on the audio thread.
+*/
+template <typename SampleType, typename ProcessChunk>
+void processInSubBlocks (AudioBuffer<SampleType>& buffer,
+                         MidiBuffer& midi,
+                         int maxBlockSize,
+                         MidiBuffer& chunkMidi,
+                         MidiBuffer& collectedMidi,
+                         ProcessChunk&& processChunk)
+{
+    const auto numSamples = buffer.getNumSamples();
+
+    if (maxBlockSize <= 0 || numSamples <= maxBlockSize)
+    {
+        processChunk (buffer, midi);
+        return;
+    }
+
+    collectedMidi.clear();
+
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+    {
+        const auto num = jmin (maxBlockSize, numSamples - start);
+        AudioBuffer<SampleType> chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, num);
+
+        chunkMidi.clear();
+        chunkMidi.addEvents (midi, start, num, -start);
+
+        processChunk (chunk, chunkMidi);
+
+        collectedMidi.addEvents (chunkMidi, 0, num, start);
+    }
+
+    midi.swapWith (collectedMidi);
+}
+
+//==============================================================================
+/**
+    Buffers incoming audio into blocks of a fixed size, however the host chops
+    it up, and hands each complete block to a processing callback.
+
+    The output is delayed by exactly one block, which the owner should report
+    as latency.
+*/
+template <typename SampleType>
+class FixedBlockFifo
+{
+public:
+    FixedBlockFifo() = default;
+
+    void prepare (int numChannels, int newBlockSize)
+    {
+        blockSize = newBlockSize;
+
+        inputBlock.setSize (numChannels, blockSize);
+        outputBlock.setSize (numChannels, blockSize);
+
+        for (auto* m : { &inputMidi, &outputMidi, &returnedMidi })
+            m->ensureSize (2048);
+
+        reset();
+    }
+
+    void reset()
+    {
+        inputBlock.clear();
+        outputBlock.clear();
+        inputMidi.clear();
+        outputMidi.clear();
+        position = 0;
+    }
+
+    int getBlockSize() const noexcept   { return blockSize; }
+
+    template <typename ProcessBlock>
+    void process (AudioBuffer<SampleType>& buffer, MidiBuffer& midi, ProcessBlock&& processBlock)
+    {
+        jassert (blockSize > 0);
+
+        const auto numSamples = buffer.getNumSamples();
+        const auto numChannels = jmin (buffer.getNumChannels(), inputBlock.getNumChannels());
+
+        returnedMidi.clear();
+
+        for (int done = 0; done < numSamples;)
+        {
+            const auto num = jmin (numSamples - done, blockSize - position);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                inputBlock.copyFrom (ch, position, buffer, ch, done, num);
+                buffer.copyFrom (ch, done, outputBlock, ch, position, num);
+            }
+
+            inputMidi.addEvents (midi, done, num, position - done);
+            returnedMidi.addEvents (outputMidi, position, num, done - position);
+
+            position += num;
+            done += num;
+
+            if (position == blockSize)
+            {
+                processBlock (inputBlock, inputMidi);
+
+                for (int ch = 0; ch < inputBlock.getNumChannels(); ++ch)
+                    outputBlock.copyFrom (ch, 0, inputBlock, ch, 0, blockSize);
+
+                outputMidi.swapWith (inputMidi);
+                inputMidi.clear();
+                position = 0;
+            }
+        }
+
+        midi.swapWith (returnedMidi);
+    }
+
+private:
+    AudioBuffer<SampleType> inputBlock, outputBlock;
+    MidiBuffer inputMidi, outputMidi, returnedMidi;
+    int blockSize = 0, position = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (FixedBlockFifo)
+};
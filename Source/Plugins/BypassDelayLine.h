@@ -0,0 +1,95 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A passthrough that delays its input by a node's reported latency, so that a
+    node can be bypassed without the host having to recompensate the graph.
+
+    While the node is running normally, push() keeps the delay line filled with
+    its input; process() then replaces the node's output with the delayed input.
+*/
+template <typename SampleType>
+class BypassDelayLine
+{
+public:
+    void prepare (int numChannelsIn, int delaySamplesIn)
+    {
+        delaySamples = jmax (0, delaySamplesIn);
+        numChannels = jmax (0, numChannelsIn);
+        ring.setSize (numChannels, jmax (1, delaySamples));
+        reset();
+    }
+
+    void reset()
+    {
+        ring.clear();
+        writePos = 0;
+    }
+
+    int getDelay() const noexcept       { return delaySamples; }
+
+    /** Records the first numInputs channels of a block without changing it. */
+    void push (AudioBuffer<SampleType>& buffer, int numInputs) noexcept
+    {
+        run (buffer, numInputs, false);
+    }
+
+    /** Replaces the block with the delayed input; channels with no input are cleared. */
+    void process (AudioBuffer<SampleType>& buffer, int numInputs) noexcept
+    {
+        run (buffer, numInputs, true);
+
+        for (int ch = jmax (0, numInputs); ch < buffer.getNumChannels(); ++ch)
+            buffer.clear (ch, 0, buffer.getNumSamples());
+    }
+
+private:
+    void run (AudioBuffer<SampleType>& buffer, int numInputs, bool shouldReplace) noexcept
+    {
+        const auto numSamples = buffer.getNumSamples();
+        const auto channelsToDelay = jmin (numInputs, numChannels, buffer.getNumChannels());
+
+        if (delaySamples == 0 || numSamples == 0)
+            return;
+
+        for (int ch = 0; ch < channelsToDelay; ++ch)
+        {
+            auto* data = buffer.getWritePointer (ch);
+            auto* delayed = ring.getWritePointer (ch);
+            auto pos = writePos;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto in = data[i];
+
+                if (shouldReplace)
+                    data[i] = delayed[pos];
+
+                delayed[pos] = in;
+
+                if (++pos == delaySamples)
+                    pos = 0;
+            }
+        }
+
+        writePos = (writePos + numSamples) % delaySamples;
+    }
+
+    AudioBuffer<SampleType> ring;
+    int numChannels = 0, delaySamples = 0, writePos = 0;
+};
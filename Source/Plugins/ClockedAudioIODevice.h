@@ -0,0 +1,268 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The part shared by devices that are driven by a clock rather than hardware:
+    opening with a rate, block size and channel mask, and a thread of their own
+    that calls back once per block.
+
+    The callbacks are due in slots counted from a fixed start, so the clock doesn't
+    drift however late they're woken. A callback that overruns the next one's slot
+    altogether counts as an xrun, and the clock starts again from there. The thread
+    sleeps between callbacks, so a callback can be up to about a millisecond late.
+
+    Subclasses say which settings they offer, and can fill the input, move each
+    callback from its slot, or stop calling back. Their destructors must call close().
+*/
+class ClockedAudioIODevice : public AudioIODevice,
+                             private Thread
+{
+public:
+    ClockedAudioIODevice (const String& deviceName, const String& typeName, const String& threadName)
+        : AudioIODevice (deviceName, typeName),
+          Thread (threadName)
+    {
+    }
+
+    ~ClockedAudioIODevice() override
+    {
+        // the subclass's destructor has to do this, while its hooks can still be called
+        jassert (! isOpen_);
+    }
+
+    //==============================================================================
+    StringArray getOutputChannelNames() override        { return getChannelNames ("Output", getNumChannels (false)); }
+    StringArray getInputChannelNames() override         { return getChannelNames ("Input", getNumChannels (true)); }
+
+    String open (const BigInteger& inputChannels,
+                 const BigInteger& outputChannels,
+                 double sampleRate,
+                 int bufferSizeSamples) override
+    {
+        close();
+
+        if (auto error = getReasonNotToOpen(); error.isNotEmpty())
+            return error;
+
+        if (sampleRate <= 0.0)
+            sampleRate = getDefaultSampleRate();
+
+        if (! getAvailableSampleRates().contains (sampleRate))
+            return "The device doesn't support " + String (sampleRate) + " Hz";
+
+        currentRate = sampleRate;
+        currentBlockSize = bufferSizeSamples > 0 ? bufferSizeSamples : getDefaultBufferSize();
+
+        activeInputs = limitChannels (inputChannels, getNumChannels (true));
+        activeOutputs = limitChannels (outputChannels, getNumChannels (false));
+
+        inputBuffer.setSize (activeInputs.countNumberOfSetBits(), currentBlockSize);
+        inputBuffer.clear();
+        outputBuffer.setSize (activeOutputs.countNumberOfSetBits(), currentBlockSize);
+
+        numXRuns = 0;
+        opened();
+        isOpen_ = true;
+
+        startThread (Thread::Priority::highest);
+        return {};
+    }
+
+    void close() override
+    {
+        if (! isOpen_)
+            return;
+
+        stop();
+        stopThread (2000);
+        closed();
+        isOpen_ = false;
+    }
+
+    bool isOpen() override                              { return isOpen_; }
+
+    void start (AudioIODeviceCallback* newCallback) override
+    {
+        if (! isOpen_ || newCallback == nullptr || newCallback == callback)
+            return;
+
+        stop();
+        newCallback->audioDeviceAboutToStart (this);
+
+        lockWanted = true;
+        const ScopedLock sl (callbackLock);
+        callback = newCallback;
+        lockWanted = false;
+    }
+
+    void stop() override
+    {
+        AudioIODeviceCallback* oldCallback = nullptr;
+
+        {
+            lockWanted = true;
+            const ScopedLock sl (callbackLock);
+            std::swap (oldCallback, callback);
+            lockWanted = false;
+        }
+
+        if (oldCallback != nullptr)
+            oldCallback->audioDeviceStopped();
+    }
+
+    bool isPlaying() override                           { return callback != nullptr; }
+    String getLastError() override                      { return {}; }
+
+    int getCurrentBufferSizeSamples() override          { return currentBlockSize; }
+    double getCurrentSampleRate() override              { return currentRate; }
+    int getCurrentBitDepth() override                   { return 32; }
+
+    BigInteger getActiveOutputChannels() const override { return activeOutputs; }
+    BigInteger getActiveInputChannels() const override  { return activeInputs; }
+
+    int getOutputLatencyInSamples() override            { return 0; }
+    int getInputLatencyInSamples() override             { return 0; }
+    int getXRunCount() const noexcept override          { return numXRuns; }
+
+protected:
+    //==============================================================================
+    virtual int getNumChannels (bool isInput) const = 0;
+
+    /** The rate used when open() isn't given one. */
+    virtual double getDefaultSampleRate()               { return getAvailableSampleRates().getFirst(); }
+
+    /** Returns an error to stop open() going ahead, or an empty string. */
+    virtual String getReasonNotToOpen()                 { return {}; }
+
+    /** Called by open() before the thread starts, and by close() after it has stopped. */
+    virtual void opened()                               {}
+    virtual void closed()                               {}
+
+    /** If true, each callback comes as soon as the last one returns, with no clock at all. */
+    virtual bool isFreeRunning() const                  { return false; }
+
+    /** Called on the device thread; the callbacks are skipped, though the clock keeps going, while this is false. */
+    virtual bool shouldCallBack() const                 { return true; }
+
+    /** Called on the device thread before each callback; how far to move it from its slot. */
+    virtual double getSlotOffsetMs()                    { return 0.0; }
+
+    /** Called on the device thread before each callback, to fill in what the callback gets as input. */
+    virtual void fillInput (AudioBuffer<float>&)        {}
+
+private:
+    //==============================================================================
+    static StringArray getChannelNames (const String& prefix, int numChannels)
+    {
+        StringArray names;
+
+        for (int i = 0; i < numChannels; ++i)
+            names.add (prefix + " " + String (i + 1));
+
+        return names;
+    }
+
+    static BigInteger limitChannels (BigInteger channels, int numChannels)
+    {
+        channels.setRange (numChannels, jmax (0, channels.getHighestBit() + 1 - numChannels), false);
+        return channels;
+    }
+
+    void run() override
+    {
+        const auto freeRunning = isFreeRunning();
+        const auto ticksPerMs = (double) Time::getHighResolutionTicksPerSecond() / 1000.0;
+        const auto periodTicks = ticksPerMs * 1000.0 * currentBlockSize / currentRate;
+
+        auto startTicks = (double) Time::getHighResolutionTicks();
+        int64 blockIndex = 0;
+
+        while (! threadShouldExit())
+        {
+            if (! freeRunning)
+            {
+                auto slotTicks = startTicks + periodTicks * (double) blockIndex;
+
+                // the last callback overran this one's slot altogether; hardware would have dropped a buffer
+                if ((double) Time::getHighResolutionTicks() > slotTicks + periodTicks)
+                {
+                    ++numXRuns;
+                    startTicks = (double) Time::getHighResolutionTicks() - periodTicks * (double) blockIndex;
+                    slotTicks = startTicks + periodTicks * (double) blockIndex;
+                }
+
+                waitUntil ((int64) (slotTicks + getSlotOffsetMs() * ticksPerMs), ticksPerMs);
+            }
+            else if (lockWanted)
+            {
+                // with no pause between callbacks, start() and stop() could otherwise wait a long time for the lock
+                Thread::yield();
+                continue;
+            }
+
+            ++blockIndex;
+
+            if (shouldCallBack())
+            {
+                fillInput (inputBuffer);
+
+                const ScopedLock sl (callbackLock);
+
+                if (callback != nullptr)
+                {
+                    callback->audioDeviceIOCallbackWithContext (inputBuffer.getArrayOfReadPointers(), inputBuffer.getNumChannels(),
+                                                                outputBuffer.getArrayOfWritePointers(), outputBuffer.getNumChannels(),
+                                                                currentBlockSize, {});
+                    continue;
+                }
+            }
+
+            // nothing to call; there's no need to spin while free-running
+            if (freeRunning)
+                wait (1);
+        }
+    }
+
+    // sleeps in whole milliseconds until the target has passed, so it can be up to about a millisecond late
+    void waitUntil (int64 targetTicks, double ticksPerMs)
+    {
+        for (;;)
+        {
+            const auto remainingMs = (double) (targetTicks - Time::getHighResolutionTicks()) / ticksPerMs;
+
+            if (remainingMs <= 0.0 || threadShouldExit())
+                return;
+
+            wait (jmax (1, (int) remainingMs));
+        }
+    }
+
+    //==============================================================================
+    CriticalSection callbackLock;
+    AudioIODeviceCallback* callback = nullptr;
+    std::atomic<int> numXRuns { 0 };
+    std::atomic<bool> lockWanted { false };
+    bool isOpen_ = false;
+
+    double currentRate = 48000.0;
+    int currentBlockSize = 256;
+    BigInteger activeInputs, activeOutputs;
+    AudioBuffer<float> inputBuffer, outputBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClockedAudioIODevice)
+};
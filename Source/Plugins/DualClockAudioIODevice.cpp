@@ -0,0 +1,505 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "DualClockAudioIODevice.h"
+#include "PolyphaseResampler.h"
+
+template <typename ValueType>
+static ValueType findNearest (const Array<ValueType>& values, ValueType target)
+{
+    auto nearest = target;
+    auto bestDistance = std::numeric_limits<double>::max();
+
+    for (auto v : values)
+    {
+        const auto distance = std::abs ((double) v - (double) target);
+
+        if (distance < bestDistance)
+        {
+            nearest = v;
+            bestDistance = distance;
+        }
+    }
+
+    return nearest;
+}
+
+//==============================================================================
+class DualClockAudioIODevice final : public AudioIODevice
+{
+public:
+    DualClockAudioIODevice (const String& typeName,
+                            std::unique_ptr<AudioIODevice> inputDeviceIn,
+                            std::unique_ptr<AudioIODevice> outputDeviceIn,
+                            const String& inputName,
+                            const String& outputName)
+        : AudioIODevice (outputName, typeName),
+          inputDeviceName (inputName),
+          outputDeviceName (outputName),
+          inputDevice (std::move (inputDeviceIn)),
+          outputDevice (std::move (outputDeviceIn))
+    {
+        jassert (outputDevice != nullptr);
+    }
+
+    ~DualClockAudioIODevice() override
+    {
+        close();
+    }
+
+    const String& getInputDeviceName() const noexcept       { return inputDeviceName; }
+    const String& getOutputDeviceName() const noexcept      { return outputDeviceName; }
+
+    //==============================================================================
+    StringArray getOutputChannelNames() override            { return outputDevice->getOutputChannelNames(); }
+    StringArray getInputChannelNames() override             { return inputDevice != nullptr ? inputDevice->getInputChannelNames() : StringArray(); }
+
+    // the output's clock is the one the callback runs on, so it decides these
+    Array<double> getAvailableSampleRates() override        { return outputDevice->getAvailableSampleRates(); }
+    Array<int> getAvailableBufferSizes() override           { return outputDevice->getAvailableBufferSizes(); }
+    int getDefaultBufferSize() override                     { return outputDevice->getDefaultBufferSize(); }
+
+    String open (const BigInteger& inputChannels, const BigInteger& outputChannels,
+                 double sampleRate, int bufferSizeSamples) override
+    {
+        close();
+
+        lastError = outputDevice->open ({}, outputChannels, sampleRate, bufferSizeSamples);
+
+        if (lastError.isEmpty() && inputDevice != nullptr && inputChannels.countNumberOfSetBits() > 0)
+        {
+            // run the input as close to the output's rate and buffer size as it can; the resampler covers the rest
+            const auto outputRate = outputDevice->getCurrentSampleRate();
+            const auto outputBlockSize = outputDevice->getCurrentBufferSizeSamples();
+
+            lastError = inputDevice->open (inputChannels, {},
+                                           findNearest (inputDevice->getAvailableSampleRates(), outputRate),
+                                           findNearest (inputDevice->getAvailableBufferSizes(), outputBlockSize));
+            inputIsOpen = lastError.isEmpty();
+        }
+
+        if (lastError.isNotEmpty())
+        {
+            close();
+            return lastError;
+        }
+
+        prepareBridge();
+        deviceIsOpen = true;
+        return {};
+    }
+
+    void close() override
+    {
+        stop();
+
+        if (inputIsOpen)
+            inputDevice->close();
+
+        outputDevice->close();
+        inputIsOpen = deviceIsOpen = false;
+    }
+
+    bool isOpen() override                                  { return deviceIsOpen; }
+
+    void start (AudioIODeviceCallback* newCallback) override
+    {
+        if (! deviceIsOpen || newCallback == nullptr || isStarted)
+            return;
+
+        client = newCallback;
+        client->audioDeviceAboutToStart (this);
+
+        resetBridge();
+
+        if (inputIsOpen)
+            inputDevice->start (&inputSide);
+
+        outputDevice->start (&outputSide);
+        isStarted = true;
+    }
+
+    void stop() override
+    {
+        if (! isStarted)
+            return;
+
+        // each device waits for its callback to finish before returning
+        outputDevice->stop();
+
+        if (inputIsOpen)
+            inputDevice->stop();
+
+        isStarted = false;
+
+        if (auto* c = std::exchange (client, nullptr))
+            c->audioDeviceStopped();
+    }
+
+    bool isPlaying() override                               { return isStarted && outputDevice->isPlaying(); }
+    String getLastError() override                          { return lastError.isNotEmpty() ? lastError : outputDevice->getLastError(); }
+
+    int getCurrentBufferSizeSamples() override              { return outputDevice->getCurrentBufferSizeSamples(); }
+    double getCurrentSampleRate() override                  { return outputDevice->getCurrentSampleRate(); }
+    int getCurrentBitDepth() override                       { return outputDevice->getCurrentBitDepth(); }
+
+    BigInteger getActiveOutputChannels() const override     { return outputDevice->getActiveOutputChannels(); }
+    BigInteger getActiveInputChannels() const override      { return inputIsOpen ? inputDevice->getActiveInputChannels() : BigInteger(); }
+
+    int getOutputLatencyInSamples() override                { return outputDevice->getOutputLatencyInSamples(); }
+
+    int getInputLatencyInSamples() override
+    {
+        if (! inputIsOpen)
+            return 0;
+
+        const auto ratio = getCurrentSampleRate() / inputDevice->getCurrentSampleRate();
+
+        return roundToInt ((double) (inputDevice->getInputLatencyInSamples() + resampler.getLatencyInInputSamples()) * ratio)
+                 + targetFill;
+    }
+
+    int getXRunCount() const noexcept override
+    {
+        return outputDevice->getXRunCount()
+             + (inputIsOpen ? inputDevice->getXRunCount() : 0)
+             + numUnderruns.load (std::memory_order_relaxed)
+             + numOverruns.load (std::memory_order_relaxed);
+    }
+
+private:
+    //==============================================================================
+    // the FIFO error is smoothed over about this long, so that the ripple from the two block sizes doesn't reach the ratio
+    static constexpr double fillTimeConstantSeconds = 0.5;
+
+    // per sample of FIFO error; together these settle over tens of seconds with plenty of phase margin
+    static constexpr double proportionalGain = 2.0e-6;
+    static constexpr double integralGain = 1.0e-7;
+
+    // 2000 ppm is far beyond any real pair of crystals
+    static constexpr double maxAdjustment = 0.002;
+
+    struct InputSide final : public AudioIODeviceCallback
+    {
+        explicit InputSide (DualClockAudioIODevice& d) : owner (d) {}
+
+        void audioDeviceIOCallbackWithContext (const float* const* inputs, int numInputs, float* const*, int,
+                                               int numSamples, const AudioIODeviceCallbackContext&) override
+        {
+            owner.captureInput (inputs, numInputs, numSamples);
+        }
+
+        void audioDeviceAboutToStart (AudioIODevice*) override {}
+        void audioDeviceStopped() override {}
+
+        DualClockAudioIODevice& owner;
+    };
+
+    struct OutputSide final : public AudioIODeviceCallback
+    {
+        explicit OutputSide (DualClockAudioIODevice& d) : owner (d) {}
+
+        void audioDeviceIOCallbackWithContext (const float* const*, int, float* const* outputs, int numOutputs,
+                                               int numSamples, const AudioIODeviceCallbackContext& context) override
+        {
+            owner.renderOutput (outputs, numOutputs, numSamples, context);
+        }
+
+        void audioDeviceAboutToStart (AudioIODevice*) override {}
+        void audioDeviceStopped() override {}
+
+        void audioDeviceError (const String& message) override
+        {
+            if (owner.client != nullptr)
+                owner.client->audioDeviceError (message);
+        }
+
+        DualClockAudioIODevice& owner;
+    };
+
+    //==============================================================================
+    void prepareBridge()
+    {
+        const auto outputRate = outputDevice->getCurrentSampleRate();
+        const auto outputBlockSize = jmax (1, outputDevice->getCurrentBufferSizeSamples());
+
+        numInputs = inputIsOpen ? inputDevice->getActiveInputChannels().countNumberOfSetBits() : 0;
+        numOutputs = outputDevice->getActiveOutputChannels().countNumberOfSetBits();
+
+        // some drivers occasionally deliver a larger block than they were opened with
+        maxOutputBlockSize = outputBlockSize * 2;
+        outputChunk.resize ((size_t) numOutputs);
+
+        if (numInputs == 0)
+            return;
+
+        maxInputBlockSize = jmax (1, inputDevice->getCurrentBufferSizeSamples()) * 2;
+        resampler.prepare (numInputs, inputDevice->getCurrentSampleRate(), outputRate, maxInputBlockSize);
+        resampled.setSize (numInputs, resampler.getMaxOutputSamples (maxInputBlockSize));
+        inputChunk.resize ((size_t) numInputs);
+
+        // room for one input burst arriving just before an output block is taken
+        targetFill = resampler.getMaxOutputSamples (maxInputBlockSize / 2) + outputBlockSize;
+
+        const auto capacity = targetFill * 4;
+        fifoBuffer.setSize (numInputs, capacity);
+        fifo.setTotalSize (capacity);
+
+        inputScratch.setSize (numInputs, maxOutputBlockSize);
+    }
+
+    void resetBridge()
+    {
+        numUnderruns = 0;
+        numOverruns = 0;
+
+        if (numInputs == 0)
+            return;
+
+        resampler.reset();
+        fifoBuffer.clear();
+        fifo.reset();
+
+        // start centred, primed with silence
+        fifo.finishedWrite (targetFill);
+
+        averageFill = (double) targetFill;
+        integral = 0.0;
+        ratioAdjustment = 1.0;
+        refilling = false;
+    }
+
+    //==============================================================================
+    // called on the input device's thread
+    void captureInput (const float* const* inputs, int numInputsIn, int numSamples)
+    {
+        if (numInputs == 0)
+            return;
+
+        resampler.setRatioAdjustment (ratioAdjustment.load (std::memory_order_relaxed));
+
+        for (int offset = 0; offset < numSamples;)
+        {
+            const auto chunk = jmin (numSamples - offset, maxInputBlockSize);
+
+            for (int ch = 0; ch < numInputs; ++ch)
+                inputChunk[(size_t) ch] = ch < numInputsIn && inputs[ch] != nullptr ? inputs[ch] + offset : nullptr;
+
+            auto numResampled = resampler.process (inputChunk.data(), chunk, resampled.getArrayOfWritePointers(), resampled.getNumSamples());
+
+            if (fifo.getFreeSpace() < numResampled)
+            {
+                numOverruns.fetch_add (1, std::memory_order_relaxed);
+                numResampled = fifo.getFreeSpace();
+            }
+
+            const auto scope = fifo.write (numResampled);
+
+            for (int ch = 0; ch < numInputs; ++ch)
+            {
+                if (scope.blockSize1 > 0)
+                    fifoBuffer.copyFrom (ch, scope.startIndex1, resampled, ch, 0, scope.blockSize1);
+
+                if (scope.blockSize2 > 0)
+                    fifoBuffer.copyFrom (ch, scope.startIndex2, resampled, ch, scope.blockSize1, scope.blockSize2);
+            }
+
+            offset += chunk;
+        }
+    }
+
+    // called on the output device's thread
+    void renderOutput (float* const* outputs, int numOutputsIn, int numSamples, const AudioIODeviceCallbackContext& context)
+    {
+        if (client == nullptr)
+        {
+            for (int ch = 0; ch < numOutputsIn; ++ch)
+                if (outputs[ch] != nullptr)
+                    FloatVectorOperations::clear (outputs[ch], numSamples);
+
+            return;
+        }
+
+        for (int offset = 0; offset < numSamples;)
+        {
+            const auto chunk = jmin (numSamples - offset, maxOutputBlockSize);
+            const auto numChunkOutputs = jmin (numOutputsIn, (int) outputChunk.size());
+
+            for (int ch = 0; ch < numChunkOutputs; ++ch)
+                outputChunk[(size_t) ch] = outputs[ch] != nullptr ? outputs[ch] + offset : nullptr;
+
+            if (numInputs > 0)
+                pullInput (chunk);
+
+            client->audioDeviceIOCallbackWithContext (numInputs > 0 ? inputScratch.getArrayOfReadPointers() : nullptr, numInputs,
+                                                      outputChunk.data(), numChunkOutputs, chunk, context);
+            offset += chunk;
+        }
+    }
+
+    void pullInput (int numSamples)
+    {
+        // after an underrun, wait until the FIFO is back at its target rather than limping along just above empty
+        if (refilling && fifo.getNumReady() < targetFill)
+        {
+            inputScratch.clear (0, numSamples);
+            return;
+        }
+
+        refilling = false;
+
+        if (fifo.getNumReady() < numSamples)
+        {
+            numUnderruns.fetch_add (1, std::memory_order_relaxed);
+            inputScratch.clear (0, numSamples);
+            refilling = true;
+            averageFill = (double) targetFill;
+            integral = 0.0;
+            return;
+        }
+
+        {
+            const auto scope = fifo.read (numSamples);
+
+            for (int ch = 0; ch < numInputs; ++ch)
+            {
+                if (scope.blockSize1 > 0)
+                    inputScratch.copyFrom (ch, 0, fifoBuffer, ch, scope.startIndex1, scope.blockSize1);
+
+                if (scope.blockSize2 > 0)
+                    inputScratch.copyFrom (ch, scope.blockSize1, fifoBuffer, ch, scope.startIndex2, scope.blockSize2);
+            }
+        }
+
+        updateRatio (fifo.getNumReady(), numSamples);
+    }
+
+    void updateRatio (int fill, int numSamples)
+    {
+        const auto seconds = (double) numSamples / getCurrentSampleRate();
+        averageFill += ((double) fill - averageFill) * jmin (1.0, seconds / fillTimeConstantSeconds);
+
+        // too full means the input clock is fast, so the resampler has to eat its input faster
+        const auto error = averageFill - (double) targetFill;
+        integral = jlimit (-maxAdjustment / integralGain, maxAdjustment / integralGain, integral + error * seconds);
+
+        ratioAdjustment.store (jlimit (1.0 - maxAdjustment, 1.0 + maxAdjustment,
+                                       1.0 + proportionalGain * error + integralGain * integral),
+                               std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    const String inputDeviceName, outputDeviceName;
+    std::unique_ptr<AudioIODevice> inputDevice, outputDevice;
+
+    InputSide inputSide { *this };
+    OutputSide outputSide { *this };
+    AudioIODeviceCallback* client = nullptr;
+
+    String lastError;
+    bool deviceIsOpen = false, inputIsOpen = false, isStarted = false;
+    int numInputs = 0, numOutputs = 0, maxInputBlockSize = 0, maxOutputBlockSize = 0, targetFill = 0;
+
+    // the input thread's side
+    PolyphaseResampler<float> resampler;
+    AudioBuffer<float> resampled;
+    std::vector<const float*> inputChunk;
+
+    // shared between the two threads
+    AbstractFifo fifo { 1 };
+    AudioBuffer<float> fifoBuffer;
+    std::atomic<double> ratioAdjustment { 1.0 };
+    std::atomic<int> numUnderruns { 0 }, numOverruns { 0 };
+
+    // the output thread's side
+    AudioBuffer<float> inputScratch;
+    std::vector<float*> outputChunk;
+    double averageFill = 0.0, integral = 0.0;
+    bool refilling = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DualClockAudioIODevice)
+};
+
+//==============================================================================
+DualClockAudioIODeviceType::DualClockAudioIODeviceType (std::unique_ptr<AudioIODeviceType> typeToWrap)
+    : AudioIODeviceType (typeToWrap->getTypeName() + " (Separate Clocks)"),
+      inner (std::move (typeToWrap))
+{
+    inner->addListener (this);
+}
+
+DualClockAudioIODeviceType::~DualClockAudioIODeviceType()
+{
+    inner->removeListener (this);
+}
+
+void DualClockAudioIODeviceType::addTo (AudioDeviceManager& deviceManager)
+{
+   #if JUCE_LINUX && JUCE_ALSA
+    // the built-in types are only created while the list is empty, so make sure they're there first
+    deviceManager.getAvailableDeviceTypes();
+
+    if (auto* alsa = AudioIODeviceType::createAudioIODeviceType_ALSA())
+        deviceManager.addAudioDeviceType (std::make_unique<DualClockAudioIODeviceType> (std::unique_ptr<AudioIODeviceType> (alsa)));
+   #else
+    ignoreUnused (deviceManager);
+   #endif
+}
+
+void DualClockAudioIODeviceType::scanForDevices()
+{
+    inner->scanForDevices();
+}
+
+StringArray DualClockAudioIODeviceType::getDeviceNames (bool wantInputNames) const
+{
+    return inner->getDeviceNames (wantInputNames);
+}
+
+int DualClockAudioIODeviceType::getDefaultDeviceIndex (bool forInput) const
+{
+    return inner->getDefaultDeviceIndex (forInput);
+}
+
+int DualClockAudioIODeviceType::getIndexOfDevice (AudioIODevice* device, bool asInput) const
+{
+    if (auto* d = dynamic_cast<DualClockAudioIODevice*> (device))
+        return getDeviceNames (asInput).indexOf (asInput ? d->getInputDeviceName() : d->getOutputDeviceName());
+
+    return -1;
+}
+
+AudioIODevice* DualClockAudioIODeviceType::createDevice (const String& outputDeviceName, const String& inputDeviceName)
+{
+    // without an output there's no clock to run the callback on
+    if (outputDeviceName.isEmpty())
+        return nullptr;
+
+    std::unique_ptr<AudioIODevice> output (inner->createDevice (outputDeviceName, {}));
+
+    if (output == nullptr)
+        return nullptr;
+
+    std::unique_ptr<AudioIODevice> input;
+
+    if (inputDeviceName.isNotEmpty())
+    {
+        input.reset (inner->createDevice ({}, inputDeviceName));
+
+        if (input == nullptr)
+            return nullptr;
+    }
+
+    return new DualClockAudioIODevice (getTypeName(), std::move (input), std::move (output), inputDeviceName, outputDeviceName);
+}
@@ -0,0 +1,56 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A device type whose devices take their input from one device and their output
+    from another of a wrapped type, with each running on its own clock.
+
+    The output device drives the callback. The input device's own callback
+    resamples what it captures to the output clock and passes it over through a
+    lock-free FIFO. A PI controller watches how full the FIFO is and trims the
+    resampling ratio, so the FIFO stays centred on a fixed latency however far
+    the two clocks drift apart.
+*/
+class DualClockAudioIODeviceType final : public AudioIODeviceType,
+                                         private AudioIODeviceType::Listener
+{
+public:
+    explicit DualClockAudioIODeviceType (std::unique_ptr<AudioIODeviceType> typeToWrap);
+    ~DualClockAudioIODeviceType() override;
+
+    /** Adds a dual-clock type for each of the platform's types that needs one;
+        currently ALSA, where input and output are often separate cards.
+    */
+    static void addTo (AudioDeviceManager&);
+
+    //==============================================================================
+    void scanForDevices() override;
+    StringArray getDeviceNames (bool wantInputNames) const override;
+    int getDefaultDeviceIndex (bool forInput) const override;
+    int getIndexOfDevice (AudioIODevice*, bool asInput) const override;
+    bool hasSeparateInputsAndOutputs() const override       { return true; }
+    AudioIODevice* createDevice (const String& outputDeviceName, const String& inputDeviceName) override;
+
+private:
+    //==============================================================================
+    void audioDeviceListChanged() override                  { callDeviceChangeListeners(); }
+
+    std::unique_ptr<AudioIODeviceType> inner;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DualClockAudioIODeviceType)
+};
@@ -0,0 +1,299 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "GraphRenderEngine.h"
+
+//==============================================================================
+template <typename SampleType>
+void GraphRenderEngine::RateConverter<SampleType>::prepare (int numIns, int numOuts,
+                                                            double deviceRate, double graphRate,
+                                                            int deviceBlockSize)
+{
+    toGraphRate.prepare (numIns, deviceRate, graphRate, deviceBlockSize);
+
+    const auto maxGraphSamples = toGraphRate.getMaxOutputSamples (deviceBlockSize);
+    toDeviceRate.prepare (numOuts, graphRate, deviceRate, maxGraphSamples);
+
+    graphBuffer.setSize (jmax (1, numIns, numOuts), maxGraphSamples);
+
+    const auto fifoSize = deviceBlockSize + toDeviceRate.getMaxOutputSamples (maxGraphSamples) + fifoPrimeSamples;
+    deviceFifo.setSize (jmax (1, numOuts), fifoSize);
+    fifoWritePointers.resize ((size_t) deviceFifo.getNumChannels());
+
+    deviceFifo.clear();
+    fifoNumReady = fifoPrimeSamples;
+}
+
+template <typename SampleType>
+void GraphRenderEngine::RateConverter<SampleType>::release()
+{
+    graphBuffer.setSize (0, 0);
+    deviceFifo.setSize (0, 0);
+    fifoWritePointers.clear();
+    fifoNumReady = 0;
+}
+
+template <typename SampleType>
+int GraphRenderEngine::RateConverter<SampleType>::getLatencyInDeviceSamples (double deviceRate, double graphRate) const
+{
+    return toGraphRate.getLatencyInInputSamples()
+         + roundToInt ((double) toDeviceRate.getLatencyInInputSamples() * deviceRate / graphRate)
+         + fifoPrimeSamples;
+}
+
+//==============================================================================
+GraphRenderEngine::GraphRenderEngine (AudioProcessorGraph& g)
+    : graph (g)
+{
+}
+
+GraphRenderEngine::~GraphRenderEngine()
+{
+    releaseGraph();
+}
+
+void GraphRenderEngine::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    const auto requestedRate = processingRate.load();
+    const auto numIns  = getTotalNumInputChannels();
+    const auto numOuts = getTotalNumOutputChannels();
+
+    resampling = requestedRate > 0.0 && ! approximatelyEqual (requestedRate, sampleRate);
+    graphRate = resampling ? requestedRate : sampleRate;
+    graphBlockSize = maximumExpectedSamplesPerBlock;
+
+    floatConverter.release();
+    doubleConverter.release();
+
+    if (resampling)
+    {
+        if (isUsingDoublePrecision())
+            doubleConverter.prepare (numIns, numOuts, sampleRate, graphRate, maximumExpectedSamplesPerBlock);
+        else
+            floatConverter.prepare (numIns, numOuts, sampleRate, graphRate, maximumExpectedSamplesPerBlock);
+
+        graphBlockSize = isUsingDoublePrecision() ? doubleConverter.graphBuffer.getNumSamples()
+                                                  : floatConverter.graphBuffer.getNumSamples();
+
+        setLatencySamples (isUsingDoublePrecision() ? doubleConverter.getLatencyInDeviceSamples (sampleRate, graphRate)
+                                                    : floatConverter.getLatencyInDeviceSamples (sampleRate, graphRate));
+    }
+    else
+    {
+        setLatencySamples (0);
+    }
+
+    subBlockSize = jmax (0, maxGraphBlockSize.load());
+
+    if (subBlockSize > 0)
+        graphBlockSize = jmin (graphBlockSize, subBlockSize);
+
+    for (auto* m : { &graphMidi, &subBlockMidi, &collectedMidi })
+        m->ensureSize (4096);
+
+    const PreparedConfig config { graphRate, graphBlockSize, numIns, numOuts, getProcessingPrecision() };
+
+    // A device that drops out and comes back (or is swapped for one at the same rate) doesn't
+    // need every plugin prepared again; clearing their state is enough to pick up where it left off.
+    if (graphIsPrepared && config == preparedConfig)
+    {
+        graph.reset();
+        return;
+    }
+
+    // a different channel count changes the IO nodes' pins; connections to channels the new
+    // device lacks stay in the graph, and carry audio again once a device that has them returns
+    if (onGraphAboutToBePrepared != nullptr)
+        onGraphAboutToBePrepared (graphRate, graphBlockSize, getProcessingPrecision());
+
+    graph.setPlayConfigDetails (numIns, numOuts, graphRate, graphBlockSize);
+    graph.setProcessingPrecision (getProcessingPrecision());
+    graph.prepareToPlay (graphRate, graphBlockSize);
+
+    if (onGraphPrepared != nullptr)
+        onGraphPrepared();
+
+    preparedConfig = config;
+    graphIsPrepared = true;
+}
+
+void GraphRenderEngine::releaseResources()
+{
+    // the graph stays prepared so that restarting the device is cheap; see releaseGraph()
+    floatConverter.release();
+    doubleConverter.release();
+    resampling = false;
+}
+
+void GraphRenderEngine::releaseGraph()
+{
+    graph.releaseResources();
+    graphIsPrepared = false;
+}
+
+void GraphRenderEngine::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime (isNonRealtime);
+    graph.setNonRealtime (isNonRealtime);
+}
+
+//==============================================================================
+void GraphRenderEngine::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
+{
+    // IIR tails decaying into denormals can cost orders of magnitude more CPU than normal samples
+    const ScopedNoDenormals noDenormals;
+    const auto startTicks = Time::getHighResolutionTicks();
+    process (buffer, midi, floatConverter);
+    recordCallbackTime (startTicks, buffer.getNumSamples());
+}
+
+void GraphRenderEngine::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midi)
+{
+    const ScopedNoDenormals noDenormals;
+    const auto startTicks = Time::getHighResolutionTicks();
+    process (buffer, midi, doubleConverter);
+    recordCallbackTime (startTicks, buffer.getNumSamples());
+}
+
+template <typename SampleType>
+void GraphRenderEngine::process (AudioBuffer<SampleType>& buffer, MidiBuffer& midi, RateConverter<SampleType>& converter)
+{
+    if (! resampling)
+    {
+        processGraph (buffer, midi);
+        return;
+    }
+
+    const auto numSamples = buffer.getNumSamples();
+    const auto numIns  = getTotalNumInputChannels();
+    const auto numOuts = getTotalNumOutputChannels();
+    const auto deviceToGraph = graphRate / getSampleRate();
+
+    // device rate -> graph rate
+    auto& graphBuffer = converter.graphBuffer;
+    const auto numGraphSamples = converter.toGraphRate.process (buffer.getArrayOfReadPointers(), numSamples,
+                                                                graphBuffer.getArrayOfWritePointers(), graphBuffer.getNumSamples());
+
+    for (int ch = numIns; ch < graphBuffer.getNumChannels(); ++ch)
+        graphBuffer.clear (ch, 0, numGraphSamples);
+
+    if (numGraphSamples > 0)
+    {
+        AudioBuffer<SampleType> graphBlock (graphBuffer.getArrayOfWritePointers(), graphBuffer.getNumChannels(), numGraphSamples);
+
+        remapMidi (midi, graphMidi, deviceToGraph, numGraphSamples);
+        processGraph (graphBlock, graphMidi);
+        remapMidi (graphMidi, midi, 1.0 / deviceToGraph, numSamples);
+
+        // graph rate -> device rate, appended to the output FIFO
+        auto& fifo = converter.deviceFifo;
+
+        for (int ch = 0; ch < fifo.getNumChannels(); ++ch)
+            converter.fifoWritePointers[(size_t) ch] = fifo.getWritePointer (ch, converter.fifoNumReady);
+
+        converter.fifoNumReady += converter.toDeviceRate.process (graphBlock.getArrayOfReadPointers(), numGraphSamples,
+                                                                  converter.fifoWritePointers.data(),
+                                                                  fifo.getNumSamples() - converter.fifoNumReady);
+    }
+    else
+    {
+        midi.clear();
+    }
+
+    // pull one device block out of the FIFO
+    auto& fifo = converter.deviceFifo;
+    const auto numToCopy = jmin (numSamples, converter.fifoNumReady);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        if (ch < numOuts)
+        {
+            buffer.copyFrom (ch, 0, fifo, ch, 0, numToCopy);
+
+            if (numToCopy < numSamples)
+                buffer.clear (ch, numToCopy, numSamples - numToCopy);
+        }
+        else
+        {
+            buffer.clear (ch, 0, numSamples);
+        }
+    }
+
+    const auto numRemaining = converter.fifoNumReady - numToCopy;
+
+    for (int ch = 0; ch < fifo.getNumChannels(); ++ch)
+    {
+        auto* data = fifo.getWritePointer (ch);
+        std::memmove (data, data + numToCopy, sizeof (SampleType) * (size_t) numRemaining);
+    }
+
+    converter.fifoNumReady = numRemaining;
+}
+
+template <typename SampleType>
+void GraphRenderEngine::processGraph (AudioBuffer<SampleType>& buffer, MidiBuffer& midi)
+{
+    processInSubBlocks (buffer, midi, subBlockSize, subBlockMidi, collectedMidi,
+                        [this] (AudioBuffer<SampleType>& block, MidiBuffer& blockMidi) { graph.processBlock (block, blockMidi); });
+}
+
+//==============================================================================
+GraphRenderEngine::CallbackStats GraphRenderEngine::getCallbackStats() const noexcept
+{
+    CallbackStats stats;
+    stats.numCallbacks  = statsNumCallbacks.load (std::memory_order_relaxed);
+    stats.numOverBudget = statsNumOverBudget.load (std::memory_order_relaxed);
+    stats.peakLoad      = statsPeakLoad.load (std::memory_order_relaxed);
+
+    if (stats.numCallbacks > 0)
+        stats.averageLoad = statsTotalLoad.load (std::memory_order_relaxed) / (double) stats.numCallbacks;
+
+    return stats;
+}
+
+void GraphRenderEngine::recordCallbackTime (int64 startTicks, int numSamples) noexcept
+{
+    if (statsResetPending.exchange (false))
+    {
+        statsNumCallbacks.store (0, std::memory_order_relaxed);
+        statsNumOverBudget.store (0, std::memory_order_relaxed);
+        statsPeakLoad.store (0.0, std::memory_order_relaxed);
+        statsTotalLoad.store (0.0, std::memory_order_relaxed);
+        return;
+    }
+
+    if (numSamples <= 0 || getSampleRate() <= 0.0)
+        return;
+
+    const auto seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    const auto load = seconds * getSampleRate() / (double) numSamples;
+
+    statsNumCallbacks.store (statsNumCallbacks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    statsTotalLoad.store (statsTotalLoad.load (std::memory_order_relaxed) + load, std::memory_order_relaxed);
+
+    if (load > 1.0)
+        statsNumOverBudget.store (statsNumOverBudget.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (load > statsPeakLoad.load (std::memory_order_relaxed))
+        statsPeakLoad.store (load, std::memory_order_relaxed);
+}
+
+void GraphRenderEngine::remapMidi (const MidiBuffer& source, MidiBuffer& dest, double ratio, int numSamples)
+{
+    dest.clear();
+
+    for (const auto metadata : source)
+        dest.addEvent (metadata.data, metadata.numBytes,
+                       jlimit (0, jmax (0, numSamples - 1), roundToInt ((double) metadata.samplePosition * ratio)));
+}
@@ -0,0 +1,181 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PolyphaseResampler.h"
+#include "BlockAdapter.h"
+
+//==============================================================================
+/**
+    The processor that the AudioProcessorPlayer actually drives.
+
+    It wraps the AudioProcessorGraph and, when the preset asks for a fixed
+    processing rate that differs from the device rate, resamples the device
+    input to that rate, runs the graph there, and resamples the result back.
+
+    Denormals are always flushed to zero while the graph is being rendered; any
+    thread that renders part of the graph must do the same.
+*/
+class GraphRenderEngine final : public AudioProcessor
+{
+public:
+    explicit GraphRenderEngine (AudioProcessorGraph&);
+    ~GraphRenderEngine() override;
+
+    //==============================================================================
+    /** Sets the rate the graph should run at. Zero means "follow the device".
+        Takes effect the next time the engine is prepared.
+    */
+    void setProcessingRate (double newRate) noexcept        { processingRate = newRate; }
+    double getProcessingRate() const noexcept               { return processingRate; }
+
+    /** Sets the largest block the graph will be given; larger callbacks are split
+        into sub-blocks. Zero means no limit. Takes effect the next time the engine
+        is prepared.
+    */
+    void setMaxGraphBlockSize (int newMaxBlockSize) noexcept    { maxGraphBlockSize = newMaxBlockSize; }
+    int getMaxGraphBlockSize() const noexcept                   { return maxGraphBlockSize; }
+
+    /** Called just before the graph is prepared for new settings, with the rate, block size
+        and precision it's about to get, so that its nodes can be prepared ahead of it.
+    */
+    std::function<void (double, int, ProcessingPrecision)> onGraphAboutToBePrepared;
+
+    /** Called just after the graph has been prepared, following onGraphAboutToBePrepared. */
+    std::function<void()> onGraphPrepared;
+
+    /** Returns true if the graph is currently running at a different rate to the device. */
+    bool isResampling() const noexcept                      { return resampling; }
+
+    //==============================================================================
+    /** Timing of the audio callbacks since the stats were last reset. Load is the
+        time spent rendering a callback as a fraction of the callback's duration.
+    */
+    struct CallbackStats
+    {
+        int64 numCallbacks = 0;
+        int64 numOverBudget = 0;
+        double peakLoad = 0.0;
+        double averageLoad = 0.0;
+    };
+
+    CallbackStats getCallbackStats() const noexcept;
+
+    /** Asks the audio thread to clear the stats at the start of its next callback. */
+    void resetCallbackStats() noexcept                      { statsResetPending = true; }
+
+    //==============================================================================
+    const String getName() const override                   { return "Graph Render Engine"; }
+
+    /** Prepares the graph, unless it's already prepared with the same rate, block size,
+        channel counts and precision, in which case its nodes are just reset.
+    */
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+
+    /** Releases the engine's own buffers but leaves the graph prepared, so a device
+        restart doesn't re-prepare every plugin. Use releaseGraph() to release it too.
+    */
+    void releaseResources() override;
+    void releaseGraph();
+
+    void processBlock (AudioBuffer<float>&,  MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    double getTailLengthSeconds() const override            { return graph.getTailLengthSeconds(); }
+    bool acceptsMidi() const override                       { return true; }
+    bool producesMidi() const override                      { return true; }
+    bool isBusesLayoutSupported (const BusesLayout&) const override  { return true; }
+
+    AudioProcessorEditor* createEditor() override           { return nullptr; }
+    bool hasEditor() const override                         { return false; }
+
+    int getNumPrograms() override                           { return 1; }
+    int getCurrentProgram() override                        { return 0; }
+    void setCurrentProgram (int) override                   {}
+    const String getProgramName (int) override              { return {}; }
+    void changeProgramName (int, const String&) override    {}
+
+    void getStateInformation (MemoryBlock&) override        {}
+    void setStateInformation (const void*, int) override    {}
+
+    void setNonRealtime (bool isNonRealtime) noexcept override;
+
+private:
+    //==============================================================================
+    template <typename SampleType>
+    struct RateConverter
+    {
+        void prepare (int numIns, int numOuts, double deviceRate, double graphRate, int deviceBlockSize);
+        void release();
+
+        int getLatencyInDeviceSamples (double deviceRate, double graphRate) const;
+
+        PolyphaseResampler<SampleType> toGraphRate, toDeviceRate;
+        AudioBuffer<SampleType> graphBuffer, deviceFifo;
+        std::vector<SampleType*> fifoWritePointers;
+        int fifoNumReady = 0;
+
+        // a few samples of slack in the output FIFO absorb the +/-1 sample jitter
+        // in how many samples each resampler produces per callback
+        static constexpr int fifoPrimeSamples = 8;
+    };
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>&, MidiBuffer&, RateConverter<SampleType>&);
+
+    template <typename SampleType>
+    void processGraph (AudioBuffer<SampleType>&, MidiBuffer&);
+
+    void remapMidi (const MidiBuffer& source, MidiBuffer& dest, double ratio, int numSamples);
+    void recordCallbackTime (int64 startTicks, int numSamples) noexcept;
+
+    //==============================================================================
+    AudioProcessorGraph& graph;
+
+    std::atomic<double> processingRate { 0.0 };
+    std::atomic<int> maxGraphBlockSize { 0 };
+    int subBlockSize = 0;
+    bool resampling = false;
+    double graphRate = 0.0;
+    int graphBlockSize = 0;
+
+    struct PreparedConfig
+    {
+        double rate = 0.0;
+        int blockSize = 0, numIns = 0, numOuts = 0;
+        ProcessingPrecision precision = singlePrecision;
+
+        bool operator== (const PreparedConfig& other) const
+        {
+            return approximatelyEqual (rate, other.rate) && blockSize == other.blockSize
+                && numIns == other.numIns && numOuts == other.numOuts && precision == other.precision;
+        }
+    };
+
+    PreparedConfig preparedConfig;
+    bool graphIsPrepared = false;
+
+    RateConverter<float>  floatConverter;
+    RateConverter<double> doubleConverter;
+    MidiBuffer graphMidi, subBlockMidi, collectedMidi;
+
+    // only written by the audio thread
+    std::atomic<int64> statsNumCallbacks { 0 }, statsNumOverBudget { 0 };
+    std::atomic<double> statsPeakLoad { 0.0 }, statsTotalLoad { 0.0 };
+    std::atomic<bool> statsResetPending { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphRenderEngine)
+};
@@ -0,0 +1,761 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BlockAdapter.h"
+#include "SampleConversion.h"
+#include "BypassDelayLine.h"
+
+//==============================================================================
+/**
+    Wraps every externally-hosted plugin in the graph so that Curve can apply
+    per-node processing options around the plugin's own processBlock.
+
+    Block-size adaptation:
+     - a fixed block size buffers the host's blocks into blocks of exactly that
+       size, at the cost of one block of added (reported) latency
+     - a maximum block size splits larger host blocks into sub-blocks, with no
+       added latency
+
+    Precision: the wrapper accepts whatever precision the graph runs at, and the
+    plugin itself runs at its own preferred precision, with conversion only when
+    the two differ.
+
+    Denormals: the render engine flushes denormals to zero; plugins that rely on
+    IEEE behaviour can opt out, and a diagnostic mode measures how much each
+    plugin's output and CPU time are affected by the choice.
+
+    Watchdog: if the plugin overruns its share of the block period too often,
+    it is taken out of the signal path and replaced by a delay line matching
+    its latency, until it is re-armed. The delay line follows the plugin's
+    latency if it changes after being prepared.
+*/
+class HostedPluginInstance final : public AudioPluginInstance,
+                                   private AudioProcessorListener,
+                                   private AsyncUpdater
+{
+public:
+    explicit HostedPluginInstance (std::unique_ptr<AudioPluginInstance> innerIn)
+        : inner (std::move (innerIn))
+    {
+        jassert (inner != nullptr);
+
+        {
+            const ScopedValueSetter<bool> svs (matchingInnerBuses, true);
+
+            for (auto isInput : { true, false })
+                while (getBusCount (isInput) < inner->getBusCount (isInput))
+                    addBus (isInput);
+        }
+
+        setBusesLayout (inner->getBusesLayout());
+        inner->addListener (this);
+    }
+
+    ~HostedPluginInstance() override
+    {
+        cancelPendingUpdate();
+        inner->removeListener (this);
+        inner->releaseResources();
+    }
+
+    //==============================================================================
+    AudioPluginInstance& getInner() const noexcept          { return *inner; }
+
+    /** Returns the processor that actually owns the parameters and editor. */
+    static AudioProcessor& unwrap (AudioProcessor& processor)
+    {
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (&processor))
+            return hosted->getInner();
+
+        return processor;
+    }
+
+    //==============================================================================
+    /** Changes the block-size adaptation. Either value may be zero to disable it;
+        a fixed block size takes priority over a maximum block size.
+
+        If the plugin is already prepared it is re-prepared immediately, and the
+        caller should rebuild the graph so that the new latency is compensated.
+    */
+    void setBlockSizeOptions (int newFixedBlockSize, int newMaxBlockSize)
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+
+        fixedBlockSize = jmax (0, newFixedBlockSize);
+        maxBlockSize = jmax (0, newMaxBlockSize);
+
+        if (isPrepared)
+        {
+            inner->releaseResources();
+            prepareInner();
+        }
+    }
+
+    int getFixedBlockSize() const noexcept                  { return fixedBlockSize; }
+    int getMaxBlockSize() const noexcept                    { return maxBlockSize; }
+
+    //==============================================================================
+    enum class PrecisionPreference
+    {
+        automatic,          // run at the graph's precision if the plugin supports it
+        singlePrecision,
+        doublePrecision     // ignored if the plugin can't process doubles
+    };
+
+    static String toString (PrecisionPreference p)
+    {
+        switch (p)
+        {
+            case PrecisionPreference::singlePrecision:  return "float";
+            case PrecisionPreference::doublePrecision:  return "double";
+            case PrecisionPreference::automatic:        break;
+        }
+
+        return "auto";
+    }
+
+    static PrecisionPreference precisionPreferenceFromString (const String& s)
+    {
+        if (s == "float")   return PrecisionPreference::singlePrecision;
+        if (s == "double")  return PrecisionPreference::doublePrecision;
+
+        return PrecisionPreference::automatic;
+    }
+
+    /** Changes the precision the plugin processes at, re-preparing it if needed. */
+    void setPrecisionPreference (PrecisionPreference newPreference)
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+
+        if (precisionPreference == newPreference)
+            return;
+
+        precisionPreference = newPreference;
+
+        if (isPrepared)
+        {
+            inner->releaseResources();
+            prepareInner();
+        }
+    }
+
+    PrecisionPreference getPrecisionPreference() const noexcept     { return precisionPreference; }
+
+    /** Returns the precision this plugin needs regardless of what the graph runs at,
+        or nullopt if it's happy to follow the graph.
+    */
+    std::optional<ProcessingPrecision> getRequiredPrecision() const
+    {
+        if (! inner->supportsDoublePrecisionProcessing()
+            || precisionPreference == PrecisionPreference::singlePrecision)
+            return singlePrecision;
+
+        if (precisionPreference == PrecisionPreference::doublePrecision)
+            return doublePrecision;
+
+        return std::nullopt;
+    }
+
+    /** The precision this plugin would rather the graph ran at. One left on automatic that can
+        process doubles asks for double, as the whole graph used to run in double.
+    */
+    ProcessingPrecision getPreferredPrecision() const
+    {
+        return getRequiredPrecision().value_or (doublePrecision);
+    }
+
+    //==============================================================================
+    /** Lets the plugin run with full IEEE denormal support instead of flush-to-zero. */
+    void setDenormalsAllowed (bool shouldAllow) noexcept    { denormalsAllowed = shouldAllow; }
+    bool areDenormalsAllowed() const noexcept               { return denormalsAllowed; }
+
+    /** Lets PluginGraph::prepareNodesAhead() call the plugin's prepareToPlay from another thread.
+        Off by default, as not every plugin copes with being prepared off the message thread.
+    */
+    void setConcurrentPrepareAllowed (bool shouldAllow) noexcept    { concurrentPrepareAllowed = shouldAllow; }
+    bool isConcurrentPrepareAllowed() const noexcept                { return concurrentPrepareAllowed; }
+
+    enum class DiagnosticMode
+    {
+        off,
+        flushToZero,    // measure with the engine's usual flush-to-zero policy
+        ieee            // measure with denormals allowed, so subnormal output can be seen
+    };
+
+    struct DiagnosticStats
+    {
+        int64 numBlocks = 0;
+        int64 numSamplesChecked = 0;
+        int64 numSubnormals = 0;
+        double totalSeconds = 0.0;
+
+        double getMicrosecondsPerBlock() const noexcept
+        {
+            return numBlocks > 0 ? totalSeconds * 1.0e6 / (double) numBlocks : 0.0;
+        }
+    };
+
+    /** Changes the diagnostic mode and clears the stats collected so far. */
+    void setDiagnosticMode (DiagnosticMode newMode) noexcept
+    {
+        diagnosticResetPending = true;
+        diagnosticMode = newMode;
+    }
+
+    DiagnosticStats getDiagnosticStats() const noexcept
+    {
+        DiagnosticStats stats;
+        stats.numBlocks         = diagnosticNumBlocks.load (std::memory_order_relaxed);
+        stats.numSamplesChecked = diagnosticNumSamples.load (std::memory_order_relaxed);
+        stats.numSubnormals     = diagnosticNumSubnormals.load (std::memory_order_relaxed);
+        stats.totalSeconds      = diagnosticSeconds.load (std::memory_order_relaxed);
+        return stats;
+    }
+
+    //==============================================================================
+    struct WatchdogOptions
+    {
+        // blocks here are the plugin's own processBlock calls, which can be larger or smaller than the host's
+        double budgetShare = 0.0;   // share of the block period a block may take; zero disables the watchdog
+        int windowSize = 16;        // how many recent blocks are considered, up to 64
+        int maxOverruns = 4;        // overruns within the window that trip the watchdog
+    };
+
+    void setWatchdogOptions (const WatchdogOptions& options) noexcept
+    {
+        watchdogWindowSize = jlimit (1, 64, options.windowSize);
+        watchdogMaxOverruns = jlimit (1, watchdogWindowSize.load(), options.maxOverruns);
+        watchdogBudgetShare = jmax (0.0, options.budgetShare);
+
+        if (options.budgetShare <= 0.0)
+            watchdogTripped = false;
+    }
+
+    /** True while the plugin is bypassed because it kept overrunning its budget. */
+    bool isWatchdogTripped() const noexcept                 { return watchdogTripped.load (std::memory_order_relaxed); }
+
+    /** Increments each time the watchdog trips, so that new trips can be spotted by polling. */
+    int getWatchdogTripCount() const noexcept               { return watchdogTripCount.load (std::memory_order_relaxed); }
+
+    /** The worst block time seen when the watchdog last tripped, as a share of the block period. */
+    double getWatchdogTripLoad() const noexcept             { return watchdogTripLoad.load (std::memory_order_relaxed); }
+
+    /** Puts the plugin back in the signal path with a clean overrun history. */
+    void rearmWatchdog() noexcept
+    {
+        watchdogResetPending = true;
+        watchdogTripped = false;
+    }
+
+    //==============================================================================
+    const String getName() const override                                         { return inner->getName(); }
+    StringArray getAlternateDisplayNames() const override                         { return inner->getAlternateDisplayNames(); }
+    double getTailLengthSeconds() const override                                  { return inner->getTailLengthSeconds(); }
+    bool acceptsMidi() const override                                             { return inner->acceptsMidi(); }
+    bool producesMidi() const override                                            { return inner->producesMidi(); }
+    AudioProcessorEditor* createEditor() override                                 { return inner->createEditorIfNeeded(); }
+    bool hasEditor() const override                                               { return inner->hasEditor(); }
+    int getNumPrograms() override                                                 { return inner->getNumPrograms(); }
+    int getCurrentProgram() override                                              { return inner->getCurrentProgram(); }
+    void setCurrentProgram (int i) override                                       { inner->setCurrentProgram (i); }
+    const String getProgramName (int i) override                                  { return inner->getProgramName (i); }
+    void changeProgramName (int i, const String& n) override                      { inner->changeProgramName (i, n); }
+    void getStateInformation (juce::MemoryBlock& b) override                      { inner->getStateInformation (b); }
+    void setStateInformation (const void* d, int s) override                      { inner->setStateInformation (d, s); }
+    void getCurrentProgramStateInformation (juce::MemoryBlock& b) override        { inner->getCurrentProgramStateInformation (b); }
+    void setCurrentProgramStateInformation (const void* d, int s) override        { inner->setCurrentProgramStateInformation (d, s); }
+    void memoryWarningReceived() override                                         { inner->memoryWarningReceived(); }
+    bool supportsDoublePrecisionProcessing() const override                       { return true; }
+    bool supportsMPE() const override                                             { return inner->supportsMPE(); }
+    bool isMidiEffect() const override                                            { return inner->isMidiEffect(); }
+    void reset() override                                                         { inner->reset(); }
+    void refreshParameterList() override                                          { inner->refreshParameterList(); }
+    void numChannelsChanged() override                                            { inner->numChannelsChanged(); }
+    void numBusesChanged() override                                               { inner->numBusesChanged(); }
+    void processorLayoutsChanged() override                                       { inner->processorLayoutsChanged(); }
+    void setPlayHead (AudioPlayHead* p) override                                  { inner->setPlayHead (p); }
+    void updateTrackProperties (const TrackProperties& p) override                { inner->updateTrackProperties (p); }
+    AudioProcessorParameter* getBypassParameter() const override                  { return inner->getBypassParameter(); }
+    bool isBusesLayoutSupported (const BusesLayout& layout) const override        { return inner->checkBusesLayoutSupported (layout); }
+    bool canAddBus (bool isInput) const override                                  { return matchingInnerBuses || inner->canAddBus (isInput); }
+    bool canRemoveBus (bool isInput) const override                               { return inner->canRemoveBus (isInput); }
+
+    void setNonRealtime (bool b) noexcept override
+    {
+        AudioPluginInstance::setNonRealtime (b);
+        inner->setNonRealtime (b);
+    }
+
+    bool applyBusLayouts (const BusesLayout& layouts) override
+    {
+        return inner->setBusesLayout (layouts) && AudioPluginInstance::applyBusLayouts (layouts);
+    }
+
+    //==============================================================================
+    /** Prepares the plugin for settings the graph is about to be prepared with, so that the
+        graph's own call finds it ready. Plugins can be prepared ahead on different threads
+        at once, as long as the graph isn't processing them meanwhile.
+    */
+    void prepareAhead (double sr, int bs, ProcessingPrecision precision)
+    {
+        setProcessingPrecision (precision);
+        setRateAndBufferSizeDetails (sr, bs);
+        prepareToPlay (sr, bs);
+
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+        preparedAhead = true;
+    }
+
+    /** Called once the graph has been prepared. If the graph didn't release and re-prepare the
+        plugin (its settings hadn't changed), this stops the next releaseResources() from being
+        taken as part of the prepare and ignored.
+    */
+    void finishPreparingAhead()
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+        preparedAhead = false;
+    }
+
+    /** How long the plugin's own prepareToPlay took the last time it was called. */
+    double getLastPrepareMilliseconds() const noexcept      { return lastPrepareMs.load (std::memory_order_relaxed); }
+
+    void prepareToPlay (double sr, int bs) override
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+
+        preparedAhead = false;
+
+        // already prepared in place for exactly these settings, by prepareAhead() or an earlier call
+        const auto numChannels = jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+        if (isPrepared && approximatelyEqual (sr, hostSampleRate) && bs == hostBlockSize
+             && getProcessingPrecision() == hostPrecision && numChannels == hostNumChannels)
+            return;
+
+        if (isPrepared)
+            inner->releaseResources();
+
+        hostSampleRate = sr;
+        hostBlockSize = bs;
+        hostPrecision = getProcessingPrecision();
+        hostNumChannels = numChannels;
+
+        const auto startMs = Time::getMillisecondCounterHiRes();
+        prepareInner();
+        lastPrepareMs.store (Time::getMillisecondCounterHiRes() - startMs, std::memory_order_relaxed);
+
+        isPrepared = true;
+    }
+
+    void releaseResources() override
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+
+        // the graph releases its nodes before preparing them for new settings; one prepared ahead keeps them
+        if (std::exchange (preparedAhead, false))
+            return;
+
+        isPrepared = false;
+        inner->releaseResources();
+    }
+
+    void processBlock (AudioBuffer<float>& a, MidiBuffer& m) override             { process (a, m, false); }
+    void processBlock (AudioBuffer<double>& a, MidiBuffer& m) override            { process (a, m, false); }
+    void processBlockBypassed (AudioBuffer<float>& a, MidiBuffer& m) override     { process (a, m, true); }
+    void processBlockBypassed (AudioBuffer<double>& a, MidiBuffer& m) override    { process (a, m, true); }
+
+    //==============================================================================
+    void fillInPluginDescription (PluginDescription& description) const override
+    {
+        inner->fillInPluginDescription (description);
+    }
+
+protected:
+    //==============================================================================
+    bool canApplyBusCountChange (bool isInput, bool isAdding, BusProperties& outProperties) override
+    {
+        // buses added or removed on the wrapper (e.g. from the I/O configuration window) are mirrored on the plugin
+        if (! matchingInnerBuses && ! (isAdding ? inner->addBus (isInput) : inner->removeBus (isInput)))
+            return false;
+
+        if (isAdding)
+        {
+            if (auto* bus = inner->getBus (isInput, getBusCount (isInput)))
+            {
+                outProperties.busName = bus->getName();
+                outProperties.defaultLayout = bus->getDefaultLayout();
+                outProperties.isActivatedByDefault = bus->isEnabledByDefault();
+            }
+        }
+
+        return true;
+    }
+
+private:
+    //==============================================================================
+    void audioProcessorParameterChanged (AudioProcessor*, int, float) override {}
+
+    void audioProcessorChanged (AudioProcessor*, const ChangeDetails& details) override
+    {
+        if (details.latencyChanged)
+        {
+            setLatencySamples (inner->getLatencySamples() + fixedBlockSize);
+
+            // plugins report this from any thread, and resizing the delay line allocates
+            triggerAsyncUpdate();
+        }
+        else
+        {
+            updateHostDisplay (details);
+        }
+    }
+
+    // brings the bypass delay line into line with a latency the plugin changed after it was prepared
+    void handleAsyncUpdate() override
+    {
+        const SpinLock::ScopedLockType lock (innerProcessBlockFlag);
+
+        if (! isPrepared || floatBypassDelay.getDelay() == getLatencySamples())
+            return;
+
+        const auto numChannels = jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+        floatBypassDelay .prepare (numChannels, getLatencySamples());
+        doubleBypassDelay.prepare (numChannels, getLatencySamples());
+    }
+
+    ProcessingPrecision getInnerPrecision() const
+    {
+        return getRequiredPrecision().value_or (getProcessingPrecision());
+    }
+
+    int getInnerBlockSize() const noexcept
+    {
+        if (fixedBlockSize > 0)
+            return fixedBlockSize;
+
+        if (maxBlockSize > 0)
+            return jmin (maxBlockSize, hostBlockSize);
+
+        return hostBlockSize;
+    }
+
+    void prepareInner()
+    {
+        const auto innerBlockSize = getInnerBlockSize();
+        const auto innerPrecision = getInnerPrecision();
+        const auto numChannels = jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+        inner->setProcessingPrecision (innerPrecision);
+        inner->setRateAndBufferSizeDetails (hostSampleRate, innerBlockSize);
+        inner->prepareToPlay (hostSampleRate, innerBlockSize);
+
+        if (fixedBlockSize > 0)
+        {
+            if (innerPrecision == doublePrecision)
+                doubleFifo.prepare (numChannels, fixedBlockSize);
+            else
+                floatFifo.prepare (numChannels, fixedBlockSize);
+        }
+
+        // only nodes at a precision boundary need a conversion buffer
+        innerUsesDouble = innerPrecision == doublePrecision;
+        const auto needsConversion = innerPrecision != getProcessingPrecision();
+
+        floatConversionBuffer .setSize (numChannels, needsConversion && ! innerUsesDouble ? hostBlockSize : 0);
+        doubleConversionBuffer.setSize (numChannels, needsConversion &&   innerUsesDouble ? hostBlockSize : 0);
+
+        for (auto* m : { &chunkMidi, &collectedMidi, &conversionChunkMidi, &conversionCollectedMidi })
+            m->ensureSize (2048);
+
+        setLatencySamples (inner->getLatencySamples() + fixedBlockSize);
+
+        floatBypassDelay .prepare (numChannels, getLatencySamples());
+        doubleBypassDelay.prepare (numChannels, getLatencySamples());
+        watchdogResetPending = true;
+    }
+
+    template <typename SampleType>
+    FixedBlockFifo<SampleType>& getFifo() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatFifo;
+        else
+            return doubleFifo;
+    }
+
+    template <typename SampleType>
+    AudioBuffer<SampleType>& getConversionBuffer() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatConversionBuffer;
+        else
+            return doubleConversionBuffer;
+    }
+
+    template <typename SampleType>
+    BypassDelayLine<SampleType>& getBypassDelay() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatBypassDelay;
+        else
+            return doubleBypassDelay;
+    }
+
+    /** Temporarily re-enables denormal support on the current thread. */
+    struct ScopedDenormalSupport
+    {
+        explicit ScopedDenormalSupport (bool shouldAllow) noexcept
+            : shouldRestore (shouldAllow && FloatVectorOperations::areDenormalsDisabled())
+        {
+            if (shouldRestore)
+                FloatVectorOperations::disableDenormalisedNumberSupport (false);
+        }
+
+        ~ScopedDenormalSupport() noexcept
+        {
+            if (shouldRestore)
+                FloatVectorOperations::disableDenormalisedNumberSupport (true);
+        }
+
+        const bool shouldRestore;
+    };
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& buffer, MidiBuffer& midi, bool bypassed)
+    {
+        const SpinLock::ScopedTryLockType scope (innerProcessBlockFlag);
+
+        // the plugin is being re-prepared on another thread. The bypass delay lines are being
+        // re-prepared too, so silence is the only safe output; passing the input through would
+        // skip the latency compensation and leave any extra outputs uninitialised
+        if (! scope.isLocked())
+        {
+            buffer.clear();
+            midi.clear();
+            return;
+        }
+
+        const auto budgetShare = watchdogBudgetShare.load (std::memory_order_relaxed);
+        const auto watchdogEnabled = budgetShare > 0.0;
+        auto& bypassDelay = getBypassDelay<SampleType>();
+
+        if (watchdogEnabled)
+        {
+            // the plugin isn't called at all, in case whatever is stalling it is still going on
+            if (watchdogTripped.load (std::memory_order_relaxed))
+            {
+                bypassDelay.process (buffer, getTotalNumInputChannels());
+                return;
+            }
+
+            bypassDelay.push (buffer, getTotalNumInputChannels());
+        }
+
+        const auto mode = diagnosticMode.load (std::memory_order_relaxed);
+        const ScopedDenormalSupport denormalSupport (denormalsAllowed.load (std::memory_order_relaxed)
+                                                     || mode == DiagnosticMode::ieee);
+
+        if (mode == DiagnosticMode::off && ! watchdogEnabled)
+        {
+            processAtHostPrecision (buffer, midi, bypassed);
+            return;
+        }
+
+        // the watchdog times each of the plugin's own blocks, since a fixed-size one can run a
+        // whole block inside one small host callback, or none at all
+        activeWatchdogShare = watchdogEnabled ? budgetShare : 0.0;
+
+        const auto startTicks = Time::getHighResolutionTicks();
+        processAtHostPrecision (buffer, midi, bypassed);
+        const auto elapsedTicks = Time::getHighResolutionTicks() - startTicks;
+
+        activeWatchdogShare = 0.0;
+
+        // must happen while denormal support is still enabled, or subnormals would compare equal to zero
+        if (mode != DiagnosticMode::off)
+            recordDiagnostics (buffer, elapsedTicks);
+    }
+
+    void recordWatchdog (int numSamples, int64 elapsedTicks, double budgetShare) noexcept
+    {
+        if (watchdogResetPending.exchange (false))
+            overrunHistory = 0;
+
+        if (numSamples <= 0 || hostSampleRate <= 0.0)
+            return;
+
+        const auto load = Time::highResolutionTicksToSeconds (elapsedTicks) * hostSampleRate / (double) numSamples;
+        const auto overran = load > budgetShare;
+
+        const auto windowSize = watchdogWindowSize.load (std::memory_order_relaxed);
+        const auto windowMask = windowSize >= 64 ? ~(uint64) 0 : (((uint64) 1 << windowSize) - 1);
+        overrunHistory = ((overrunHistory << 1) | (overran ? 1u : 0u)) & windowMask;
+
+        if (overran)
+            worstOverrunLoad = jmax (worstOverrunLoad, load);
+
+        if (overran && countNumberOfBits (overrunHistory) >= watchdogMaxOverruns.load (std::memory_order_relaxed))
+        {
+            watchdogTripLoad.store (worstOverrunLoad, std::memory_order_relaxed);
+            watchdogTripCount.store (watchdogTripCount.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            watchdogTripped = true;
+            overrunHistory = 0;
+            worstOverrunLoad = 0.0;
+        }
+        else if (overrunHistory == 0)
+        {
+            worstOverrunLoad = 0.0;
+        }
+    }
+
+    template <typename SampleType>
+    void recordDiagnostics (const AudioBuffer<SampleType>& buffer, int64 elapsedTicks) noexcept
+    {
+        if (diagnosticResetPending.exchange (false))
+        {
+            diagnosticNumBlocks.store (0, std::memory_order_relaxed);
+            diagnosticNumSamples.store (0, std::memory_order_relaxed);
+            diagnosticNumSubnormals.store (0, std::memory_order_relaxed);
+            diagnosticSeconds.store (0.0, std::memory_order_relaxed);
+            return;
+        }
+
+        const auto numChannels = jmin (buffer.getNumChannels(), getTotalNumOutputChannels());
+        const auto numSamples = buffer.getNumSamples();
+        int64 numSubnormals = 0;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* data = buffer.getReadPointer (ch);
+
+            for (int i = 0; i < numSamples; ++i)
+                if (std::fpclassify (data[i]) == FP_SUBNORMAL)
+                    ++numSubnormals;
+        }
+
+        diagnosticNumBlocks.store (diagnosticNumBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        diagnosticNumSamples.store (diagnosticNumSamples.load (std::memory_order_relaxed) + numChannels * numSamples, std::memory_order_relaxed);
+        diagnosticNumSubnormals.store (diagnosticNumSubnormals.load (std::memory_order_relaxed) + numSubnormals, std::memory_order_relaxed);
+        diagnosticSeconds.store (diagnosticSeconds.load (std::memory_order_relaxed) + Time::highResolutionTicksToSeconds (elapsedTicks),
+                                 std::memory_order_relaxed);
+    }
+
+    template <typename SampleType>
+    void processAtHostPrecision (AudioBuffer<SampleType>& buffer, MidiBuffer& midi, bool bypassed)
+    {
+        if (innerUsesDouble == std::is_same_v<SampleType, double>)
+        {
+            processAtInnerPrecision (buffer, midi, bypassed);
+            return;
+        }
+
+        using InnerType = std::conditional_t<std::is_same_v<SampleType, float>, double, float>;
+        auto& conversionBuffer = getConversionBuffer<InnerType>();
+
+        if (conversionBuffer.getNumSamples() == 0)
+        {
+            jassertfalse;
+            return;
+        }
+
+        // the host may occasionally exceed the block size it prepared with, so convert in chunks
+        processInSubBlocks (buffer, midi, conversionBuffer.getNumSamples(), conversionChunkMidi, conversionCollectedMidi,
+                            [this, &conversionBuffer, bypassed] (AudioBuffer<SampleType>& chunk, MidiBuffer& chunkMidiIn)
+                            {
+                                const auto numChannels = jmin (chunk.getNumChannels(), conversionBuffer.getNumChannels());
+                                const auto numSamples = chunk.getNumSamples();
+
+                                AudioBuffer<InnerType> innerBuffer (conversionBuffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+                                SampleConversion::convert (chunk, innerBuffer, numChannels, numSamples);
+                                processAtInnerPrecision (innerBuffer, chunkMidiIn, bypassed);
+                                SampleConversion::convert (innerBuffer, chunk, numChannels, numSamples);
+                            });
+    }
+
+    template <typename SampleType>
+    void processAtInnerPrecision (AudioBuffer<SampleType>& buffer, MidiBuffer& midi, bool bypassed)
+    {
+        auto processInner = [this, bypassed] (AudioBuffer<SampleType>& b, MidiBuffer& m)
+        {
+            const auto startTicks = activeWatchdogShare > 0.0 ? Time::getHighResolutionTicks() : 0;
+
+            if (bypassed)
+                inner->processBlockBypassed (b, m);
+            else
+                inner->processBlock (b, m);
+
+            if (activeWatchdogShare > 0.0)
+                recordWatchdog (b.getNumSamples(), Time::getHighResolutionTicks() - startTicks, activeWatchdogShare);
+        };
+
+        if (fixedBlockSize > 0)
+            getFifo<SampleType>().process (buffer, midi, processInner);
+        else
+            processInSubBlocks (buffer, midi, maxBlockSize, chunkMidi, collectedMidi, processInner);
+    }
+
+    //==============================================================================
+    std::unique_ptr<AudioPluginInstance> inner;
+
+    // Used for mutual exclusion between the audio thread and re-preparation
+    SpinLock innerProcessBlockFlag;
+
+    bool matchingInnerBuses = false;
+
+    double hostSampleRate = 44100.0;
+    int hostBlockSize = 512, hostNumChannels = 0;
+    ProcessingPrecision hostPrecision = singlePrecision;
+    bool isPrepared = false, preparedAhead = false;
+    std::atomic<double> lastPrepareMs { 0.0 };
+
+    int fixedBlockSize = 0, maxBlockSize = 0;
+    FixedBlockFifo<float> floatFifo;
+    FixedBlockFifo<double> doubleFifo;
+    MidiBuffer chunkMidi, collectedMidi;
+
+    PrecisionPreference precisionPreference = PrecisionPreference::automatic;
+    bool innerUsesDouble = false;
+    AudioBuffer<float> floatConversionBuffer;
+    AudioBuffer<double> doubleConversionBuffer;
+    MidiBuffer conversionChunkMidi, conversionCollectedMidi;
+
+    std::atomic<bool> denormalsAllowed { false };
+    bool concurrentPrepareAllowed = false;
+    std::atomic<DiagnosticMode> diagnosticMode { DiagnosticMode::off };
+    std::atomic<bool> diagnosticResetPending { false };
+
+    // only written by the audio thread
+    std::atomic<int64> diagnosticNumBlocks { 0 }, diagnosticNumSamples { 0 }, diagnosticNumSubnormals { 0 };
+    std::atomic<double> diagnosticSeconds { 0.0 };
+
+    BypassDelayLine<float> floatBypassDelay;
+    BypassDelayLine<double> doubleBypassDelay;
+    std::atomic<double> watchdogBudgetShare { 0.0 };
+    std::atomic<int> watchdogWindowSize { 16 }, watchdogMaxOverruns { 4 };
+    std::atomic<bool> watchdogTripped { false }, watchdogResetPending { false };
+    std::atomic<int> watchdogTripCount { 0 };
+    std::atomic<double> watchdogTripLoad { 0.0 };
+
+    // only touched by the audio thread
+    double activeWatchdogShare = 0.0;
+    uint64 overrunHistory = 0;
+    double worstOverrunLoad = 0.0;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HostedPluginInstance)
+};
@@ -0,0 +1,179 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "NullAudioIODevice.h"
+#include "ClockedAudioIODevice.h"
+
+static const char* const nullTypeName = "Null Audio";
+
+//==============================================================================
+class NullAudioIODevice final : public ClockedAudioIODevice
+{
+public:
+    NullAudioIODevice (const String& deviceName, const NullAudioIODeviceType::Options& optionsToUse, bool shouldFreeRun)
+        : ClockedAudioIODevice (deviceName, nullTypeName, "Null Audio Device"),
+          options (optionsToUse),
+          freeRunning (shouldFreeRun)
+    {
+    }
+
+    ~NullAudioIODevice() override
+    {
+        close();
+    }
+
+    //==============================================================================
+    Array<double> getAvailableSampleRates() override    { return options.sampleRates; }
+    Array<int> getAvailableBufferSizes() override       { return options.bufferSizes; }
+
+    int getDefaultBufferSize() override
+    {
+        return options.bufferSizes.contains (256) ? 256 : options.bufferSizes.getFirst();
+    }
+
+private:
+    //==============================================================================
+    int getNumChannels (bool isInput) const override    { return isInput ? options.numInputChannels : options.numOutputChannels; }
+    bool isFreeRunning() const override                 { return freeRunning; }
+
+    double getDefaultSampleRate() override
+    {
+        return options.sampleRates.contains (48000.0) ? 48000.0 : options.sampleRates.getFirst();
+    }
+
+    // every run starts from the same seed and phase, so that it sees the same callbacks
+    void opened() override
+    {
+        random.setSeed (options.seed);
+        tonePhase = 0.0;
+    }
+
+    double getSlotOffsetMs() override
+    {
+        return options.jitterMs > 0.0 ? (random.nextDouble() * 2.0 - 1.0) * options.jitterMs : 0.0;
+    }
+
+    void fillInput (AudioBuffer<float>& input) override
+    {
+        if (options.inputToneHz <= 0.0)
+            return;
+
+        const auto increment = MathConstants<double>::twoPi * options.inputToneHz / getCurrentSampleRate();
+
+        for (int i = 0; i < input.getNumSamples(); ++i)
+        {
+            const auto sample = (float) (0.1 * std::sin (tonePhase));
+
+            for (int ch = 0; ch < input.getNumChannels(); ++ch)
+                input.setSample (ch, i, sample);
+
+            tonePhase += increment;
+        }
+
+        tonePhase = std::fmod (tonePhase, MathConstants<double>::twoPi);
+    }
+
+    //==============================================================================
+    const NullAudioIODeviceType::Options options;
+    const bool freeRunning;
+
+    Random random;
+    double tonePhase = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NullAudioIODevice)
+};
+
+//==============================================================================
+NullAudioIODeviceType::Options NullAudioIODeviceType::Options::fromXml (const XmlElement* xml)
+{
+    Options o;
+
+    if (xml == nullptr)
+        return o;
+
+    o.numInputChannels = jlimit (0, 64, xml->getIntAttribute ("inputs", o.numInputChannels));
+    o.numOutputChannels = jlimit (1, 64, xml->getIntAttribute ("outputs", o.numOutputChannels));
+
+    if (xml->hasAttribute ("rates"))
+    {
+        Array<double> rates;
+
+        for (auto& s : StringArray::fromTokens (xml->getStringAttribute ("rates"), ",", {}))
+            if (s.getDoubleValue() > 0.0)
+                rates.addUsingDefaultSort (s.getDoubleValue());
+
+        if (! rates.isEmpty())
+            o.sampleRates = rates;
+    }
+
+    if (xml->hasAttribute ("bufferSizes"))
+    {
+        Array<int> sizes;
+
+        for (auto& s : StringArray::fromTokens (xml->getStringAttribute ("bufferSizes"), ",", {}))
+            if (s.getIntValue() > 0)
+                sizes.addUsingDefaultSort (s.getIntValue());
+
+        if (! sizes.isEmpty())
+            o.bufferSizes = sizes;
+    }
+
+    o.jitterMs = jmax (0.0, xml->getDoubleAttribute ("jitterMs", o.jitterMs));
+    o.seed = xml->getStringAttribute ("seed", String (o.seed)).getLargeIntValue();
+    o.inputToneHz = jmax (0.0, xml->getDoubleAttribute ("toneHz", o.inputToneHz));
+    return o;
+}
+
+NullAudioIODeviceType::NullAudioIODeviceType (const Options& optionsToUse)
+    : AudioIODeviceType (nullTypeName),
+      options (optionsToUse)
+{
+}
+
+NullAudioIODeviceType::~NullAudioIODeviceType() = default;
+
+void NullAudioIODeviceType::addTo (AudioDeviceManager& deviceManager, const Options& options)
+{
+    // the built-in types are only created while the list is empty, so make sure they're there first
+    deviceManager.getAvailableDeviceTypes();
+    deviceManager.addAudioDeviceType (std::make_unique<NullAudioIODeviceType> (options));
+}
+
+StringArray NullAudioIODeviceType::getDeviceNames (bool) const
+{
+    return { timedDeviceName, freeRunningDeviceName };
+}
+
+int NullAudioIODeviceType::getDefaultDeviceIndex (bool) const
+{
+    return 0;
+}
+
+int NullAudioIODeviceType::getIndexOfDevice (AudioIODevice* device, bool asInput) const
+{
+    if (dynamic_cast<NullAudioIODevice*> (device) != nullptr)
+        return getDeviceNames (asInput).indexOf (device->getName());
+
+    return -1;
+}
+
+AudioIODevice* NullAudioIODeviceType::createDevice (const String& outputDeviceName, const String& inputDeviceName)
+{
+    const auto name = outputDeviceName.isNotEmpty() ? outputDeviceName : inputDeviceName;
+
+    if (! getDeviceNames (false).contains (name))
+        return nullptr;
+
+    return new NullAudioIODevice (name, options, name == freeRunningDeviceName);
+}
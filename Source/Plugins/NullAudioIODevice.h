@@ -0,0 +1,81 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Stand-in devices for machines with no sound card, which give the same
+    callbacks on every run, so the whole app can be run and measured there.
+
+    There are two, picked like any other through the saved audioDeviceState:
+
+      - "Null Device" calls back on the ClockedAudioIODevice clock at the block
+        rate, as hardware would, optionally with jitter added to each callback's
+        timing, and counts the xruns.
+      - "Null Device (Free-Running)" calls back again as soon as each callback
+        returns, for measuring throughput.
+
+    The sample rate, block size and active channels come from the device setup
+    as usual. The input is silence or a sine, and the jitter comes from a seeded
+    generator, so two runs with the same options see the same callbacks.
+*/
+class NullAudioIODeviceType final : public AudioIODeviceType
+{
+public:
+    struct Options
+    {
+        int numInputChannels = 2, numOutputChannels = 2;
+        Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+        Array<int> bufferSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+        /** The most a timed callback is moved early or late from its slot. */
+        double jitterMs = 0.0;
+        int64 seed = 1;
+
+        /** The frequency of the sine on every input channel, or 0 for silence. */
+        double inputToneHz = 0.0;
+
+        /** Reads the options from an element like
+            <NULLAUDIODEVICE inputs="2" outputs="2" rates="48000" bufferSizes="64,256"
+                             jitterMs="0.5" seed="1" toneHz="1000"/>
+            where every attribute is optional.
+        */
+        static Options fromXml (const XmlElement*);
+    };
+
+    explicit NullAudioIODeviceType (const Options& = {});
+    ~NullAudioIODeviceType() override;
+
+    /** Adds a null type to the device manager, so that a saved state can pick it. */
+    static void addTo (AudioDeviceManager&, const Options& = {});
+
+    static constexpr const char* timedDeviceName = "Null Device";
+    static constexpr const char* freeRunningDeviceName = "Null Device (Free-Running)";
+
+    //==============================================================================
+    void scanForDevices() override                          {}
+    StringArray getDeviceNames (bool wantInputNames) const override;
+    int getDefaultDeviceIndex (bool forInput) const override;
+    int getIndexOfDevice (AudioIODevice*, bool asInput) const override;
+    bool hasSeparateInputsAndOutputs() const override       { return false; }
+    AudioIODevice* createDevice (const String& outputDeviceName, const String& inputDeviceName) override;
+
+private:
+    //==============================================================================
+    const Options options;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NullAudioIODeviceType)
+};
@@ -0,0 +1,335 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include <map>
+#include "../UI/MainHostWindow.h"
+#include "OfflineRenderer.h"
+#include "GraphRenderEngine.h"
+#include "InternalPlugins.h"
+
+//==============================================================================
+struct OfflineRenderer::Worker final : public Thread
+{
+    Worker (OfflineRenderer& ownerIn, std::unique_ptr<PluginGraph> graphIn)
+        : Thread ("Offline Render"),
+          owner (ownerIn),
+          graph (std::move (graphIn)),
+          engine (graph->graph)
+    {
+        engine.setProcessingRate (graph->getProcessingRate());
+        engine.setMaxGraphBlockSize (graph->getMaxGraphBlockSize());
+        engine.setNonRealtime (true);
+
+        if (graph->shouldUseDoublePrecision())
+            engine.setProcessingPrecision (AudioProcessor::doublePrecision);
+    }
+
+    ~Worker() override
+    {
+        stopThread (-1);
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            const auto index = owner.nextJob++;
+
+            if (index >= owner.jobs.size() || threadShouldExit())
+                return;
+
+            owner.render (owner.jobs[index], *this);
+            ++owner.numJobsFinished;
+        }
+    }
+
+    // the graph rebuilds itself asynchronously unless it's prepared on the message thread,
+    // and an offline render can't play silence while it waits
+    bool prepare (int numChannels, double sampleRate, int blockSize)
+    {
+        auto prepared = std::make_shared<WaitableEvent>();
+
+        MessageManager::callAsync ([this, prepared, numChannels, sampleRate, blockSize]
+        {
+            engine.setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+            engine.prepareToPlay (sampleRate, blockSize);
+            prepared->signal();
+        });
+
+        while (! prepared->wait (100))
+            if (threadShouldExit())
+                return false;
+
+        return true;
+    }
+
+    OfflineRenderer& owner;
+    std::unique_ptr<PluginGraph> graph;
+    GraphRenderEngine engine;
+    AudioBuffer<double> doubleBuffer;
+    MidiBuffer midi;
+};
+
+//==============================================================================
+OfflineRenderer::OfflineRenderer()
+{
+    addDefaultFormatsToManager (pluginFormats);
+    pluginFormats.addFormat (std::make_unique<InternalPluginFormat>());
+
+    audioFormats.registerBasicFormats();
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+    stopTimer();
+
+    for (auto& w : workers)
+        w->signalThreadShouldExit();
+
+    workers.clear();
+}
+
+bool OfflineRenderer::start (const StringArray& args)
+{
+    File preset, outputDirectory;
+    String formatName ("wav");
+    int numThreads = SystemStats::getNumCpus();
+
+    for (int i = args.indexOf ("--render") + 1; i < args.size(); ++i)
+    {
+        const auto& arg = args[i];
+
+        if      (arg.startsWith ("--output-dir="))  outputDirectory = File::getCurrentWorkingDirectory().getChildFile (arg.fromFirstOccurrenceOf ("=", false, false).unquoted());
+        else if (arg.startsWith ("--format="))      formatName = arg.fromFirstOccurrenceOf ("=", false, false).toLowerCase();
+        else if (arg.startsWith ("--threads="))     numThreads = arg.fromFirstOccurrenceOf ("=", false, false).getIntValue();
+        else if (arg.startsWith ("--block-size="))  blockSize = arg.fromFirstOccurrenceOf ("=", false, false).getIntValue();
+        else if (arg.startsWith ("--"))             continue;
+        else if (preset == File())                  preset = File::getCurrentWorkingDirectory().getChildFile (arg.unquoted());
+        else                                        jobs.push_back ({ File::getCurrentWorkingDirectory().getChildFile (arg.unquoted()), {} });
+    }
+
+    auto fail = [] (const String& message)
+    {
+        std::cout << message << std::endl;
+        return false;
+    };
+
+    if (! preset.existsAsFile() || jobs.empty())
+        return fail ("Usage: --render preset" + String (PluginGraph::getFilenameSuffix())
+                       + " file... [--output-dir=dir] [--format=wav|ogg] [--threads=n] [--block-size=n]");
+
+    if (formatName == "wav")        outputFormat = std::make_unique<WavAudioFormat>();
+    else if (formatName == "ogg")   outputFormat = std::make_unique<OggVorbisAudioFormat>();
+    else                            return fail ("Unknown output format " + formatName.quoted() + "; use wav or ogg");
+
+    if (outputDirectory != File() && ! outputDirectory.createDirectory())
+        return fail ("Couldn't create " + outputDirectory.getFullPathName());
+
+    blockSize = jlimit (32, 65536, blockSize);
+
+    // built in one go; withFileExtension() would take the preset's name for an extension and replace it
+    const auto extension = outputFormat->getFileExtensions()[0];
+    std::map<File, File> inputsByOutput;
+
+    for (auto& job : jobs)
+    {
+        const auto directory = outputDirectory != File() ? outputDirectory : job.input.getParentDirectory();
+        job.output = directory.getChildFile (job.input.getFileNameWithoutExtension() + "." + preset.getFileNameWithoutExtension() + extension);
+
+        const auto [it, added] = inputsByOutput.emplace (job.output, job.input);
+
+        if (! added)
+            return fail (it->second.getFullPathName() + " and " + job.input.getFullPathName()
+                           + " would both render to " + job.output.getFullPathName());
+    }
+
+    // an output mustn't replace an input; it's deleted before it's written, and the input may not be read yet
+    for (auto& job : jobs)
+        if (auto it = inputsByOutput.find (job.input); it != inputsByOutput.end())
+            return fail ("Rendering " + it->second.getFullPathName() + " would overwrite " + job.input.getFullPathName());
+
+    // the saved descriptions are enough to create the plugins; the index finds any that have moved
+    pluginDatabase.reset (new PluginDatabase (getAppProperties().getUserSettings()->getFile().getSiblingFile ("PluginDatabase.bin")));
+
+    if (pluginDatabase->open())
+        pluginDatabase->addTypesTo (knownPlugins);
+
+    numThreads = jlimit (1, (int) jobs.size(), numThreads);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        auto graph = std::make_unique<PluginGraph> (pluginFormats, knownPlugins);
+        graph->setPluginWindowsEnabled (false);
+        graph->setPluginDatabase (pluginDatabase.get());
+
+        // not loadFrom(), which would add the preset to the recent files
+        const auto result = graph->loadDocument (preset);
+
+        if (result.failed())
+            return fail ("Couldn't load " + preset.getFullPathName() + ": " + result.getErrorMessage());
+
+        workers.push_back (std::make_unique<Worker> (*this, std::move (graph)));
+    }
+
+    std::cout << "Rendering " << jobs.size() << " file(s) through " << preset.getFileName()
+              << " on " << numThreads << " thread(s), " << blockSize << " samples per block" << std::endl;
+
+    startMs = Time::getMillisecondCounterHiRes();
+
+    for (auto& w : workers)
+        w->startThread();
+
+    startTimer (100);
+    return true;
+}
+
+void OfflineRenderer::render (Job& job, Worker& worker)
+{
+    const auto startedMs = Time::getMillisecondCounterHiRes();
+
+    std::unique_ptr<AudioFormatReader> reader (audioFormats.createReaderFor (job.input));
+
+    if (reader == nullptr)
+    {
+        job.error = "couldn't read the file";
+        return;
+    }
+
+    const auto numChannels = (int) reader->numChannels;
+    const auto sampleRate = reader->sampleRate;
+    const auto length = reader->lengthInSamples;
+
+    job.output.deleteFile();
+    auto stream = job.output.createOutputStream();
+
+    if (stream == nullptr)
+    {
+        job.error = "couldn't write " + job.output.getFullPathName();
+        return;
+    }
+
+    const auto qualityOptions = outputFormat->getQualityOptions();
+    std::unique_ptr<AudioFormatWriter> writer (outputFormat->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels,
+                                                                              outputFormat->getPossibleBitDepths().contains (24) ? 24 : 16,
+                                                                              {}, jmax (0, qualityOptions.size() - 3)));
+    if (writer == nullptr)
+    {
+        job.error = outputFormat->getFormatName() + " can't hold " + String (numChannels) + " channels at " + String (sampleRate) + " Hz";
+        return;
+    }
+
+    stream.release();
+
+    if (! worker.prepare (numChannels, sampleRate, blockSize))
+    {
+        job.error = "cancelled";
+        return;
+    }
+
+    auto& engine = worker.engine;
+    const auto graphRate = engine.getProcessingRate() > 0.0 ? engine.getProcessingRate() : sampleRate;
+    auto samplesToSkip = (int64) engine.getLatencySamples()
+                       + (int64) roundToInt (worker.graph->graph.getLatencySamples() * sampleRate / graphRate);
+
+    AudioBuffer<float> buffer (numChannels, blockSize);
+    int64 readPosition = 0, numWritten = 0;
+
+    while (numWritten < length)
+    {
+        if (worker.threadShouldExit())
+        {
+            job.error = "cancelled";
+            return;
+        }
+
+        buffer.clear();
+
+        if (readPosition < length)
+            reader->read (&buffer, 0, (int) jmin ((int64) blockSize, length - readPosition), readPosition, true, true);
+
+        readPosition += blockSize;
+
+        if (engine.isUsingDoublePrecision())
+        {
+            worker.doubleBuffer.makeCopyOf (buffer, true);
+            engine.processBlock (worker.doubleBuffer, worker.midi);
+            buffer.makeCopyOf (worker.doubleBuffer, true);
+        }
+        else
+        {
+            engine.processBlock (buffer, worker.midi);
+        }
+
+        worker.midi.clear();
+
+        // the first samples out are the graph's latency; padding the end with silence makes up for them
+        const auto skipped = (int) jmin ((int64) blockSize, samplesToSkip);
+        samplesToSkip -= skipped;
+
+        const auto numToWrite = (int) jmin ((int64) (blockSize - skipped), length - numWritten);
+
+        if (numToWrite > 0 && ! writer->writeFromAudioSampleBuffer (buffer, skipped, numToWrite))
+        {
+            job.error = "couldn't write " + job.output.getFullPathName();
+            return;
+        }
+
+        numWritten += jmax (0, numToWrite);
+    }
+
+    job.audioSeconds = (double) length / sampleRate;
+    job.renderSeconds = (Time::getMillisecondCounterHiRes() - startedMs) / 1000.0;
+}
+
+void OfflineRenderer::timerCallback()
+{
+    if (numJobsFinished < (int) jobs.size())
+        return;
+
+    stopTimer();
+    report();
+}
+
+void OfflineRenderer::report()
+{
+    const auto wallSeconds = (Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+    double totalAudioSeconds = 0.0;
+    int numFailed = 0;
+
+    std::cout << "file                                 audio s   render s   x real time" << std::endl;
+
+    for (auto& job : jobs)
+    {
+        if (job.error.isNotEmpty())
+        {
+            std::cout << job.input.getFileName().paddedRight (' ', 34) << "  failed: " << job.error << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        totalAudioSeconds += job.audioSeconds;
+
+        std::cout << job.input.getFileName().paddedRight (' ', 34)
+                  << String (job.audioSeconds, 1).paddedLeft (' ', 10)
+                  << String (job.renderSeconds, 2).paddedLeft (' ', 11)
+                  << String (job.audioSeconds / jmax (1.0e-6, job.renderSeconds), 1).paddedLeft (' ', 14) << std::endl;
+    }
+
+    std::cout << "total " << String (totalAudioSeconds, 1) << " s of audio in " << String (wallSeconds, 2) << " s, "
+              << String (totalAudioSeconds / jmax (1.0e-6, wallSeconds), 1) << "x real time" << std::endl;
+
+    JUCEApplication::getInstance()->setApplicationReturnValue (numFailed > 0 ? 1 : 0);
+    JUCEApplication::quit();
+}
@@ -0,0 +1,77 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginDatabase.h"
+
+//==============================================================================
+/**
+    Renders audio files through a preset offline, as fast as the plugins allow:
+
+        curve --render preset.filtergraph file... [--output-dir=dir] [--format=wav|ogg]
+                                                  [--threads=n] [--block-size=n]
+
+    Each worker thread has its own copy of the graph, running non-realtime at a
+    large block size, and takes the next file from the list until none are left.
+    The output is compensated for the graph's latency, so it lines up with the
+    input and has the same length. It's written next to the input unless an
+    output directory is given, named after the input and the preset.
+
+    When every file is done, the time each one took and the real-time factor are
+    printed and the app quits.
+*/
+class OfflineRenderer final : private Timer
+{
+public:
+    OfflineRenderer();
+    ~OfflineRenderer() override;
+
+    /** Parses the command line, loads a graph for each worker on the message thread,
+        and starts rendering. Prints the problem and returns false if it can't start.
+    */
+    bool start (const StringArray& commandLineArguments);
+
+private:
+    //==============================================================================
+    struct Job
+    {
+        File input, output;
+        double audioSeconds = 0.0, renderSeconds = 0.0;
+        String error;
+    };
+
+    struct Worker;
+
+    void render (Job&, Worker&);
+    void timerCallback() override;
+    void report();
+
+    //==============================================================================
+    AudioPluginFormatManager pluginFormats;
+    KnownPluginList knownPlugins;
+    std::unique_ptr<PluginDatabase> pluginDatabase;
+    AudioFormatManager audioFormats;
+
+    std::unique_ptr<AudioFormat> outputFormat;
+    int blockSize = 4096;
+    std::vector<Job> jobs;
+    std::atomic<size_t> nextJob { 0 };
+    std::atomic<int> numJobsFinished { 0 };
+    double startMs = 0.0;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OfflineRenderer)
+};
@@ -0,0 +1,445 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginDatabase.h"
+
+static constexpr int databaseMagic = 0x42445043;    // "CPDB", little-endian
+static constexpr int databaseVersion = 1;
+static constexpr int headerSize = 8;
+
+static String getUniqueIdKey (const String& formatName, int uniqueId)                  { return formatName + "|" + String (uniqueId); }
+static String getIdentifierKey (const String& formatName, const String& identifier)     { return formatName + "|" + identifier; }
+
+//==============================================================================
+PluginDatabase::PluginDatabase (const File& databaseFile)
+    : file (databaseFile)
+{
+}
+
+PluginDatabase::~PluginDatabase() = default;
+
+String PluginDatabase::getKey (const String& formatName, const String& fileOrIdentifier, int uniqueId)
+{
+    // the same identity that KnownPluginList uses to spot duplicates
+    return formatName + "|" + fileOrIdentifier + "|" + String (uniqueId);
+}
+
+String PluginDatabase::getKey (const PluginDescription& d)
+{
+    return getKey (d.pluginFormatName, d.fileOrIdentifier, d.uniqueId);
+}
+
+MemoryBlock PluginDatabase::serialise (const PluginDescription& d)
+{
+    MemoryOutputStream out;
+
+    for (auto* s : { &d.name, &d.descriptiveName, &d.pluginFormatName, &d.category,
+                     &d.manufacturerName, &d.version, &d.fileOrIdentifier })
+        out.writeString (*s);
+
+    out.writeInt64 (d.lastFileModTime.toMilliseconds());
+    out.writeInt64 (d.lastInfoUpdateTime.toMilliseconds());
+    out.writeInt (d.deprecatedUid);
+    out.writeInt (d.uniqueId);
+    out.writeInt (d.numInputChannels);
+    out.writeInt (d.numOutputChannels);
+    out.writeByte ((char) ((d.isInstrument ? 1 : 0) | (d.hasSharedContainer ? 2 : 0) | (d.hasARAExtension ? 4 : 0)));
+
+    return out.getMemoryBlock();
+}
+
+bool PluginDatabase::deserialise (const void* data, size_t size, PluginDescription& d)
+{
+    MemoryInputStream in (data, size, false);
+
+    for (auto* s : { &d.name, &d.descriptiveName, &d.pluginFormatName, &d.category,
+                     &d.manufacturerName, &d.version, &d.fileOrIdentifier })
+        *s = in.readString();
+
+    d.lastFileModTime    = Time (in.readInt64());
+    d.lastInfoUpdateTime = Time (in.readInt64());
+    d.deprecatedUid      = in.readInt();
+    d.uniqueId           = in.readInt();
+    d.numInputChannels   = in.readInt();
+    d.numOutputChannels  = in.readInt();
+
+    const auto flags = in.readByte();
+    d.isInstrument       = (flags & 1) != 0;
+    d.hasSharedContainer = (flags & 2) != 0;
+    d.hasARAExtension    = (flags & 4) != 0;
+
+    return in.getPosition() == (int64) size && d.pluginFormatName.isNotEmpty();
+}
+
+// checks a put record's layout and reads just what the key and the indexes need, leaving the rest undecoded
+bool PluginDatabase::readIdentity (const void* data, size_t size, Entry& entry)
+{
+    constexpr int numStrings = 7, formatNameIndex = 2, fileOrIdentifierIndex = 6;
+    constexpr size_t numericSize = 2 * sizeof (int64) + 4 * sizeof (int) + 1;
+    constexpr size_t uniqueIdOffset = 2 * sizeof (int64) + sizeof (int);
+
+    const auto* p = static_cast<const char*> (data);
+    const auto* end = p + size;
+    const char* strings[numStrings];
+
+    for (auto& s : strings)
+    {
+        s = p;
+        p = static_cast<const char*> (std::memchr (p, 0, (size_t) (end - p)));
+
+        if (p == nullptr)
+            return false;
+
+        ++p;
+    }
+
+    if ((size_t) (end - p) != numericSize)
+        return false;
+
+    entry.formatName = String::fromUTF8 (strings[formatNameIndex]);
+    entry.fileOrIdentifier = String::fromUTF8 (strings[fileOrIdentifierIndex]);
+    entry.uniqueId = (int) ByteOrder::littleEndianInt (p + uniqueIdOffset);
+    entry.record = static_cast<const char*> (data);
+    entry.recordSize = size;
+
+    return entry.formatName.isNotEmpty();
+}
+
+bool PluginDatabase::isSameDescription (const PluginDescription& a, const PluginDescription& b)
+{
+    return a.name == b.name && a.descriptiveName == b.descriptiveName && a.pluginFormatName == b.pluginFormatName
+        && a.category == b.category && a.manufacturerName == b.manufacturerName && a.version == b.version
+        && a.fileOrIdentifier == b.fileOrIdentifier
+        && a.lastFileModTime.toMilliseconds() == b.lastFileModTime.toMilliseconds()
+        && a.lastInfoUpdateTime.toMilliseconds() == b.lastInfoUpdateTime.toMilliseconds()
+        && a.deprecatedUid == b.deprecatedUid && a.uniqueId == b.uniqueId
+        && a.numInputChannels == b.numInputChannels && a.numOutputChannels == b.numOutputChannels
+        && a.isInstrument == b.isInstrument && a.hasSharedContainer == b.hasSharedContainer
+        && a.hasARAExtension == b.hasARAExtension;
+}
+
+const PluginDescription& PluginDatabase::getDescription (const Entry& entry) const
+{
+    if (! entry.description.has_value())
+    {
+        PluginDescription d;
+        const auto ok = deserialise (entry.record, entry.recordSize, d);
+        jassertquiet (ok);   // readIdentity has already checked the layout
+        entry.description = std::move (d);
+    }
+
+    return *entry.description;
+}
+
+// decodes whatever still points into the mapped file, so the file can be appended to or replaced
+void PluginDatabase::releaseMapping()
+{
+    if (mapping == nullptr)
+        return;
+
+    for (auto& [key, entry] : entries)
+    {
+        getDescription (entry);
+        entry.record = nullptr;
+        entry.recordSize = 0;
+    }
+
+    mapping.reset();
+}
+
+//==============================================================================
+void PluginDatabase::put (const String& key, Entry entry)
+{
+    if (entries.find (key) != entries.end())
+        remove (key);
+
+    keysByUniqueId[getUniqueIdKey (entry.formatName, entry.uniqueId)] = key;
+    keysByIdentifier[getIdentifierKey (entry.formatName, entry.fileOrIdentifier)] = key;
+    entries[key] = std::move (entry);
+}
+
+void PluginDatabase::remove (const String& key)
+{
+    auto it = entries.find (key);
+
+    if (it == entries.end())
+        return;
+
+    const auto& e = it->second;
+
+    // the indexes only point at one entry per slot, so leave them alone if another entry has taken it
+    for (auto [index, indexKey] : { std::make_pair (&keysByUniqueId, getUniqueIdKey (e.formatName, e.uniqueId)),
+                                    std::make_pair (&keysByIdentifier, getIdentifierKey (e.formatName, e.fileOrIdentifier)) })
+    {
+        if (auto i = index->find (indexKey); i != index->end() && i->second == key)
+            index->erase (i);
+    }
+
+    entries.erase (it);
+}
+
+void PluginDatabase::applyRecord (RecordType type, const void* data, size_t size)
+{
+    switch (type)
+    {
+        case putRecord:
+        {
+            Entry entry;
+
+            if (readIdentity (data, size, entry))
+            {
+                const auto key = getKey (entry.formatName, entry.fileOrIdentifier, entry.uniqueId);
+
+                if (entries.find (key) != entries.end())
+                    ++numSupersededRecords;
+
+                put (key, std::move (entry));
+            }
+
+            break;
+        }
+
+        case removeRecord:
+            remove (String::fromUTF8 (static_cast<const char*> (data), (int) size));
+            numSupersededRecords += 2;
+            break;
+
+        case blacklistRecord:
+            blacklist.insert (String::fromUTF8 (static_cast<const char*> (data), (int) size));
+            break;
+
+        case unblacklistRecord:
+            blacklist.erase (String::fromUTF8 (static_cast<const char*> (data), (int) size));
+            numSupersededRecords += 2;
+            break;
+    }
+}
+
+//==============================================================================
+bool PluginDatabase::load (KnownPluginList& list)
+{
+    if (! open())
+        return false;
+
+    addTypesTo (list);
+    return true;
+}
+
+bool PluginDatabase::open()
+{
+    entries.clear();
+    keysByUniqueId.clear();
+    keysByIdentifier.clear();
+    blacklist.clear();
+    numSupersededRecords = 0;
+
+    // the entries point into the mapping, so it stays open until the first sync
+    mapping = std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+
+    // whatever is there can't be appended to, so the first sync rewrites it from scratch
+    needsCompacting = true;
+
+    if (mapping->getData() == nullptr || mapping->getSize() < (size_t) headerSize)
+    {
+        mapping.reset();
+        return false;
+    }
+
+    MemoryInputStream in (mapping->getData(), mapping->getSize(), false);
+
+    if (in.readInt() != databaseMagic || in.readInt() != databaseVersion)
+    {
+        mapping.reset();
+        return false;
+    }
+
+    needsCompacting = false;
+
+    const auto* base = static_cast<const char*> (mapping->getData());
+
+    while (! in.isExhausted())
+    {
+        const auto type = (RecordType) in.readByte();
+        const auto size = in.readInt();
+        const auto position = in.getPosition();
+
+        // a record cut short by a crash mid-write; everything before it is still good
+        if (size < 0 || position + size > in.getTotalLength())
+        {
+            needsCompacting = true;
+            break;
+        }
+
+        applyRecord (type, base + position, (size_t) size);
+        in.setPosition (position + size);
+    }
+
+    return true;
+}
+
+void PluginDatabase::addTypesTo (KnownPluginList& list) const
+{
+    for (auto& [key, entry] : entries)
+        list.addType (getDescription (entry));
+
+    for (auto& f : blacklist)
+        list.addToBlacklist (f);
+}
+
+void PluginDatabase::appendRecord (OutputStream& out, RecordType type, const MemoryBlock& payload)
+{
+    out.writeByte ((char) type);
+    out.writeInt ((int) payload.getSize());
+    out.write (payload.getData(), payload.getSize());
+}
+
+void PluginDatabase::sync (const KnownPluginList& list)
+{
+    releaseMapping();
+
+    const auto types = list.getTypes();
+    const auto blacklisted = list.getBlacklistedFiles();
+
+    std::vector<std::pair<RecordType, MemoryBlock>> records;
+    std::unordered_set<String, StringHash> currentKeys;
+
+    // only the types that are new or have changed get serialised
+    for (auto& d : types)
+    {
+        const auto key = getKey (d);
+        currentKeys.insert (key);
+
+        auto it = entries.find (key);
+
+        if (it != entries.end() && isSameDescription (getDescription (it->second), d))
+            continue;
+
+        if (it != entries.end())
+            ++numSupersededRecords;
+
+        records.emplace_back (putRecord, serialise (d));
+
+        Entry entry;
+        entry.formatName = d.pluginFormatName;
+        entry.fileOrIdentifier = d.fileOrIdentifier;
+        entry.uniqueId = d.uniqueId;
+        entry.description = d;
+        put (key, std::move (entry));
+    }
+
+    std::vector<String> removed;
+
+    for (auto& [key, entry] : entries)
+        if (currentKeys.find (key) == currentKeys.end())
+            removed.push_back (key);
+
+    for (auto& key : removed)
+    {
+        remove (key);
+        records.emplace_back (removeRecord, MemoryBlock (key.toRawUTF8(), key.getNumBytesAsUTF8()));
+        numSupersededRecords += 2;
+    }
+
+    std::unordered_set<String, StringHash> currentBlacklist (blacklisted.begin(), blacklisted.end());
+
+    for (auto& f : currentBlacklist)
+        if (blacklist.insert (f).second)
+            records.emplace_back (blacklistRecord, MemoryBlock (f.toRawUTF8(), f.getNumBytesAsUTF8()));
+
+    for (auto it = blacklist.begin(); it != blacklist.end();)
+    {
+        if (currentBlacklist.find (*it) == currentBlacklist.end())
+        {
+            records.emplace_back (unblacklistRecord, MemoryBlock (it->toRawUTF8(), it->getNumBytesAsUTF8()));
+            numSupersededRecords += 2;
+            it = blacklist.erase (it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // once most of the file is dead records, rewriting it is cheaper than reading past them at every startup
+    if (needsCompacting || ! file.existsAsFile() || numSupersededRecords > jmax (256, (int) entries.size()))
+    {
+        if (compact())
+            return;
+    }
+
+    if (records.empty())
+        return;
+
+    FileOutputStream out (file);
+
+    if (out.failedToOpen())
+        return;
+
+    for (auto& [type, payload] : records)
+        appendRecord (out, type, payload);
+
+    out.flush();
+}
+
+bool PluginDatabase::compact()
+{
+    TemporaryFile temp (file);
+
+    {
+        FileOutputStream out (temp.getFile());
+
+        if (out.failedToOpen())
+            return false;
+
+        out.writeInt (databaseMagic);
+        out.writeInt (databaseVersion);
+
+        for (auto& [key, entry] : entries)
+            appendRecord (out, putRecord, serialise (getDescription (entry)));
+
+        for (auto& f : blacklist)
+            appendRecord (out, blacklistRecord, MemoryBlock (f.toRawUTF8(), f.getNumBytesAsUTF8()));
+
+        out.flush();
+
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    if (! temp.overwriteTargetFileWithTemporary())
+        return false;
+
+    numSupersededRecords = 0;
+    needsCompacting = false;
+    return true;
+}
+
+//==============================================================================
+const PluginDescription* PluginDatabase::findByUniqueId (const String& formatName, int uniqueId) const
+{
+    if (auto it = keysByUniqueId.find (getUniqueIdKey (formatName, uniqueId)); it != keysByUniqueId.end())
+        if (auto entry = entries.find (it->second); entry != entries.end())
+            return &getDescription (entry->second);
+
+    return nullptr;
+}
+
+const PluginDescription* PluginDatabase::findByIdentifier (const String& formatName, const String& fileOrIdentifier) const
+{
+    if (auto it = keysByIdentifier.find (getIdentifierKey (formatName, fileOrIdentifier)); it != keysByIdentifier.end())
+        if (auto entry = entries.find (it->second); entry != entries.end())
+            return &getDescription (entry->second);
+
+    return nullptr;
+}
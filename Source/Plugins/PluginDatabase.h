@@ -0,0 +1,116 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+//==============================================================================
+/**
+    The persistent copy of the KnownPluginList, kept in its own binary file rather
+    than as XML in the settings file.
+
+    The file is an append-only log of put/remove records, so each change to the
+    list only writes what changed. It is read back through a memory-mapped view,
+    where each entry stays undecoded until something needs the whole description,
+    and compacted when it holds too many superseded records.
+
+    It also keeps hash indexes of the known plugins by format and unique ID, and
+    by format and file or identifier.
+*/
+class PluginDatabase
+{
+public:
+    explicit PluginDatabase (const File& databaseFile);
+    ~PluginDatabase();
+
+    /** Reads the file and fills the list from it. Returns false if there's no usable file yet. */
+    bool load (KnownPluginList&);
+
+    /** Reads the file into the indexes without touching any list, so lookups work before the
+        list itself has been built. Returns false if there's no usable file yet.
+    */
+    bool open();
+
+    /** Adds everything read by open() to the list. */
+    void addTypesTo (KnownPluginList&) const;
+
+    /** Records whatever has changed in the list since it was loaded or last synced. */
+    void sync (const KnownPluginList&);
+
+    //==============================================================================
+    const PluginDescription* findByUniqueId (const String& formatName, int uniqueId) const;
+    const PluginDescription* findByIdentifier (const String& formatName, const String& fileOrIdentifier) const;
+
+    int getNumTypes() const noexcept            { return (int) entries.size(); }
+    const File& getFile() const noexcept        { return file; }
+
+private:
+    //==============================================================================
+    enum RecordType : uint8
+    {
+        putRecord = 1,
+        removeRecord,
+        blacklistRecord,
+        unblacklistRecord
+    };
+
+    struct StringHash
+    {
+        size_t operator() (const String& s) const noexcept   { return (size_t) s.hashCode64(); }
+    };
+
+    struct Entry
+    {
+        String formatName, fileOrIdentifier;
+        int uniqueId = 0;
+
+        // points at the put record in the mapped file until the description is decoded
+        const char* record = nullptr;
+        size_t recordSize = 0;
+        mutable std::optional<PluginDescription> description;
+    };
+
+    static String getKey (const String& formatName, const String& fileOrIdentifier, int uniqueId);
+    static String getKey (const PluginDescription&);
+    static MemoryBlock serialise (const PluginDescription&);
+    static bool deserialise (const void* data, size_t size, PluginDescription&);
+    static bool readIdentity (const void* data, size_t size, Entry&);
+    static bool isSameDescription (const PluginDescription&, const PluginDescription&);
+
+    const PluginDescription& getDescription (const Entry&) const;
+    void releaseMapping();
+
+    void put (const String& key, Entry entry);
+    void remove (const String& key);
+    void applyRecord (RecordType, const void* data, size_t size);
+
+    void appendRecord (OutputStream&, RecordType, const MemoryBlock& payload);
+    bool compact();
+
+    //==============================================================================
+    const File file;
+    std::unique_ptr<MemoryMappedFile> mapping;
+
+    std::unordered_map<String, Entry, StringHash> entries;
+    std::unordered_map<String, String, StringHash> keysByUniqueId, keysByIdentifier;
+    std::unordered_set<String, StringHash> blacklist;
+
+    int numSupersededRecords = 0;
+    bool needsCompacting = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginDatabase)
+};
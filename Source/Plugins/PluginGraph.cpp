@@ -36,6 +36,9 @@
 #include "../UI/MainHostWindow.h"
 #include "PluginGraph.h"
 #include "InternalPlugins.h"
+#include "HostedPluginInstance.h"
+#include "SandboxedPluginInstance.h"
+#include "PluginDatabase.h"
 #include "../UI/GraphEditorPanel.h"
 
 static std::unique_ptr<ScopedDPIAwarenessDisabler> makeDPIAwarenessDisablerForPlugin (const PluginDescription& desc)
@@ -91,6 +94,23 @@ AudioProcessorGraph::Node::Ptr PluginGraph::getNodeForName (const String& name)
 
 void PluginGraph::addPlugin (const PluginDescriptionAndPreference& desc, Point<double> pos)
 {
+    if (auto prepared = std::exchange (preparedPlugin, nullptr);
+        prepared != nullptr && prepared->description.isDuplicateOf (desc.pluginDescription))
+    {
+        if (prepared->isReady)
+        {
+            addPluginCallback (std::move (prepared->instance), prepared->error, pos, desc.useARA);
+            return;
+        }
+
+        // still on its way; it gets added when it arrives, whatever gets prepared in the meantime
+        prepared->isWanted = true;
+        prepared->position = pos;
+        prepared->useARA = desc.useARA;
+        wantedPlugins.push_back (std::move (prepared));
+        return;
+    }
+
     std::shared_ptr<ScopedDPIAwarenessDisabler> dpiDisabler = makeDPIAwarenessDisablerForPlugin (desc.pluginDescription);
 
     formatManager.createPluginInstanceAsync (desc.pluginDescription,
@@ -102,6 +122,90 @@ void PluginGraph::addPlugin (const PluginDescriptionAndPreference& desc, Point<d
                                              });
 }
 
+void PluginGraph::preparePlugin (const PluginDescription& desc)
+{
+    if (preparedPlugin != nullptr && preparedPlugin->description.isDuplicateOf (desc))
+        return;
+
+    auto prepared = std::make_shared<PreparedPlugin>();
+    prepared->description = desc;
+    preparedPlugin = prepared;
+
+    std::shared_ptr<ScopedDPIAwarenessDisabler> dpiDisabler = makeDPIAwarenessDisablerForPlugin (desc);
+
+    // the weak pointer also guards 'this': the graph is the only thing keeping the state alive
+    formatManager.createPluginInstanceAsync (desc,
+                                             graph.getSampleRate(),
+                                             graph.getBlockSize(),
+                                             [this, weakPrepared = std::weak_ptr<PreparedPlugin> (prepared), dpiDisabler] (std::unique_ptr<AudioPluginInstance> instance, const String& error)
+                                             {
+                                                 auto p = weakPrepared.lock();
+
+                                                 if (p == nullptr)
+                                                     return;
+
+                                                 if (p->isWanted)
+                                                 {
+                                                     wantedPlugins.erase (std::remove (wantedPlugins.begin(), wantedPlugins.end(), p),
+                                                                          wantedPlugins.end());
+
+                                                     addPluginCallback (std::move (instance), error, p->position, p->useARA);
+                                                     return;
+                                                 }
+
+                                                 p->instance = std::move (instance);
+                                                 p->error = error;
+                                                 p->isReady = true;
+                                             });
+}
+
+void PluginGraph::cancelPreparedPlugin()
+{
+    preparedPlugin = nullptr;
+}
+
+static std::unique_ptr<AudioPluginInstance> wrapHostedPlugin (std::unique_ptr<AudioPluginInstance> instance)
+{
+    // Curve's own internal processors are always well-behaved, so only external plugins get wrapped
+    if (instance == nullptr || instance->getPluginDescription().pluginFormatName == InternalPluginFormat::getIdentifier())
+        return instance;
+
+    return std::make_unique<HostedPluginInstance> (std::move (instance));
+}
+
+static void applyBlockSizeOptions (AudioProcessorGraph::Node& node, int fixedBlockSize, int maxBlockSize)
+{
+    if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node.getProcessor()))
+        hosted->setBlockSizeOptions (fixedBlockSize, maxBlockSize);
+
+    node.properties.set ("fixedBlockSize", fixedBlockSize);
+    node.properties.set ("maxBlockSize", maxBlockSize);
+}
+
+static void applyDenormalsAllowed (AudioProcessorGraph::Node& node, bool shouldAllow)
+{
+    if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node.getProcessor()))
+        hosted->setDenormalsAllowed (shouldAllow);
+
+    node.properties.set ("allowDenormals", shouldAllow);
+}
+
+static void applyConcurrentPrepareAllowed (AudioProcessorGraph::Node& node, bool shouldAllow)
+{
+    if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node.getProcessor()))
+        hosted->setConcurrentPrepareAllowed (shouldAllow);
+
+    node.properties.set ("prepareConcurrently", shouldAllow);
+}
+
+static void applyPrecisionPreference (AudioProcessorGraph::Node& node, HostedPluginInstance::PrecisionPreference preference)
+{
+    if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node.getProcessor()))
+        hosted->setPrecisionPreference (preference);
+
+    node.properties.set ("precision", HostedPluginInstance::toString (preference));
+}
+
 void PluginGraph::addPluginCallback (std::unique_ptr<AudioPluginInstance> instance,
                                      const String& error,
                                      Point<double> pos,
@@ -125,6 +229,7 @@ void PluginGraph::addPluginCallback (std::unique_ptr<AudioPluginInstance> instan
        #endif
 
         instance->enableAllBuses();
+        instance = wrapHostedPlugin (std::move (instance));
 
         if (auto node = graph.addNode (std::move (instance)))
         {
@@ -154,6 +259,200 @@ Point<double> PluginGraph::getNodePosition (NodeID nodeID) const
     return {};
 }
 
+void PluginGraph::setNodeBlockSizeOptions (NodeID nodeID, int fixedBlockSize, int maxBlockSize)
+{
+    if (auto* n = graph.getNodeForId (nodeID))
+    {
+        applyBlockSizeOptions (*n, fixedBlockSize, maxBlockSize);
+
+        // the node's latency may have changed, so the graph's delay compensation needs rebuilding
+        graph.rebuild();
+        changed();
+    }
+}
+
+void PluginGraph::setNodePrecisionPreference (NodeID nodeID, HostedPluginInstance::PrecisionPreference preference)
+{
+    if (auto* n = graph.getNodeForId (nodeID))
+    {
+        applyPrecisionPreference (*n, preference);
+        changed();
+    }
+}
+
+void PluginGraph::setNodeDenormalsAllowed (NodeID nodeID, bool shouldAllow)
+{
+    if (auto* n = graph.getNodeForId (nodeID))
+    {
+        applyDenormalsAllowed (*n, shouldAllow);
+        changed();
+    }
+}
+
+void PluginGraph::setNodeConcurrentPrepareAllowed (NodeID nodeID, bool shouldAllow)
+{
+    if (auto* n = graph.getNodeForId (nodeID))
+    {
+        applyConcurrentPrepareAllowed (*n, shouldAllow);
+        changed();
+    }
+}
+
+void PluginGraph::setNodeSandboxed (NodeID nodeID, bool shouldBeSandboxed)
+{
+    auto* n = graph.getNodeForId (nodeID);
+
+    if (n == nullptr || static_cast<bool> (n->properties ["sandboxed"]) == shouldBeSandboxed)
+        return;
+
+    // the plugin has to be recreated in its new home, so round-trip it through its saved form
+    std::unique_ptr<XmlElement> xml (createNodeXml (n));
+
+    if (xml == nullptr)
+        return;
+
+    xml->setAttribute ("sandboxed", shouldBeSandboxed);
+
+    std::vector<AudioProcessorGraph::Connection> connections;
+
+    for (auto& c : graph.getConnections())
+        if (c.source.nodeID == nodeID || c.destination.nodeID == nodeID)
+            connections.push_back (c);
+
+    for (int i = activePluginWindows.size(); --i >= 0;)
+        if (activePluginWindows.getUnchecked (i)->node->nodeID == nodeID)
+            activePluginWindows.remove (i);
+
+    graph.removeNode (nodeID);
+    createNodeFromXml (*xml);
+
+    for (auto& c : connections)
+        graph.addConnection (c);
+
+    changed();
+}
+
+bool PluginGraph::shouldUseDoublePrecision() const
+{
+    // each plugin votes for the precision it would rather run at, and the graph picks whichever
+    // needs the fewest conversions; a tie, or a graph with no plugins, stays in double as it always has
+    int numDouble = 0, numFloat = 0;
+
+    for (auto* node : graph.getNodes())
+    {
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node->getProcessor()))
+        {
+            ++(hosted->getPreferredPrecision() == AudioProcessor::doublePrecision ? numDouble : numFloat);
+        }
+        else if (auto* processor = node->getProcessor())
+        {
+            if (! processor->supportsDoublePrecisionProcessing())
+                ++numFloat;
+        }
+    }
+
+    return numDouble >= numFloat;
+}
+
+void PluginGraph::prepareNodesAhead (double sampleRate, int blockSize, AudioProcessor::ProcessingPrecision precision)
+{
+    // below this, a plugin's prepareToPlay isn't worth handing to another thread
+    static constexpr double slowPrepareMs = 10.0;
+
+    struct Job
+    {
+        HostedPluginInstance* plugin;
+        bool isConcurrent;
+    };
+
+    std::vector<Job> jobs;
+
+    for (auto* node : graph.getNodes())
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node->getProcessor()))
+            jobs.push_back ({ hosted, hosted->isConcurrentPrepareAllowed() && hosted->getLastPrepareMilliseconds() >= slowPrepareMs });
+
+    if (jobs.empty())
+        return;
+
+    const auto startMs = Time::getMillisecondCounterHiRes();
+
+    std::atomic<int> numPending { 0 };
+    WaitableEvent allDone;
+    int numQueued = 0;
+
+    for (auto& job : jobs)
+    {
+        if (! job.isConcurrent)
+            continue;
+
+        ++numPending;
+        ++numQueued;
+        preparePool->pool.addJob ([&, plugin = job.plugin]
+        {
+            plugin->prepareAhead (sampleRate, blockSize, precision);
+
+            if (--numPending == 0)
+                allDone.signal();
+        });
+    }
+
+    // the quick ones, any never prepared before, and any not allowed on another thread are done here
+    for (auto& job : jobs)
+        if (! job.isConcurrent)
+            job.plugin->prepareAhead (sampleRate, blockSize, precision);
+
+    // wait for the signal even if the count has already reached zero: the last job still has to
+    // touch allDone, which lives on this stack
+    if (numQueued > 0)
+        allDone.wait();
+
+    String report;
+    report << "Prepared " << (int) jobs.size() << " plug-ins for " << sampleRate << " Hz, " << blockSize << " samples in "
+           << String (Time::getMillisecondCounterHiRes() - startMs, 1) << " ms:";
+
+    for (auto& job : jobs)
+        report << newLine << "  " << String (job.plugin->getLastPrepareMilliseconds(), 1).paddedLeft (' ', 8) << " ms  "
+               << job.plugin->getName() << (job.isConcurrent ? " (concurrently)" : "");
+
+    Logger::writeToLog (report);
+}
+
+void PluginGraph::finishPreparingNodesAhead()
+{
+    for (auto* node : graph.getNodes())
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (node->getProcessor()))
+            hosted->finishPreparingAhead();
+}
+
+void PluginGraph::setMaxGraphBlockSize (int newMaxBlockSize)
+{
+    newMaxBlockSize = jmax (0, newMaxBlockSize);
+
+    if (maxGraphBlockSize != newMaxBlockSize)
+    {
+        maxGraphBlockSize = newMaxBlockSize;
+        changed();
+    }
+}
+
+void PluginGraph::setFailoverDevices (const Array<FailoverDevice>& newDevices)
+{
+    if (failoverDevices != newDevices)
+    {
+        failoverDevices = newDevices;
+        changed();
+    }
+}
+
+void PluginGraph::setProcessingRate (double newRate)
+{
+    if (! approximatelyEqual (processingRate, newRate))
+    {
+        processingRate = newRate;
+        changed();
+    }
+}
+
 //==============================================================================
 void PluginGraph::clear()
 {
@@ -166,6 +465,9 @@ PluginWindow* PluginGraph::getOrCreateWindowFor (AudioProcessorGraph::Node* node
 {
     jassert (node != nullptr);
 
+    if (! pluginWindowsEnabled)
+        return nullptr;
+
    #if JUCE_IOS || JUCE_ANDROID
     closeAnyOpenPluginWindows();
    #else
@@ -214,6 +516,9 @@ void PluginGraph::newDocument()
 {
     clear();
     setFile ({});
+    processingRate = 0.0;
+    maxGraphBlockSize = 0;
+    failoverDevices.clear();
 
     graph.removeChangeListener (this);
 
@@ -355,6 +660,24 @@ static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node) noexcep
         e->setAttribute ("y",        node->properties ["y"].toString());
         e->setAttribute ("useARA",   node->properties ["useARA"].toString());
 
+        if (static_cast<int> (node->properties ["fixedBlockSize"]) > 0)
+            e->setAttribute ("fixedBlockSize", node->properties ["fixedBlockSize"].toString());
+
+        if (static_cast<int> (node->properties ["maxBlockSize"]) > 0)
+            e->setAttribute ("maxBlockSize", node->properties ["maxBlockSize"].toString());
+
+        if (node->properties.contains ("precision") && node->properties ["precision"].toString() != "auto")
+            e->setAttribute ("precision", node->properties ["precision"].toString());
+
+        if (node->properties ["allowDenormals"])
+            e->setAttribute ("allowDenormals", true);
+
+        if (node->properties ["prepareConcurrently"])
+            e->setAttribute ("prepareConcurrently", true);
+
+        if (node->properties ["sandboxed"])
+            e->setAttribute ("sandboxed", true);
+
         for (int i = 0; i < (int) PluginWindow::Type::numTypes; ++i)
         {
             auto type = (PluginWindow::Type) i;
@@ -435,6 +758,14 @@ void PluginGraph::createNodeFromXml (const XmlElement& xml)
         if (auto instance = createInstance (pd))
             return instance;
 
+        if (pluginDatabase != nullptr)
+        {
+            if (auto* match = pluginDatabase->findByUniqueId (pd.pluginDescription.pluginFormatName, pd.pluginDescription.uniqueId))
+                return createInstance (PluginDescriptionAndPreference { *match });
+
+            return nullptr;
+        }
+
         const auto allFormats = formatManager.getFormats();
         const auto matchingFormat = std::find_if (allFormats.begin(), allFormats.end(),
                                                   [&] (const AudioPluginFormat* f) { return f->getName() == pd.pluginDescription.pluginFormatName; });
@@ -452,7 +783,34 @@ void PluginGraph::createNodeFromXml (const XmlElement& xml)
         return createInstance (PluginDescriptionAndPreference { *matchingPlugin });
     };
 
-    if (auto instance = createInstanceWithFallback())
+    // the sandbox loads the plugin in the background, and the node is silent until it has;
+    // if it can't, the node is recreated in-process. The graph owns the node, so it outlives the callback.
+    auto createSandboxedInstance = [&]() -> std::unique_ptr<AudioPluginInstance>
+    {
+        const auto nodeID = NodeID ((uint32) xml.getIntAttribute ("uid"));
+
+        return SandboxedPluginInstance::createAsync (pd.pluginDescription, {},
+                                                     [this, nodeID, name = pd.pluginDescription.name] (const String& error)
+                                                     {
+                                                         if (error.isEmpty())
+                                                             return;
+
+                                                         Logger::writeToLog ("Couldn't sandbox " + name + ", loading it in-process: " + error);
+                                                         setNodeSandboxed (nodeID, false);
+                                                     });
+    };
+
+    std::unique_ptr<AudioPluginInstance> instance;
+
+    if (xml.getBoolAttribute ("sandboxed"))
+        instance = createSandboxedInstance();
+
+    const auto isSandboxed = instance != nullptr;
+
+    if (instance == nullptr)
+        instance = createInstanceWithFallback();
+
+    if (instance != nullptr)
     {
         if (auto* layoutEntity = xml.getChildByName ("LAYOUT"))
         {
@@ -464,6 +822,8 @@ void PluginGraph::createNodeFromXml (const XmlElement& xml)
             instance->setBusesLayout (layout);
         }
 
+        instance = wrapHostedPlugin (std::move (instance));
+
         if (auto node = graph.addNode (std::move (instance), NodeID ((uint32) xml.getIntAttribute ("uid"))))
         {
             if (auto* state = xml.getChildByName ("STATE"))
@@ -477,6 +837,11 @@ void PluginGraph::createNodeFromXml (const XmlElement& xml)
             node->properties.set ("x", xml.getDoubleAttribute ("x"));
             node->properties.set ("y", xml.getDoubleAttribute ("y"));
             node->properties.set ("useARA", xml.getBoolAttribute ("useARA"));
+            applyBlockSizeOptions (*node, xml.getIntAttribute ("fixedBlockSize"), xml.getIntAttribute ("maxBlockSize"));
+            applyPrecisionPreference (*node, HostedPluginInstance::precisionPreferenceFromString (xml.getStringAttribute ("precision", "auto")));
+            applyDenormalsAllowed (*node, xml.getBoolAttribute ("allowDenormals"));
+            applyConcurrentPrepareAllowed (*node, xml.getBoolAttribute ("prepareConcurrently"));
+            node->properties.set ("sandboxed", isSandboxed);
 
             for (int i = 0; i < (int) PluginWindow::Type::numTypes; ++i)
             {
@@ -505,6 +870,21 @@ std::unique_ptr<XmlElement> PluginGraph::createXml() const
 {
     auto xml = std::make_unique<XmlElement> ("FILTERGRAPH");
 
+    if (processingRate > 0.0)
+        xml->setAttribute ("processingRate", processingRate);
+
+    if (maxGraphBlockSize > 0)
+        xml->setAttribute ("maxBlockSize", maxGraphBlockSize);
+
+    for (auto& device : failoverDevices)
+    {
+        auto e = xml->createNewChildElement ("FAILOVER");
+
+        e->setAttribute ("type", device.typeName);
+        e->setAttribute ("input", device.inputDeviceName);
+        e->setAttribute ("output", device.outputDeviceName);
+    }
+
     for (auto* node : graph.getNodes())
         xml->addChildElement (createNodeXml (node));
 
@@ -525,6 +905,14 @@ void PluginGraph::restoreFromXml (const XmlElement& xml)
 {
     clear();
 
+    processingRate = xml.getDoubleAttribute ("processingRate", 0.0);
+    maxGraphBlockSize = jmax (0, xml.getIntAttribute ("maxBlockSize"));
+
+    failoverDevices.clear();
+
+    for (auto* e : xml.getChildWithTagNameIterator ("FAILOVER"))
+        failoverDevices.add ({ e->getStringAttribute ("type"), e->getStringAttribute ("input"), e->getStringAttribute ("output") });
+
     for (auto* e : xml.getChildWithTagNameIterator ("FILTER"))
     {
         createNodeFromXml (*e);
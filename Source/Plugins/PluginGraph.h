@@ -35,6 +35,9 @@
 #pragma once
 
 #include "../UI/PluginWindow.h"
+#include "HostedPluginInstance.h"
+
+class PluginDatabase;
 
 //==============================================================================
 /** A type that encapsulates a PluginDescription and some preferences regarding
@@ -78,6 +81,15 @@ public:
 
     void addPlugin (const PluginDescriptionAndPreference&, Point<double>);
 
+    /** Starts creating an instance of a plugin that the user looks likely to add, so that a
+        following addPlugin() for the same plugin can use it rather than waiting. Only one is
+        kept at a time; preparing a different plugin drops the previous one.
+    */
+    void preparePlugin (const PluginDescription&);
+
+    /** Drops a prepared instance that wasn't used, unless addPlugin() is waiting for it. */
+    void cancelPreparedPlugin();
+
     AudioProcessorGraph::Node::Ptr getNodeForName (const String& name) const;
 
     void setNodePosition (NodeID, Point<double>);
@@ -87,6 +99,12 @@ public:
     void clear();
 
     PluginWindow* getOrCreateWindowFor (AudioProcessorGraph::Node*, PluginWindow::Type);
+
+    /** Stops the graph opening plugin windows, including those a preset saved as open,
+        for a host with no display.
+    */
+    void setPluginWindowsEnabled (bool shouldBeEnabled) noexcept    { pluginWindowsEnabled = shouldBeEnabled; }
+
     void closeCurrentlyOpenWindowsFor (AudioProcessorGraph::NodeID);
     bool closeAnyOpenPluginWindows();
 
@@ -111,6 +129,74 @@ public:
 
     static File getDefaultGraphDocumentOnMobile();
 
+    //==============================================================================
+    /** The rate the graph should be processed at, independent of the device rate.
+        Zero means the graph simply follows the device. Saved with the preset.
+    */
+    void setProcessingRate (double newRate);
+    double getProcessingRate() const noexcept           { return processingRate; }
+
+    /** The largest block the graph will be asked to process at once. Larger device
+        callbacks are split into sub-blocks. Zero means no limit. Saved with the preset.
+    */
+    void setMaxGraphBlockSize (int newMaxBlockSize);
+    int getMaxGraphBlockSize() const noexcept           { return maxGraphBlockSize; }
+
+    /** Sets the block-size adaptation for a hosted plugin: a fixed block size that
+        its input is buffered into, and/or a maximum block size that larger blocks
+        are split down to. Zero disables either option.
+    */
+    void setNodeBlockSizeOptions (NodeID, int fixedBlockSize, int maxBlockSize);
+
+    /** Sets the precision a hosted plugin processes at. */
+    void setNodePrecisionPreference (NodeID, HostedPluginInstance::PrecisionPreference);
+
+    /** Lets a hosted plugin run with IEEE denormal support instead of flush-to-zero. */
+    void setNodeDenormalsAllowed (NodeID, bool shouldAllow);
+
+    /** Lets a hosted plugin be prepared on another thread by prepareNodesAhead(). */
+    void setNodeConcurrentPrepareAllowed (NodeID, bool shouldAllow);
+
+    /** Moves a plugin into its own sandbox process, or back into the host process.
+        The node keeps its ID, state and connections.
+    */
+    void setNodeSandboxed (NodeID, bool shouldBeSandboxed);
+
+    /** Gives the graph an index of the known plugins, used to find a plugin again
+        when a preset's saved description no longer matches how it is installed.
+    */
+    void setPluginDatabase (const PluginDatabase* database) noexcept  { pluginDatabase = database; }
+
+    /** Returns the precision that needs the fewest float/double conversions between nodes. */
+    bool shouldUseDoublePrecision() const;
+
+    /** A device to fall back on when the one chosen in the audio settings goes away. */
+    struct FailoverDevice
+    {
+        String typeName, inputDeviceName, outputDeviceName;
+
+        bool operator== (const FailoverDevice& other) const
+        {
+            return typeName == other.typeName && inputDeviceName == other.inputDeviceName
+                && outputDeviceName == other.outputDeviceName;
+        }
+    };
+
+    /** The devices to fail over to, most preferred first. Saved with the preset. */
+    void setFailoverDevices (const Array<FailoverDevice>&);
+    const Array<FailoverDevice>& getFailoverDevices() const noexcept    { return failoverDevices; }
+
+    /** Prepares the hosted plugins for the settings the graph is about to be prepared with,
+        re-preparing them in place. Plugins that were slow to prepare last time, and have been
+        allowed to, are prepared concurrently on a pool shared by every graph; the rest are
+        prepared on the calling thread. The time each one took is written to the log. The graph mustn't be
+        processing while this runs; its own prepareToPlay then only has the cheap nodes left.
+    */
+    void prepareNodesAhead (double sampleRate, int blockSize, AudioProcessor::ProcessingPrecision);
+
+    /** Call once the graph's own prepareToPlay has returned, after prepareNodesAhead(). */
+    void finishPreparingNodesAhead();
+
     //==============================================================================
     AudioProcessorGraph graph;
 
@@ -118,10 +204,39 @@ private:
     //==============================================================================
     AudioPluginFormatManager& formatManager;
     KnownPluginList& knownPlugins;
+    const PluginDatabase* pluginDatabase = nullptr;
     OwnedArray<PluginWindow> activePluginWindows;
     ScopedMessageBox messageBox;
 
+    struct PreparedPlugin
+    {
+        PluginDescription description;
+        std::unique_ptr<AudioPluginInstance> instance;
+        String error;
+        bool isReady = false, isWanted = false;
+        Point<double> position;
+        PluginDescriptionAndPreference::UseARA useARA = PluginDescriptionAndPreference::UseARA::no;
+    };
+
+    // the one speculative instance, which is never wanted yet, so a newer guess can replace it;
+    // once addPlugin asks for it, it moves to wantedPlugins until it arrives
+    std::shared_ptr<PreparedPlugin> preparedPlugin;
+    std::vector<std::shared_ptr<PreparedPlugin>> wantedPlugins;
+
+    // one pool for every graph in the process, so that they don't each add a thread per core
+    struct PreparePool
+    {
+        ThreadPool pool { ThreadPoolOptions{}.withThreadName ("Plugin prepare")
+                                             .withNumberOfThreads (jmax (1, SystemStats::getNumCpus() - 1)) };
+    };
+
+    SharedResourcePointer<PreparePool> preparePool;
+
     NodeID lastUID;
+    double processingRate = 0.0;
+    int maxGraphBlockSize = 0;
+    Array<FailoverDevice> failoverDevices;
+    bool pluginWindowsEnabled = true;
     NodeID getNextUID() noexcept;
 
     void createNodeFromXml (const XmlElement&);
@@ -0,0 +1,250 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A streaming multichannel sample-rate converter.
+
+    The anti-aliasing filter is a Kaiser-windowed sinc that is tabulated as a
+    polyphase bank; coefficients for positions between two phases are linearly
+    interpolated, so any ratio (including one that drifts slowly over time) can
+    be used without rebuilding the table.
+
+    All memory is allocated in prepare(), so process() is safe to call on the
+    audio thread.
+*/
+template <typename SampleType>
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler() = default;
+
+    //==============================================================================
+    /** Allocates the filter bank and history for the given conversion.
+
+        maxInputBlockSize is the largest number of input samples that will be
+        passed to a single call to process().
+    */
+    void prepare (int numChannelsIn, double inputRate, double outputRate, int maxInputBlockSize)
+    {
+        jassert (inputRate > 0.0 && outputRate > 0.0 && maxInputBlockSize > 0);
+
+        numChannels = numChannelsIn;
+        nominalStep = inputRate / outputRate;
+        step = nominalStep;
+
+        // when decimating, the cutoff moves down and the kernel gets proportionally longer
+        const auto bandwidth = jmin (1.0, outputRate / inputRate);
+        numTaps = jmax (baseNumTaps, 2 * (int) std::ceil ((double) baseNumTaps / bandwidth / 2.0));
+        cutoff = bandwidth * passbandFraction;
+
+        buildFilterBank();
+
+        // a capped output, or a slower step, can leave up to a block unconsumed from the call before
+        historySize = numTaps + 2 * maxInputBlockSize + 2;
+        history.setSize (jmax (1, numChannels), historySize);
+        interpolatedKernel.resize ((size_t) numTaps);
+
+        reset();
+    }
+
+    /** Clears the history, leaving the converter primed with silence. */
+    void reset() noexcept
+    {
+        history.clear();
+        numBuffered = numTaps;
+        position = (double) (numTaps / 2);
+    }
+
+    //==============================================================================
+    /** Scales the conversion ratio by a small factor, e.g. to track clock drift.
+        A factor above 1.0 consumes input slightly faster. The factor is limited
+        to maxRatioAdjustment either side of 1.0.
+    */
+    void setRatioAdjustment (double factor) noexcept
+    {
+        step = nominalStep * jlimit (1.0 - maxRatioAdjustment, 1.0 + maxRatioAdjustment, factor);
+    }
+
+    static constexpr double maxRatioAdjustment = 0.01;
+
+    /** Returns the ratio of input samples consumed per output sample. */
+    double getStep() const noexcept                     { return step; }
+
+    /** Returns the group delay of the filter, measured in input samples. */
+    int getLatencyInInputSamples() const noexcept       { return numTaps / 2; }
+
+    /** Returns an upper bound on the number of samples process() will produce
+        for the given number of input samples, whatever the ratio adjustment.
+    */
+    int getMaxOutputSamples (int numInputSamples) const noexcept
+    {
+        return (int) std::ceil ((double) numInputSamples / (nominalStep * (1.0 - maxRatioAdjustment))) + 2;
+    }
+
+    //==============================================================================
+    /** Consumes numInputSamples from each input channel and writes as many
+        output samples as are available (up to maxOutputSamples).
+
+        Returns the number of output samples written. Input that doesn't fit in the
+        history, because earlier calls left too much unconsumed, is dropped.
+    */
+    int process (const SampleType* const* input, int numInputSamples,
+                 SampleType* const* output, int maxOutputSamples) noexcept
+    {
+        // only happens if maxOutputSamples keeps being smaller than getMaxOutputSamples()
+        jassert (numBuffered + numInputSamples <= historySize);
+        numInputSamples = jlimit (0, historySize - numBuffered, numInputSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* dest = history.getWritePointer (ch, numBuffered);
+
+            if (input != nullptr && input[ch] != nullptr)
+                FloatVectorOperations::copy (dest, input[ch], numInputSamples);
+            else
+                FloatVectorOperations::clear (dest, numInputSamples);
+        }
+
+        numBuffered += numInputSamples;
+
+        const auto halfTaps = numTaps / 2;
+        int numOut = 0;
+
+        while (numOut < maxOutputSamples)
+        {
+            const auto index = (int) position;
+
+            if (index + halfTaps >= numBuffered)
+                break;
+
+            const auto* kernel = getKernelFor (position - (double) index);
+            const auto first = index - halfTaps + 1;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto* x = history.getReadPointer (ch, first);
+                SampleType sum = 0;
+
+                for (int k = 0; k < numTaps; ++k)
+                    sum += x[k] * kernel[k];
+
+                output[ch][numOut] = sum;
+            }
+
+            ++numOut;
+            position += step;
+        }
+
+        // discard history that no future output can reach
+        const auto discard = jlimit (0, numBuffered, (int) position - halfTaps + 1);
+
+        if (discard > 0)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* data = history.getWritePointer (ch);
+                std::memmove (data, data + discard, sizeof (SampleType) * (size_t) (numBuffered - discard));
+            }
+
+            numBuffered -= discard;
+            position -= (double) discard;
+        }
+
+        return numOut;
+    }
+
+private:
+    //==============================================================================
+    static constexpr int baseNumTaps = 32;
+    static constexpr int numPhases = 256;
+    static constexpr double passbandFraction = 0.92;
+    static constexpr double kaiserBeta = 8.6;
+
+    static double besselI0 (double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+
+            if (term < sum * 1.0e-12)
+                break;
+        }
+
+        return sum;
+    }
+
+    double evaluateKernel (double distance) const noexcept
+    {
+        const auto halfLength = (double) numTaps / 2.0;
+        const auto normalised = distance / halfLength;
+
+        if (std::abs (normalised) >= 1.0)
+            return 0.0;
+
+        const auto x = cutoff * distance;
+        const auto sinc = std::abs (x) < 1.0e-9 ? 1.0 : std::sin (MathConstants<double>::pi * x) / (MathConstants<double>::pi * x);
+        const auto window = besselI0 (kaiserBeta * std::sqrt (1.0 - normalised * normalised)) / besselI0 (kaiserBeta);
+
+        return cutoff * sinc * window;
+    }
+
+    void buildFilterBank()
+    {
+        // one extra phase so that the interpolation at the top of the range has a neighbour
+        filterBank.resize ((size_t) ((numPhases + 1) * numTaps));
+
+        const auto halfTaps = numTaps / 2;
+
+        for (int phase = 0; phase <= numPhases; ++phase)
+        {
+            const auto fraction = (double) phase / (double) numPhases;
+            auto* row = filterBank.data() + phase * numTaps;
+
+            for (int k = 0; k < numTaps; ++k)
+                row[k] = (SampleType) evaluateKernel ((double) (halfTaps - 1 - k) + fraction);
+        }
+    }
+
+    const SampleType* getKernelFor (double fraction) noexcept
+    {
+        const auto scaled = fraction * (double) numPhases;
+        const auto phase = jmin (numPhases - 1, (int) scaled);
+        const auto alpha = (SampleType) (scaled - (double) phase);
+
+        const auto* lower = filterBank.data() + phase * numTaps;
+        const auto* upper = lower + numTaps;
+        auto* dest = interpolatedKernel.data();
+
+        for (int k = 0; k < numTaps; ++k)
+            dest[k] = lower[k] + alpha * (upper[k] - lower[k]);
+
+        return dest;
+    }
+
+    //==============================================================================
+    int numChannels = 0, numTaps = baseNumTaps, historySize = 0, numBuffered = 0;
+    double nominalStep = 1.0, step = 1.0, cutoff = passbandFraction, position = 0.0;
+
+    std::vector<SampleType> filterBank, interpolatedKernel;
+    AudioBuffer<SampleType> history;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PolyphaseResampler)
+};
@@ -0,0 +1,85 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON && JUCE_64BIT
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+/**
+    Vectorised conversion between single- and double-precision sample data,
+    used at the boundaries between nodes that process at different precisions.
+*/
+namespace SampleConversion
+{
+    inline void convert (const float* src, double* dest, int num) noexcept
+    {
+        int i = 0;
+
+       #if JUCE_USE_SSE_INTRINSICS
+        for (; i + 4 <= num; i += 4)
+        {
+            const auto in = _mm_loadu_ps (src + i);
+            _mm_storeu_pd (dest + i,     _mm_cvtps_pd (in));
+            _mm_storeu_pd (dest + i + 2, _mm_cvtps_pd (_mm_movehl_ps (in, in)));
+        }
+       #elif JUCE_USE_ARM_NEON && JUCE_64BIT
+        for (; i + 4 <= num; i += 4)
+        {
+            const auto in = vld1q_f32 (src + i);
+            vst1q_f64 (dest + i,     vcvt_f64_f32 (vget_low_f32 (in)));
+            vst1q_f64 (dest + i + 2, vcvt_high_f64_f32 (in));
+        }
+       #endif
+
+        for (; i < num; ++i)
+            dest[i] = (double) src[i];
+    }
+
+    inline void convert (const double* src, float* dest, int num) noexcept
+    {
+        int i = 0;
+
+       #if JUCE_USE_SSE_INTRINSICS
+        for (; i + 4 <= num; i += 4)
+        {
+            const auto lo = _mm_cvtpd_ps (_mm_loadu_pd (src + i));
+            const auto hi = _mm_cvtpd_ps (_mm_loadu_pd (src + i + 2));
+            _mm_storeu_ps (dest + i, _mm_movelh_ps (lo, hi));
+        }
+       #elif JUCE_USE_ARM_NEON && JUCE_64BIT
+        for (; i + 4 <= num; i += 4)
+        {
+            const auto lo = vcvt_f32_f64 (vld1q_f64 (src + i));
+            vst1q_f32 (dest + i, vcvt_high_f32_f64 (lo, vld1q_f64 (src + i + 2)));
+        }
+       #endif
+
+        for (; i < num; ++i)
+            dest[i] = (float) src[i];
+    }
+
+    /** Converts the first numChannels channels of one buffer into another of the other width. */
+    template <typename Source, typename Dest>
+    void convert (const AudioBuffer<Source>& src, AudioBuffer<Dest>& dest, int numChannels, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            convert (src.getReadPointer (ch), dest.getWritePointer (ch), numSamples);
+    }
+}
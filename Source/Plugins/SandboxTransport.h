@@ -0,0 +1,409 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <climits>
+#elif JUCE_MAC
+ // the kernel's futex equivalent, which libc++ also uses for std::atomic::wait; the
+ // shared variant works across processes on a word in shared memory
+ extern "C" int __ulock_wait (uint32_t operation, void* address, uint64_t value, uint32_t timeoutMicroseconds);
+ extern "C" int __ulock_wake (uint32_t operation, void* address, uint64_t wakeValue);
+#endif
+
+//==============================================================================
+/**
+    A named block of memory shared between the host and a sandbox process.
+*/
+class SandboxSharedMemory
+{
+public:
+    SandboxSharedMemory() = default;
+
+    ~SandboxSharedMemory()
+    {
+        close();
+    }
+
+    /** Creates a new zero-filled region; the creator unlinks it when closed. */
+    bool create (const String& regionName, size_t numBytes)
+    {
+        return map (regionName, numBytes, true);
+    }
+
+    /** Opens a region created by another process. */
+    bool open (const String& regionName, size_t numBytes)
+    {
+        return map (regionName, numBytes, false);
+    }
+
+    void close()
+    {
+        if (data == nullptr)
+            return;
+
+       #if JUCE_WINDOWS
+        UnmapViewOfFile (data);
+        CloseHandle (handle);
+        handle = nullptr;
+       #else
+        munmap (data, size);
+
+        if (isOwner)
+            shm_unlink (getPosixName().toRawUTF8());
+       #endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    void* getData() const noexcept          { return data; }
+    size_t getSize() const noexcept         { return size; }
+    const String& getName() const noexcept  { return name; }
+
+private:
+    bool map (const String& regionName, size_t numBytes, bool shouldCreate)
+    {
+        close();
+
+        name = regionName;
+        isOwner = shouldCreate;
+
+       #if JUCE_WINDOWS
+        const auto objectNameString = "Local\\" + name;
+        const auto objectName = objectNameString.toWideCharPointer();
+
+        handle = shouldCreate ? CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                                    (DWORD) ((uint64) numBytes >> 32), (DWORD) numBytes, objectName)
+                              : OpenFileMappingW (FILE_MAP_ALL_ACCESS, FALSE, objectName);
+
+        if (handle == nullptr)
+            return false;
+
+        data = MapViewOfFile (handle, FILE_MAP_ALL_ACCESS, 0, 0, numBytes);
+
+        if (data == nullptr)
+        {
+            CloseHandle (handle);
+            handle = nullptr;
+            return false;
+        }
+       #else
+        const auto posixName = getPosixName();
+        const auto fd = shm_open (posixName.toRawUTF8(), shouldCreate ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+
+        if (fd < 0)
+            return false;
+
+        if (shouldCreate && ftruncate (fd, (off_t) numBytes) != 0)
+        {
+            ::close (fd);
+            shm_unlink (posixName.toRawUTF8());
+            return false;
+        }
+
+        auto* mapped = mmap (nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close (fd);
+
+        if (mapped == MAP_FAILED)
+        {
+            if (shouldCreate)
+                shm_unlink (posixName.toRawUTF8());
+
+            return false;
+        }
+
+        data = mapped;
+       #endif
+
+        size = numBytes;
+
+        // the audio thread must never page-fault its way into this memory
+        if (shouldCreate)
+            zeromem (data, size);
+
+        return true;
+    }
+
+    String getPosixName() const     { return "/" + name; }
+
+    String name;
+    void* data = nullptr;
+    size_t size = 0;
+    bool isOwner = false;
+
+   #if JUCE_WINDOWS
+    HANDLE handle = nullptr;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (SandboxSharedMemory)
+};
+
+//==============================================================================
+/**
+    Cross-process wake-ups on a 32-bit word in shared memory, so that neither side
+    has to spin while it waits for the other.
+
+    On Linux this is a (non-private) futex on the word, and on macOS its shared
+    ulock equivalent. Windows can't wait on an address across processes, so there
+    each word has a named auto-reset event beside it, which the creator makes and
+    the other side opens by name.
+*/
+class SandboxSignal
+{
+public:
+    static_assert (std::atomic<uint32>::is_always_lock_free, "shared-memory signalling needs lock-free atomics");
+
+    SandboxSignal() = default;
+
+    ~SandboxSignal()
+    {
+        close();
+    }
+
+    /** Makes the kernel object behind a word, where the platform needs one. */
+    bool create (const String& signalName)
+    {
+        return attach (signalName, true);
+    }
+
+    /** Opens the kernel object the other process made for a word. */
+    bool open (const String& signalName)
+    {
+        return attach (signalName, false);
+    }
+
+    void close()
+    {
+       #if JUCE_WINDOWS
+        if (event != nullptr)
+            CloseHandle (event);
+
+        event = nullptr;
+       #endif
+    }
+
+    void notify (std::atomic<uint32>& word) noexcept
+    {
+       #if JUCE_LINUX
+        syscall (SYS_futex, reinterpret_cast<uint32*> (&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+       #elif JUCE_MAC
+        __ulock_wake (ulockCompareAndWaitShared | ulockWakeAll, &word, 0);
+       #elif JUCE_WINDOWS
+        ignoreUnused (word);
+
+        if (event != nullptr)
+            SetEvent (event);
+       #endif
+    }
+
+    /** Waits until word no longer holds 'expected', or the timeout expires.
+        Returns true if the value changed.
+    */
+    bool waitWhileEqual (std::atomic<uint32>& word, uint32 expected, double timeoutMs) noexcept
+    {
+        // most round trips complete within a few microseconds, so spin briefly before sleeping
+        for (int i = 0; i < 256; ++i)
+            if (word.load (std::memory_order_acquire) != expected)
+                return true;
+
+        const auto deadline = Time::getMillisecondCounterHiRes() + timeoutMs;
+
+        for (;;)
+        {
+            if (word.load (std::memory_order_acquire) != expected)
+                return true;
+
+            const auto remainingMs = deadline - Time::getMillisecondCounterHiRes();
+
+            if (remainingMs <= 0.0)
+                return false;
+
+           #if JUCE_LINUX
+            timespec timeout;
+            timeout.tv_sec  = (time_t) (remainingMs / 1000.0);
+            timeout.tv_nsec = (long) ((remainingMs - (double) timeout.tv_sec * 1000.0) * 1.0e6);
+
+            syscall (SYS_futex, reinterpret_cast<uint32*> (&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+           #elif JUCE_MAC
+            __ulock_wait (ulockCompareAndWaitShared, &word, expected, (uint32_t) jmax (1.0, remainingMs * 1000.0));
+           #elif JUCE_WINDOWS
+            if (event == nullptr)
+                return false;
+
+            // a notify that came before this wait leaves the event set, so it can't be missed
+            WaitForSingleObject (event, (DWORD) jmax (1.0, std::ceil (remainingMs)));
+           #endif
+        }
+    }
+
+private:
+    bool attach (const String& signalName, bool shouldCreate)
+    {
+        close();
+
+       #if JUCE_WINDOWS
+        const auto objectNameString = "Local\\" + signalName;
+        const auto objectName = objectNameString.toWideCharPointer();
+
+        event = shouldCreate ? CreateEventW (nullptr, FALSE, FALSE, objectName)
+                             : OpenEventW (SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, objectName);
+
+        return event != nullptr;
+       #else
+        ignoreUnused (signalName, shouldCreate);
+        return true;
+       #endif
+    }
+
+   #if JUCE_MAC
+    static constexpr uint32_t ulockCompareAndWaitShared = 3, ulockWakeAll = 0x100;
+   #endif
+
+   #if JUCE_WINDOWS
+    HANDLE event = nullptr;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (SandboxSignal)
+};
+
+//==============================================================================
+/**
+    The layout of the shared region: a header followed by a ring of block slots.
+
+    The host fills slot (seq % numSlots), publishes seq in requestSeq and waits for
+    the sandbox to publish the same seq in responseSeq. The sandbox processes the
+    slot's audio in place. Because consecutive blocks use different slots, a late
+    response to a block the host has given up on can never overwrite a newer one.
+*/
+struct SandboxTransportLayout
+{
+    struct Header
+    {
+        std::atomic<uint32> requestSeq;
+        std::atomic<uint32> responseSeq;
+        int32 numChannels;
+        int32 maxBlockSize;
+        int32 numSlots;
+        int32 maxMidiBytes;
+    };
+
+    struct SlotHeader
+    {
+        int32 numSamples;
+        int32 numMidiBytes;
+        int32 bypassed;
+        int32 reserved;
+    };
+
+    static constexpr int defaultNumSlots = 4;
+    static constexpr int defaultMaxMidiBytes = 16384;
+
+    static size_t align (size_t n) noexcept             { return (n + 63) & ~(size_t) 63; }
+
+    static size_t getSlotSize (int numChannels, int maxBlockSize, int maxMidiBytes) noexcept
+    {
+        return align (sizeof (SlotHeader))
+             + align (sizeof (float) * (size_t) numChannels * (size_t) maxBlockSize)
+             + align ((size_t) maxMidiBytes);
+    }
+
+    static size_t getTotalSize (int numChannels, int maxBlockSize, int numSlots, int maxMidiBytes) noexcept
+    {
+        return align (sizeof (Header)) + (size_t) numSlots * getSlotSize (numChannels, maxBlockSize, maxMidiBytes);
+    }
+
+    //==============================================================================
+    explicit SandboxTransportLayout (void* base) noexcept
+        : data (static_cast<char*> (base)) {}
+
+    Header& getHeader() const noexcept                  { return *reinterpret_cast<Header*> (data); }
+
+    char* getSlot (int index) const noexcept
+    {
+        const auto& h = getHeader();
+        return data + align (sizeof (Header)) + (size_t) index * getSlotSize (h.numChannels, h.maxBlockSize, h.maxMidiBytes);
+    }
+
+    SlotHeader& getSlotHeader (int index) const noexcept    { return *reinterpret_cast<SlotHeader*> (getSlot (index)); }
+
+    float* getChannel (int slot, int channel) const noexcept
+    {
+        const auto& h = getHeader();
+        return reinterpret_cast<float*> (getSlot (slot) + align (sizeof (SlotHeader))) + (size_t) channel * (size_t) h.maxBlockSize;
+    }
+
+    uint8* getMidiData (int slot) const noexcept
+    {
+        const auto& h = getHeader();
+        return reinterpret_cast<uint8*> (getSlot (slot) + align (sizeof (SlotHeader))
+                                         + align (sizeof (float) * (size_t) h.numChannels * (size_t) h.maxBlockSize));
+    }
+
+    //==============================================================================
+    /** Packs MIDI events as [int32 position][int32 size][bytes]; events that don't fit are dropped. */
+    static int writeMidi (const MidiBuffer& midi, uint8* dest, int capacity) noexcept
+    {
+        int used = 0;
+
+        for (const auto metadata : midi)
+        {
+            const auto needed = (int) (2 * sizeof (int32)) + metadata.numBytes;
+
+            if (used + needed > capacity)
+                break;
+
+            const int32 header[] = { (int32) metadata.samplePosition, (int32) metadata.numBytes };
+            std::memcpy (dest + used, header, sizeof (header));
+            std::memcpy (dest + used + sizeof (header), metadata.data, (size_t) metadata.numBytes);
+            used += needed;
+        }
+
+        return used;
+    }
+
+    static void readMidi (const uint8* src, int numBytes, MidiBuffer& midi) noexcept
+    {
+        midi.clear();
+
+        for (int pos = 0; pos + (int) (2 * sizeof (int32)) <= numBytes;)
+        {
+            int32 header[2];
+            std::memcpy (header, src + pos, sizeof (header));
+            pos += (int) sizeof (header);
+
+            if (header[1] <= 0 || pos + header[1] > numBytes)
+                break;
+
+            midi.addEvent (src + pos, header[1], header[0]);
+            pos += header[1];
+        }
+    }
+
+private:
+    char* data;
+};
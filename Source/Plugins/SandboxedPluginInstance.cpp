@@ -0,0 +1,837 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "SandboxedPluginInstance.h"
+#include "BlockAdapter.h"
+
+static String toSingleLine (const XmlElement& xml)
+{
+    return xml.toString (XmlElement::TextFormat().singleLine().withoutHeader());
+}
+
+//==============================================================================
+class SandboxedPluginInstance::Connection final : private ChildProcessCoordinator
+{
+public:
+    explicit Connection (SandboxedPluginInstance& o) : owner (o) {}
+
+    ~Connection() override
+    {
+        killWorkerProcess();
+    }
+
+    bool launch()
+    {
+        return launchWorkerProcess (File::getSpecialLocation (File::currentExecutableFile), sandboxProcessUID, 0, 0);
+    }
+
+    bool isConnected() const
+    {
+        const std::lock_guard<std::mutex> lock { mutex };
+        return ! connectionLost;
+    }
+
+    /** Sends a control message and blocks until the matching reply arrives. */
+    std::unique_ptr<XmlElement> sendAndWait (XmlElement xml, int timeoutMs)
+    {
+        const std::lock_guard<std::mutex> requestLock { requestMutex };
+
+        const auto requestID = ++lastRequestID;
+        xml.setAttribute ("requestID", requestID);
+
+        {
+            const std::lock_guard<std::mutex> lock { mutex };
+            response.reset();
+        }
+
+        const auto str = toSingleLine (xml);
+
+        if (! sendMessageToWorker ({ str.toRawUTF8(), str.getNumBytesAsUTF8() }))
+            return nullptr;
+
+        std::unique_lock<std::mutex> lock { mutex };
+
+        // replies to earlier requests that timed out are discarded
+        condvar.wait_for (lock, std::chrono::milliseconds { timeoutMs }, [&]
+        {
+            return connectionLost || cancelled || (response != nullptr && response->getIntAttribute ("requestID") == requestID);
+        });
+
+        if (response == nullptr || response->getIntAttribute ("requestID") != requestID)
+            return nullptr;
+
+        return std::move (response);
+    }
+
+    /** Makes a sendAndWait() on another thread give up now, and any later ones straight away. */
+    void cancelWaiting()
+    {
+        const std::lock_guard<std::mutex> lock { mutex };
+        cancelled = true;
+        condvar.notify_all();
+    }
+
+private:
+    void handleMessageFromWorker (const MemoryBlock& mb) override
+    {
+        const std::lock_guard<std::mutex> lock { mutex };
+        response = parseXML (mb.toString());
+        condvar.notify_all();
+    }
+
+    void handleConnectionLost() override
+    {
+        {
+            const std::lock_guard<std::mutex> lock { mutex };
+            connectionLost = true;
+            condvar.notify_all();
+        }
+
+        owner.sandboxDied();
+    }
+
+    SandboxedPluginInstance& owner;
+
+    std::mutex requestMutex;
+    mutable std::mutex mutex;
+    std::condition_variable condvar;
+    std::unique_ptr<XmlElement> response;
+    bool connectionLost = false, cancelled = false;
+    int lastRequestID = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Connection)
+};
+
+//==============================================================================
+// waits for the sandbox to load its plugin, so that the message thread doesn't have to
+class SandboxedPluginInstance::Launcher final : private Thread
+{
+public:
+    Launcher (SandboxedPluginInstance& o, Connection& c, XmlElement requestToSend, int generationIn)
+        : Thread ("Sandbox Launcher"),
+          owner (&o),
+          connection (c),
+          request (std::move (requestToSend)),
+          generation (generationIn)
+    {
+        startThread();
+    }
+
+    ~Launcher() override
+    {
+        connection.cancelWaiting();
+        stopThread (-1);
+    }
+
+private:
+    void run() override
+    {
+        std::shared_ptr<XmlElement> reply (connection.sendAndWait (request, launchTimeoutMs).release());
+
+        MessageManager::callAsync ([weakOwner = owner, g = generation, reply]
+        {
+            if (auto* o = weakOwner.get())
+                o->launchFinished (g, reply.get(), TRANS ("The plugin sandbox process didn't respond"));
+        });
+    }
+
+    WeakReference<SandboxedPluginInstance> owner;
+    Connection& connection;
+    const XmlElement request;
+    const int generation;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Launcher)
+};
+
+//==============================================================================
+static AudioProcessor::BusesProperties getBusesFor (int numIns, int numOuts)
+{
+    AudioProcessor::BusesProperties buses;
+
+    if (numIns > 0)
+        buses = buses.withInput ("Input", AudioChannelSet::canonicalChannelSet (numIns), true);
+
+    if (numOuts > 0)
+        buses = buses.withOutput ("Output", AudioChannelSet::canonicalChannelSet (numOuts), true);
+
+    return buses;
+}
+
+std::unique_ptr<SandboxedPluginInstance> SandboxedPluginInstance::create (const PluginDescription& desc,
+                                                                          const MemoryBlock& initialState,
+                                                                          String& errorMessage)
+{
+    const auto isPassthrough = desc.fileOrIdentifier.isEmpty();
+    const auto numIns  = isPassthrough ? 2 : desc.numInputChannels;
+    const auto numOuts = isPassthrough ? 2 : desc.numOutputChannels;
+
+    std::unique_ptr<SandboxedPluginInstance> instance (new SandboxedPluginInstance (desc, initialState, numIns, numOuts));
+
+    if (! instance->launch (errorMessage))
+        return nullptr;
+
+    return instance;
+}
+
+std::unique_ptr<SandboxedPluginInstance> SandboxedPluginInstance::createAsync (const PluginDescription& desc,
+                                                                               const MemoryBlock& initialState,
+                                                                               LaunchCallback callback)
+{
+    std::unique_ptr<SandboxedPluginInstance> instance (new SandboxedPluginInstance (desc, initialState,
+                                                                                    desc.numInputChannels, desc.numOutputChannels));
+    instance->onLaunched = std::move (callback);
+    instance->launchAsync();
+    return instance;
+}
+
+SandboxedPluginInstance::SandboxedPluginInstance (const PluginDescription& desc, const MemoryBlock& initialState, int numIns, int numOuts)
+    : AudioPluginInstance (getBusesFor (numIns, numOuts)),
+      description (desc),
+      lastKnownState (initialState)
+{
+    chunkMidi.ensureSize (2048);
+    collectedMidi.ensureSize (2048);
+}
+
+SandboxedPluginInstance::~SandboxedPluginInstance()
+{
+    ready = false;
+    closeTransport();
+
+    launcher.reset();
+    connection.reset();
+    cancelPendingUpdate();
+}
+
+//==============================================================================
+bool SandboxedPluginInstance::launch (String& errorMessage)
+{
+    if (! startProcess (errorMessage))
+        return false;
+
+    const auto reply = connection->sendAndWait (createLaunchRequest(), launchTimeoutMs);
+    return applyLaunchReply (reply.get(), errorMessage);
+}
+
+void SandboxedPluginInstance::launchAsync()
+{
+    const auto generation = ++launchGeneration;
+    String error;
+
+    if (! startProcess (error))
+    {
+        // reported asynchronously all the same, so the caller always has the instance first
+        MessageManager::callAsync ([weakThis = WeakReference<SandboxedPluginInstance> (this), generation, error]
+        {
+            if (auto* s = weakThis.get())
+                s->launchFinished (generation, nullptr, error);
+        });
+
+        return;
+    }
+
+    launcher = std::make_unique<Launcher> (*this, *connection, createLaunchRequest(), generation);
+}
+
+void SandboxedPluginInstance::launchFinished (int generation, const XmlElement* reply, const String& errorIfNoReply)
+{
+    // a reply from a sandbox that has since been replaced
+    if (generation != launchGeneration)
+        return;
+
+    String error = errorIfNoReply;
+
+    if (reply != nullptr && applyLaunchReply (reply, error))
+    {
+        error = {};
+
+        if (generation > 1)
+            Logger::writeToLog ("Restarted sandbox for " + getName());
+
+        // the state may have been changed while the plugin was loading
+        if (lastKnownState != stateSentWithLaunch)
+        {
+            XmlElement request ("SETSTATE");
+            request.addTextElement (lastKnownState.toBase64Encoding());
+            sendAndWait (request, 5000);
+        }
+
+        if (isPrepared)
+            prepareSandbox();
+
+        // it may have died before it counted as launched
+        if (! connection->isConnected())
+            triggerAsyncUpdate();
+    }
+    else
+    {
+        Logger::writeToLog ("Couldn't start sandbox for " + getName() + ": " + error);
+    }
+
+    // taken, so that it's only called once; it may delete this instance
+    if (auto callback = std::exchange (onLaunched, nullptr))
+        callback (error);
+}
+
+bool SandboxedPluginInstance::startProcess (String& errorMessage)
+{
+    isLaunched = false;
+    connection = std::make_unique<Connection> (*this);
+
+    if (! connection->launch())
+    {
+        errorMessage = TRANS ("Couldn't launch the plugin sandbox process");
+        return false;
+    }
+
+    return true;
+}
+
+XmlElement SandboxedPluginInstance::createLaunchRequest()
+{
+    XmlElement request ("CREATE");
+
+    if (description.fileOrIdentifier.isNotEmpty())
+        request.addChildElement (description.createXml().release());
+
+    if (! lastKnownState.isEmpty())
+        request.createNewChildElement ("STATE")->addTextElement (lastKnownState.toBase64Encoding());
+
+    stateSentWithLaunch = lastKnownState;
+    return request;
+}
+
+bool SandboxedPluginInstance::applyLaunchReply (const XmlElement* reply, String& errorMessage)
+{
+    if (reply == nullptr || ! reply->getBoolAttribute ("ok"))
+    {
+        errorMessage = reply != nullptr ? reply->getStringAttribute ("error")
+                                        : TRANS ("The plugin sandbox process didn't respond");
+        return false;
+    }
+
+    tailLengthSeconds = reply->getDoubleAttribute ("tail");
+    acceptsMidiFlag   = reply->getBoolAttribute ("acceptsMidi");
+    producesMidiFlag  = reply->getBoolAttribute ("producesMidi");
+    setLatencySamples (reply->getIntAttribute ("latency"));
+
+    isLaunched = true;
+    return true;
+}
+
+void SandboxedPluginInstance::closeTransport()
+{
+    const SpinLock::ScopedLockType lock (transportLock);
+    layout.reset();
+    sharedMemory.close();
+    requestSignal.close();
+    responseSignal.close();
+}
+
+std::unique_ptr<XmlElement> SandboxedPluginInstance::sendAndWait (const XmlElement& xml, int timeoutMs)
+{
+    // while the plugin is still loading, the state and settings are kept to be passed on when it's done
+    if (! isLaunched || connection == nullptr || ! connection->isConnected())
+        return nullptr;
+
+    return connection->sendAndWait (xml, timeoutMs);
+}
+
+bool SandboxedPluginInstance::prepareSandbox()
+{
+    const auto numChannels = jmax (1, getTotalNumInputChannels(), getTotalNumOutputChannels());
+    const auto numSlots = SandboxTransportLayout::defaultNumSlots;
+    const auto maxMidiBytes = SandboxTransportLayout::defaultMaxMidiBytes;
+    const auto size = SandboxTransportLayout::getTotalSize (numChannels, currentBlockSize, numSlots, maxMidiBytes);
+
+    // short enough for macOS's 31-character limit on shared memory names
+    const auto name = "curve" + String::toHexString (Random::getSystemRandom().nextInt64()) + String (++shmGeneration);
+
+    {
+        const SpinLock::ScopedLockType lock (transportLock);
+
+        layout.reset();
+
+        if (! sharedMemory.create (name, size))
+            return false;
+
+        if (! requestSignal.create (name + ".request") || ! responseSignal.create (name + ".response"))
+        {
+            sharedMemory.close();
+            return false;
+        }
+
+        auto* header = new (sharedMemory.getData()) SandboxTransportLayout::Header();
+        header->requestSeq.store (0);
+        header->responseSeq.store (0);
+        header->numChannels = numChannels;
+        header->maxBlockSize = currentBlockSize;
+        header->numSlots = numSlots;
+        header->maxMidiBytes = maxMidiBytes;
+
+        layout = std::make_unique<SandboxTransportLayout> (sharedMemory.getData());
+        nextSeq = 0;
+        consecutiveTimeouts = 0;
+    }
+
+    XmlElement request ("PREPARE");
+    request.setAttribute ("shm", name);
+    request.setAttribute ("size", (int) size);
+    request.setAttribute ("sampleRate", currentSampleRate);
+
+    const auto reply = sendAndWait (request, 10000);
+
+    if (reply == nullptr || ! reply->getBoolAttribute ("ok"))
+        return false;
+
+    setLatencySamples (reply->getIntAttribute ("latency"));
+    ready = true;
+    return true;
+}
+
+void SandboxedPluginInstance::sandboxDied()
+{
+    ready = false;
+
+    // one that dies while loading the plugin is reported by launchFinished() instead of
+    // being relaunched, so that a plugin that crashes as it loads isn't tried forever
+    if (isLaunched)
+        triggerAsyncUpdate();
+}
+
+void SandboxedPluginInstance::handleAsyncUpdate()
+{
+    // the sandbox crashed or hung: tear it down and start a fresh one with the last known state,
+    // which is prepared again when it's up
+    ready = false;
+    closeTransport();
+
+    launcher.reset();
+    connection.reset();
+
+    launchAsync();
+}
+
+//==============================================================================
+void SandboxedPluginInstance::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = jmax (1, maximumExpectedSamplesPerBlock);
+    isPrepared = true;
+
+    ready = false;
+
+    // a sandbox that's still loading its plugin is prepared once it has
+    if (isLaunched)
+        prepareSandbox();
+}
+
+void SandboxedPluginInstance::releaseResources()
+{
+    isPrepared = false;
+    ready = false;
+    closeTransport();
+
+    sendAndWait (XmlElement ("RELEASE"), 2000);
+}
+
+void SandboxedPluginInstance::getStateInformation (juce::MemoryBlock& destData)
+{
+    if (const auto reply = sendAndWait (XmlElement ("GETSTATE"), 5000))
+        lastKnownState.fromBase64Encoding (reply->getAllSubText());
+
+    destData = lastKnownState;
+}
+
+void SandboxedPluginInstance::setStateInformation (const void* data, int sizeInBytes)
+{
+    lastKnownState.replaceAll (data, (size_t) sizeInBytes);
+
+    XmlElement request ("SETSTATE");
+    request.addTextElement (lastKnownState.toBase64Encoding());
+    sendAndWait (request, 5000);
+}
+
+bool SandboxedPluginInstance::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+    return layouts.getMainInputChannels() == getMainBusNumInputChannels()
+        && layouts.getMainOutputChannels() == getMainBusNumOutputChannels();
+}
+
+void SandboxedPluginInstance::fillInPluginDescription (PluginDescription& d) const
+{
+    d = description;
+}
+
+//==============================================================================
+void SandboxedPluginInstance::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
+{
+    process (buffer, midi, false);
+}
+
+void SandboxedPluginInstance::processBlockBypassed (AudioBuffer<float>& buffer, MidiBuffer& midi)
+{
+    process (buffer, midi, true);
+}
+
+void SandboxedPluginInstance::process (AudioBuffer<float>& buffer, MidiBuffer& midi, bool bypassed)
+{
+    const SpinLock::ScopedTryLockType scope (transportLock);
+
+    if (! scope.isLocked() || ! ready || layout == nullptr)
+    {
+        buffer.clear();
+        midi.clear();
+        return;
+    }
+
+    processInSubBlocks (buffer, midi, currentBlockSize, chunkMidi, collectedMidi,
+                        [this, bypassed] (AudioBuffer<float>& block, MidiBuffer& blockMidi) { roundTrip (block, blockMidi, bypassed); });
+}
+
+void SandboxedPluginInstance::roundTrip (AudioBuffer<float>& buffer, MidiBuffer& midi, bool bypassed)
+{
+    auto& header = layout->getHeader();
+    const auto seq = ++nextSeq;
+    const auto slot = (int) (seq % (uint32) header.numSlots);
+    auto& slotHeader = layout->getSlotHeader (slot);
+
+    const auto numSamples = buffer.getNumSamples();
+    const auto numChannels = jmin (buffer.getNumChannels(), header.numChannels);
+
+    for (int ch = 0; ch < header.numChannels; ++ch)
+    {
+        if (ch < numChannels)
+            FloatVectorOperations::copy (layout->getChannel (slot, ch), buffer.getReadPointer (ch), numSamples);
+        else
+            FloatVectorOperations::clear (layout->getChannel (slot, ch), numSamples);
+    }
+
+    slotHeader.numSamples = numSamples;
+    slotHeader.bypassed = bypassed ? 1 : 0;
+    slotHeader.numMidiBytes = SandboxTransportLayout::writeMidi (midi, layout->getMidiData (slot), header.maxMidiBytes);
+
+    header.requestSeq.store (seq, std::memory_order_release);
+    requestSignal.notify (header.requestSeq);
+
+    const auto budgetMs = 1000.0 * (double) numSamples / currentSampleRate * timeoutFraction.load();
+    const auto deadline = Time::getMillisecondCounterHiRes() + budgetMs;
+    auto answered = false;
+
+    for (;;)
+    {
+        const auto current = header.responseSeq.load (std::memory_order_acquire);
+
+        if (current == seq)
+        {
+            answered = true;
+            break;
+        }
+
+        const auto remainingMs = deadline - Time::getMillisecondCounterHiRes();
+
+        if (remainingMs <= 0.0 || ! responseSignal.waitWhileEqual (header.responseSeq, current, remainingMs))
+            break;
+    }
+
+    if (! answered)
+    {
+        buffer.clear();
+        midi.clear();
+
+        if (++consecutiveTimeouts == maxConsecutiveTimeouts)
+        {
+            ready = false;
+            triggerAsyncUpdate();
+        }
+
+        return;
+    }
+
+    consecutiveTimeouts = 0;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        if (ch < numChannels)
+            FloatVectorOperations::copy (buffer.getWritePointer (ch), layout->getChannel (slot, ch), numSamples);
+        else
+            buffer.clear (ch, 0, numSamples);
+    }
+
+    SandboxTransportLayout::readMidi (layout->getMidiData (slot), slotHeader.numMidiBytes, midi);
+}
+
+//==============================================================================
+int SandboxedPluginInstance::runBenchmark()
+{
+    String error;
+    auto sandbox = create (PluginDescription(), {}, error);
+
+    if (sandbox == nullptr)
+    {
+        std::cout << "Couldn't launch sandbox: " << error << std::endl;
+        return 1;
+    }
+
+    // measure the transport, not the deadline handling
+    sandbox->setTimeoutFraction (100.0);
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int numWarmUpBlocks = 200, numBlocks = 5000;
+
+    std::cout << "Sandbox round trip, passthrough, 2 channels @ " << sampleRate << " Hz" << std::endl;
+    std::cout << "block     min us   median us   p99 us    max us   median % of period" << std::endl;
+
+    for (auto blockSize : { 32, 64, 128, 256, 512, 1024 })
+    {
+        sandbox->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        sandbox->prepareToPlay (sampleRate, blockSize);
+
+        AudioBuffer<float> buffer (2, blockSize);
+        MidiBuffer midi;
+        std::vector<double> times;
+        times.reserve ((size_t) numBlocks);
+
+        for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+        {
+            buffer.clear();
+
+            const auto start = Time::getHighResolutionTicks();
+            sandbox->processBlock (buffer, midi);
+            const auto elapsed = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+            if (i >= numWarmUpBlocks)
+                times.push_back (elapsed * 1.0e6);
+        }
+
+        sandbox->releaseResources();
+        std::sort (times.begin(), times.end());
+
+        const auto median = times[times.size() / 2];
+        const auto periodUs = 1.0e6 * blockSize / sampleRate;
+
+        std::cout << String (blockSize).paddedRight (' ', 6)
+                  << String (times.front(), 1).paddedLeft (' ', 10)
+                  << String (median, 1).paddedLeft (' ', 12)
+                  << String (times[(size_t) ((double) times.size() * 0.99)], 1).paddedLeft (' ', 9)
+                  << String (times.back(), 1).paddedLeft (' ', 10)
+                  << String (100.0 * median / periodUs, 2).paddedLeft (' ', 13) << std::endl;
+    }
+
+    return 0;
+}
+
+//==============================================================================
+SandboxWorkerProcess::SandboxWorkerProcess()
+    : Thread ("Curve Sandbox Audio")
+{
+    addDefaultFormatsToManager (formatManager);
+}
+
+SandboxWorkerProcess::~SandboxWorkerProcess()
+{
+    stopProcessing();
+    plugin = nullptr;
+}
+
+void SandboxWorkerProcess::handleMessageFromCoordinator (const MemoryBlock& mb)
+{
+    // plugins expect to be created and controlled on the message thread
+    std::shared_ptr<XmlElement> xml (parseXML (mb.toString()).release());
+
+    if (xml != nullptr)
+        MessageManager::callAsync ([this, xml] { handleControlMessage (*xml); });
+}
+
+void SandboxWorkerProcess::handleConnectionLost()
+{
+    MessageManager::callAsync ([] { JUCEApplicationBase::quit(); });
+}
+
+void SandboxWorkerProcess::reply (const XmlElement& xml)
+{
+    const auto str = toSingleLine (xml);
+    sendMessageToCoordinator ({ str.toRawUTF8(), str.getNumBytesAsUTF8() });
+}
+
+void SandboxWorkerProcess::handleControlMessage (const XmlElement& xml)
+{
+    XmlElement response (xml.getTagName() + "_REPLY");
+    response.setAttribute ("requestID", xml.getIntAttribute ("requestID"));
+
+    if (xml.hasTagName ("CREATE"))
+    {
+        stopProcessing();
+        plugin = nullptr;
+
+        PluginDescription desc;
+        auto ok = true;
+
+        if (auto* pluginXml = xml.getChildByName ("PLUGIN"); pluginXml != nullptr && desc.loadFromXml (*pluginXml))
+        {
+            String error;
+            plugin = formatManager.createPluginInstance (desc, 44100.0, 512, error);
+            ok = plugin != nullptr;
+            response.setAttribute ("error", error);
+        }
+
+        if (plugin != nullptr)
+        {
+            plugin->enableAllBuses();
+
+            if (auto* state = xml.getChildByName ("STATE"))
+            {
+                MemoryBlock m;
+                m.fromBase64Encoding (state->getAllSubText());
+                plugin->setStateInformation (m.getData(), (int) m.getSize());
+            }
+
+            response.setAttribute ("latency", plugin->getLatencySamples());
+            response.setAttribute ("tail", plugin->getTailLengthSeconds());
+            response.setAttribute ("acceptsMidi", plugin->acceptsMidi());
+            response.setAttribute ("producesMidi", plugin->producesMidi());
+        }
+
+        response.setAttribute ("ok", ok);
+    }
+    else if (xml.hasTagName ("PREPARE"))
+    {
+        stopProcessing();
+
+        const auto name = xml.getStringAttribute ("shm");
+        const auto ok = sharedMemory.open (name, (size_t) xml.getIntAttribute ("size"))
+                     && requestSignal.open (name + ".request")
+                     && responseSignal.open (name + ".response");
+
+        if (ok)
+        {
+            layout = std::make_unique<SandboxTransportLayout> (sharedMemory.getData());
+            const auto& header = layout->getHeader();
+            const auto sampleRate = xml.getDoubleAttribute ("sampleRate", 44100.0);
+
+            // the plugin may have more channels than the host gave it; those get silent scratch channels
+            const auto pluginChannels = plugin != nullptr ? jmax (plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels()) : 0;
+            const auto numChannels = jmax (header.numChannels, pluginChannels);
+            extraChannels.setSize (jmax (0, numChannels - header.numChannels), header.maxBlockSize);
+
+            slotChannels.assign ((size_t) header.numSlots, {});
+
+            for (int slot = 0; slot < header.numSlots; ++slot)
+            {
+                for (int ch = 0; ch < numChannels; ++ch)
+                    slotChannels[(size_t) slot].push_back (ch < header.numChannels ? layout->getChannel (slot, ch)
+                                                                                   : extraChannels.getWritePointer (ch - header.numChannels));
+            }
+
+            midi.ensureSize ((size_t) header.maxMidiBytes);
+
+            if (plugin != nullptr)
+            {
+                plugin->setRateAndBufferSizeDetails (sampleRate, header.maxBlockSize);
+                plugin->prepareToPlay (sampleRate, header.maxBlockSize);
+                response.setAttribute ("latency", plugin->getLatencySamples());
+            }
+
+            startRealtimeThread (RealtimeOptions{}.withApproximateAudioProcessingTime (header.maxBlockSize, sampleRate));
+        }
+
+        response.setAttribute ("ok", ok);
+    }
+    else if (xml.hasTagName ("RELEASE"))
+    {
+        stopProcessing();
+    }
+    else if (xml.hasTagName ("GETSTATE"))
+    {
+        MemoryBlock m;
+
+        if (plugin != nullptr)
+            plugin->getStateInformation (m);
+
+        response.addTextElement (m.toBase64Encoding());
+    }
+    else if (xml.hasTagName ("SETSTATE"))
+    {
+        if (plugin != nullptr)
+        {
+            MemoryBlock m;
+            m.fromBase64Encoding (xml.getAllSubText());
+            plugin->setStateInformation (m.getData(), (int) m.getSize());
+        }
+    }
+
+    reply (response);
+}
+
+void SandboxWorkerProcess::stopProcessing()
+{
+    stopThread (2000);
+
+    if (plugin != nullptr && layout != nullptr)
+        plugin->releaseResources();
+
+    layout.reset();
+    sharedMemory.close();
+    requestSignal.close();
+    responseSignal.close();
+}
+
+void SandboxWorkerProcess::run()
+{
+    const ScopedNoDenormals noDenormals;
+
+    auto& header = layout->getHeader();
+    auto lastSeen = header.requestSeq.load (std::memory_order_acquire);
+
+    while (! threadShouldExit())
+    {
+        // wake regularly so that a stop request is noticed even if the host goes quiet
+        if (! requestSignal.waitWhileEqual (header.requestSeq, lastSeen, 50.0))
+            continue;
+
+        // if the host gave up on some blocks while we were stalled, only the newest one matters
+        const auto seq = header.requestSeq.load (std::memory_order_acquire);
+        lastSeen = seq;
+
+        processSlot ((int) (seq % (uint32) header.numSlots));
+
+        header.responseSeq.store (seq, std::memory_order_release);
+        responseSignal.notify (header.responseSeq);
+    }
+}
+
+void SandboxWorkerProcess::processSlot (int slot)
+{
+    const auto& header = layout->getHeader();
+    auto& slotHeader = layout->getSlotHeader (slot);
+
+    if (plugin == nullptr)
+        return;
+
+    const auto numSamples = jlimit (0, header.maxBlockSize, slotHeader.numSamples);
+    auto& channels = slotChannels[(size_t) slot];
+
+    extraChannels.clear();
+    SandboxTransportLayout::readMidi (layout->getMidiData (slot), slotHeader.numMidiBytes, midi);
+
+    AudioBuffer<float> buffer (channels.data(), (int) channels.size(), numSamples);
+
+    if (slotHeader.bypassed != 0)
+        plugin->processBlockBypassed (buffer, midi);
+    else
+        plugin->processBlock (buffer, midi);
+
+    slotHeader.numMidiBytes = SandboxTransportLayout::writeMidi (midi, layout->getMidiData (slot), header.maxMidiBytes);
+}
@@ -0,0 +1,201 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SandboxTransport.h"
+
+constexpr const char* sandboxProcessUID = "curvepluginsandbox";
+
+//==============================================================================
+/**
+    Hosts a plugin in a separate process, so that if the plugin crashes or hangs
+    the rest of the graph keeps running.
+
+    Control messages (creation, preparation, state) go over the same
+    ChildProcessCoordinator pipe that the plugin scanner uses. Audio and MIDI go
+    through a shared-memory ring of block slots with SandboxSignal wake-ups, so
+    the only copies are into and out of the ring.
+
+    If the sandbox doesn't answer within the time budget the block is output as
+    silence; if it crashes, or keeps missing its budget, it is relaunched with the
+    last known plugin state.
+*/
+class SandboxedPluginInstance final : public AudioPluginInstance,
+                                      private AsyncUpdater
+{
+public:
+    /** Launches a sandbox process and waits for it to load the plugin.
+        A default-constructed description gives a stereo passthrough, which is
+        used for benchmarking the transport itself.
+    */
+    static std::unique_ptr<SandboxedPluginInstance> create (const PluginDescription&,
+                                                            const MemoryBlock& initialState,
+                                                            String& errorMessage);
+
+    /** Called on the message thread when the sandbox has loaded the plugin, with an
+        empty string, or has failed to, with the reason.
+    */
+    using LaunchCallback = std::function<void (const String& error)>;
+
+    /** Returns an instance straight away and launches its sandbox in the background,
+        as createPluginInstanceAsync() does, so that the message thread isn't held up
+        while the plugin loads. The instance outputs silence until then, and anything
+        it's asked to do meanwhile is passed on once the plugin is loaded.
+        The callback is only called for this first launch, and not at all if the
+        instance is deleted first.
+    */
+    static std::unique_ptr<SandboxedPluginInstance> createAsync (const PluginDescription&,
+                                                                 const MemoryBlock& initialState,
+                                                                 LaunchCallback);
+
+    ~SandboxedPluginInstance() override;
+
+    //==============================================================================
+    /** How long the audio thread will wait for each round trip, as a fraction of the block duration. */
+    void setTimeoutFraction (double newFraction) noexcept       { timeoutFraction = newFraction; }
+
+    /** Runs the transport against a passthrough sandbox and prints the round-trip times. */
+    static int runBenchmark();
+
+    //==============================================================================
+    const String getName() const override                       { return description.name.isNotEmpty() ? description.name : "Passthrough"; }
+    double getTailLengthSeconds() const override                { return tailLengthSeconds; }
+    bool acceptsMidi() const override                           { return description.isInstrument || acceptsMidiFlag; }
+    bool producesMidi() const override                          { return producesMidiFlag; }
+    AudioProcessorEditor* createEditor() override               { return nullptr; }
+    bool hasEditor() const override                             { return false; }
+    bool supportsDoublePrecisionProcessing() const override     { return false; }
+
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       {}
+    const String getProgramName (int) override                  { return {}; }
+    void changeProgramName (int, const String&) override        {}
+
+    void getStateInformation (juce::MemoryBlock&) override;
+    void setStateInformation (const void*, int) override;
+
+    void prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+
+    void processBlock (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlockBypassed (AudioBuffer<float>&, MidiBuffer&) override;
+    using AudioPluginInstance::processBlock;
+    using AudioPluginInstance::processBlockBypassed;
+
+    bool isBusesLayoutSupported (const BusesLayout&) const override;
+    void fillInPluginDescription (PluginDescription&) const override;
+
+private:
+    //==============================================================================
+    class Connection;
+    class Launcher;
+
+    SandboxedPluginInstance (const PluginDescription&, const MemoryBlock& initialState, int numIns, int numOuts);
+
+    bool launch (String& errorMessage);
+    void launchAsync();
+    void launchFinished (int generation, const XmlElement* reply, const String& errorIfNoReply);
+    bool startProcess (String& errorMessage);
+    XmlElement createLaunchRequest();
+    bool applyLaunchReply (const XmlElement* reply, String& errorMessage);
+    void closeTransport();
+    bool prepareSandbox();
+    void roundTrip (AudioBuffer<float>&, MidiBuffer&, bool bypassed);
+    void process (AudioBuffer<float>&, MidiBuffer&, bool bypassed);
+    void handleAsyncUpdate() override;
+    void sandboxDied();
+
+    std::unique_ptr<XmlElement> sendAndWait (const XmlElement&, int timeoutMs);
+
+    //==============================================================================
+    const PluginDescription description;
+    MemoryBlock lastKnownState;
+
+    std::unique_ptr<Connection> connection;
+    std::unique_ptr<Launcher> launcher;
+    LaunchCallback onLaunched;
+    int launchGeneration = 0;
+    std::atomic<bool> isLaunched { false };
+    MemoryBlock stateSentWithLaunch;
+
+    SandboxSharedMemory sharedMemory;
+    SandboxSignal requestSignal, responseSignal;
+    std::unique_ptr<SandboxTransportLayout> layout;
+    int shmGeneration = 0;
+
+    // held by the audio thread while using the transport, and by the message thread while replacing it
+    SpinLock transportLock;
+    std::atomic<bool> ready { false };
+
+    double currentSampleRate = 0.0;
+    int currentBlockSize = 0;
+    bool isPrepared = false;
+
+    uint32 nextSeq = 0;
+    int consecutiveTimeouts = 0;
+    std::atomic<double> timeoutFraction { 0.5 };
+    MidiBuffer chunkMidi, collectedMidi;
+
+    double tailLengthSeconds = 0.0;
+    bool acceptsMidiFlag = false, producesMidiFlag = false;
+
+    // this many missed deadlines in a row counts as a hang
+    static constexpr int maxConsecutiveTimeouts = 32;
+
+    // loading a plugin can take a while, particularly the first time
+    static constexpr int launchTimeoutMs = 30000;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (SandboxedPluginInstance)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SandboxedPluginInstance)
+};
+
+//==============================================================================
+/**
+    The other end of a SandboxedPluginInstance: runs in the child process, owns
+    the real plugin and services blocks from the shared-memory ring on a
+    realtime thread.
+*/
+class SandboxWorkerProcess final : private ChildProcessWorker,
+                                   private Thread
+{
+public:
+    SandboxWorkerProcess();
+    ~SandboxWorkerProcess() override;
+
+    using ChildProcessWorker::initialiseFromCommandLine;
+
+private:
+    void handleMessageFromCoordinator (const MemoryBlock&) override;
+    void handleConnectionLost() override;
+    void handleControlMessage (const XmlElement&);
+    void reply (const XmlElement&);
+
+    void run() override;
+    void processSlot (int slot);
+    void stopProcessing();
+
+    AudioPluginFormatManager formatManager;
+    std::unique_ptr<AudioPluginInstance> plugin;
+
+    SandboxSharedMemory sharedMemory;
+    SandboxSignal requestSignal, responseSignal;
+    std::unique_ptr<SandboxTransportLayout> layout;
+    std::vector<std::vector<float*>> slotChannels;
+    AudioBuffer<float> extraChannels;
+    MidiBuffer midi;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SandboxWorkerProcess)
+};
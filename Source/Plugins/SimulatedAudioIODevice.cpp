@@ -0,0 +1,223 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "SimulatedAudioIODevice.h"
+#include "ClockedAudioIODevice.h"
+#include <map>
+#include <mutex>
+
+static const char* const simulatedTypeName = "Simulated";
+static constexpr int numSimulatedChannels = 2;
+
+class SimulatedAudioIODevice;
+
+//==============================================================================
+// shared between the type and its devices, so that a device can outlive its type
+struct SimulatedAudioIODeviceType::State
+{
+    struct Device
+    {
+        bool isPresent = true;
+        double supportedRate = 0.0;
+    };
+
+    bool isPresent (const String& name)
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        auto it = devices.find (name);
+        return it != devices.end() && it->second.isPresent;
+    }
+
+    double getSupportedRate (const String& name)
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        auto it = devices.find (name);
+        return it != devices.end() ? it->second.supportedRate : 0.0;
+    }
+
+    std::mutex mutex;
+    std::map<String, Device> devices;
+    Array<SimulatedAudioIODevice*> openDevices;
+};
+
+//==============================================================================
+class SimulatedAudioIODevice final : public ClockedAudioIODevice
+{
+public:
+    SimulatedAudioIODevice (const String& deviceName, std::shared_ptr<SimulatedAudioIODeviceType::State> stateToUse)
+        : ClockedAudioIODevice (deviceName, simulatedTypeName, "Simulated Audio Device"),
+          state (std::move (stateToUse))
+    {
+    }
+
+    ~SimulatedAudioIODevice() override
+    {
+        close();
+    }
+
+    //==============================================================================
+    Array<double> getAvailableSampleRates() override
+    {
+        const auto supportedRate = state->getSupportedRate (getName());
+
+        if (supportedRate > 0.0)
+            return { supportedRate };
+
+        return { 44100.0, 48000.0, 88200.0, 96000.0 };
+    }
+
+    Array<int> getAvailableBufferSizes() override       { return { 32, 64, 128, 256, 512, 1024, 2048 }; }
+    int getDefaultBufferSize() override                 { return 256; }
+
+    bool isPlaying() override                           { return ClockedAudioIODevice::isPlaying() && ! stalled; }
+
+    // called by the type, with the state locked
+    void stopCalling()                                  { stalled = true; }
+
+private:
+    //==============================================================================
+    int getNumChannels (bool) const override            { return numSimulatedChannels; }
+    bool shouldCallBack() const override                { return ! stalled; }
+
+    String getReasonNotToOpen() override
+    {
+        return state->isPresent (getName()) ? String() : "The device isn't connected";
+    }
+
+    void opened() override
+    {
+        stalled = false;
+
+        const std::lock_guard<std::mutex> lock (state->mutex);
+        state->openDevices.add (this);
+    }
+
+    void closed() override
+    {
+        const std::lock_guard<std::mutex> lock (state->mutex);
+        state->openDevices.removeFirstMatchingValue (this);
+    }
+
+    std::shared_ptr<SimulatedAudioIODeviceType::State> state;
+    std::atomic<bool> stalled { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimulatedAudioIODevice)
+};
+
+//==============================================================================
+SimulatedAudioIODeviceType::SimulatedAudioIODeviceType()
+    : AudioIODeviceType (simulatedTypeName),
+      state (std::make_shared<State>())
+{
+    for (auto& name : getAllDeviceNames())
+        state->devices[name] = {};
+}
+
+SimulatedAudioIODeviceType::~SimulatedAudioIODeviceType() = default;
+
+StringArray SimulatedAudioIODeviceType::getAllDeviceNames()
+{
+    return { "Simulated Device A", "Simulated Device B" };
+}
+
+void SimulatedAudioIODeviceType::setDevicePresent (const String& deviceName, bool shouldBePresent)
+{
+    {
+        const std::lock_guard<std::mutex> lock (state->mutex);
+        auto it = state->devices.find (deviceName);
+
+        if (it == state->devices.end() || it->second.isPresent == shouldBePresent)
+            return;
+
+        it->second.isPresent = shouldBePresent;
+
+        if (! shouldBePresent)
+            for (auto* device : state->openDevices)
+                if (device->getName() == deviceName)
+                    device->stopCalling();
+    }
+
+    // a real type has already rescanned by the time it tells anyone
+    scanForDevices();
+    callDeviceChangeListeners();
+}
+
+void SimulatedAudioIODeviceType::stall (const String& deviceName)
+{
+    const std::lock_guard<std::mutex> lock (state->mutex);
+
+    for (auto* device : state->openDevices)
+        if (device->getName() == deviceName)
+            device->stopCalling();
+}
+
+void SimulatedAudioIODeviceType::setSupportedSampleRate (const String& deviceName, double sampleRate)
+{
+    {
+        const std::lock_guard<std::mutex> lock (state->mutex);
+        auto it = state->devices.find (deviceName);
+
+        if (it == state->devices.end())
+            return;
+
+        it->second.supportedRate = sampleRate;
+
+        if (sampleRate > 0.0)
+            for (auto* device : state->openDevices)
+                if (device->getName() == deviceName && device->getCurrentSampleRate() != sampleRate)
+                    device->stopCalling();
+    }
+
+    // drivers report a clock change the same way as a change to the device list
+    callDeviceChangeListeners();
+}
+
+void SimulatedAudioIODeviceType::scanForDevices()
+{
+    scannedNames.clear();
+
+    const std::lock_guard<std::mutex> lock (state->mutex);
+
+    for (auto& [name, device] : state->devices)
+        if (device.isPresent)
+            scannedNames.add (name);
+}
+
+StringArray SimulatedAudioIODeviceType::getDeviceNames (bool) const
+{
+    return scannedNames;
+}
+
+int SimulatedAudioIODeviceType::getDefaultDeviceIndex (bool) const
+{
+    return 0;
+}
+
+int SimulatedAudioIODeviceType::getIndexOfDevice (AudioIODevice* device, bool) const
+{
+    if (auto* d = dynamic_cast<SimulatedAudioIODevice*> (device))
+        return scannedNames.indexOf (d->getName());
+
+    return -1;
+}
+
+AudioIODevice* SimulatedAudioIODeviceType::createDevice (const String& outputDeviceName, const String& inputDeviceName)
+{
+    const auto name = outputDeviceName.isNotEmpty() ? outputDeviceName : inputDeviceName;
+
+    if (! getAllDeviceNames().contains (name))
+        return nullptr;
+
+    return new SimulatedAudioIODevice (name, state);
+}
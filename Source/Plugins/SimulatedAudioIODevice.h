@@ -0,0 +1,68 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A device type with no hardware behind it, whose devices can be made to fail
+    on cue.
+
+    Each device is a ClockedAudioIODevice with silent input. The faults are the
+    ones the AudioResilienceManager has to recover from: a device vanishing and
+    coming back, a driver that silently stops calling back, and a sample rate
+    being changed from outside. They're meant to be driven from the message thread.
+*/
+class SimulatedAudioIODeviceType final : public AudioIODeviceType
+{
+public:
+    SimulatedAudioIODeviceType();
+    ~SimulatedAudioIODeviceType() override;
+
+    static StringArray getAllDeviceNames();
+
+    /** Makes a device disappear or come back, as if it had been unplugged or
+        plugged in. A device that's running when it disappears stops calling back.
+    */
+    void setDevicePresent (const String& deviceName, bool shouldBePresent);
+
+    /** Stops a running device's callbacks without telling anyone, as a hung
+        driver would. Opening the device again clears it.
+    */
+    void stall (const String& deviceName);
+
+    /** Limits a device to one sample rate, or lifts the limit if given 0. A
+        device running at any other rate stops, as if its clock source had changed.
+    */
+    void setSupportedSampleRate (const String& deviceName, double sampleRate);
+
+    //==============================================================================
+    void scanForDevices() override;
+    StringArray getDeviceNames (bool wantInputNames) const override;
+    int getDefaultDeviceIndex (bool forInput) const override;
+    int getIndexOfDevice (AudioIODevice*, bool asInput) const override;
+    bool hasSeparateInputsAndOutputs() const override       { return false; }
+    AudioIODevice* createDevice (const String& outputDeviceName, const String& inputDeviceName) override;
+
+private:
+    //==============================================================================
+    struct State;
+    friend class SimulatedAudioIODevice;
+
+    std::shared_ptr<State> state;
+    StringArray scannedNames;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimulatedAudioIODeviceType)
+};
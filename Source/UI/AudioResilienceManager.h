@@ -14,18 +14,74 @@
 #pragma once
 #include <JuceHeader.h>
 #include <functional>
+#include <map>
+#include <optional>
+#include <utility>
+#include "ResilienceTelemetry.h"
+#include "SilentAudioCallback.h"
 
+#if JUCE_LINUX
+ #include <sys/inotify.h>
+ #include <poll.h>
+ #include <unistd.h>
+#endif
+
+// Keeps the saved target device open: closes the device when the target goes away, and reopens it when
+// the target comes back, after sleep, or when something else has selected a different device.
+// Recovery is driven by events: device manager changes (which carry CoreAudio and WASAPI hot-plug
+// notifications), and on Linux, device nodes appearing or disappearing under /dev/snd. A one-second
+// poll still catches a stalled device or a wake from sleep, but it only rescans the devices now and
+// then as a safety net. The target configuration is parsed once and only re-read when the settings
+// change, and otherwise the devices are only rescanned when an event says the list may have changed.
+// When the target is missing, the preset's failover list is tried in order, and the target is returned
+// to as soon as it's back. Optionally, the next device down the list is kept open and running silently,
+// so that its driver and clock are already up if it's needed.
+// Everything it notices and does goes to a ResilienceTelemetry, timed from the event that reported the
+// problem to the first audio callback afterwards.
 class AudioResilienceManager : private juce::Timer,
-                               private juce::ChangeListener
+                               private juce::ChangeListener,
+                               private juce::AsyncUpdater
 {
 public:
     using ConfigRestoredCallback = std::function<void()>;
 
-    AudioResilienceManager(juce::AudioDeviceManager& dm, ConfigRestoredCallback callback = nullptr)
-        : deviceManager(dm), onConfigRestored(callback)
+    struct DeviceChoice
+    {
+        juce::String typeName, inputDeviceName, outputDeviceName;
+
+        bool operator==(const DeviceChoice& other) const
+        {
+            return typeName == other.typeName && inputDeviceName == other.inputDeviceName
+                && outputDeviceName == other.outputDeviceName;
+        }
+    };
+
+    // supplies the current preset's failover devices, most preferred first
+    using FailoverListProvider = std::function<juce::Array<DeviceChoice>()>;
+
+    static bool isStandbyEnabled()
+    {
+        return getAppProperties().getUserSettings()->getBoolValue("keepFailoverStandbyOpen", false);
+    }
+
+    static void setStandbyEnabled(bool shouldBeEnabled)
+    {
+        getAppProperties().getUserSettings()->setValue("keepFailoverStandbyOpen", shouldBeEnabled);
+    }
+
+    AudioResilienceManager(juce::AudioDeviceManager& dm, ConfigRestoredCallback callback = nullptr,
+                           FailoverListProvider failoverProvider = nullptr)
+        : deviceManager(dm), getFailoverList(std::move(failoverProvider)), onConfigRestored(callback)
     {
         deviceManager.addChangeListener(this);
 
+        if (auto* settings = getAppProperties().getUserSettings())
+            settings->addChangeListener(this);
+
+       #if JUCE_LINUX
+        deviceNodeWatcher = std::make_unique<DeviceNodeWatcher>([this] { deviceListMayHaveChanged(); });
+       #endif
+
         if (auto* device = deviceManager.getCurrentAudioDevice())
         {
             lastDeviceName = device->getName();
@@ -39,18 +95,44 @@ public:
 
     ~AudioResilienceManager() override
     {
+        closeStandby();
+
+       #if JUCE_LINUX
+        deviceNodeWatcher = nullptr;
+       #endif
+
+        if (auto* settings = getAppProperties().getUserSettings())
+            settings->removeChangeListener(this);
+
         deviceManager.removeChangeListener(this);
     }
 
-    // callback when an audio config change occurs
-    void changeListenerCallback(juce::ChangeBroadcaster*) override
+    ResilienceTelemetry& getTelemetry() noexcept        { return telemetry; }
+
+    // callback when an audio config change occurs, or the settings change
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override
     {
+        if (source != &deviceManager)
+        {
+            // the target may have been changed in the audio settings; parse it again when it's next needed
+            targetIsStale = true;
+
+            if (isStandbyEnabled() != standbyWasEnabled && isWarmedUp)
+                startTimer(eventSettleMs);
+
+            return;
+        }
+
+        // this is also how the device types pass on their own hot-plug notifications
+        devicesNeedRescanning = true;
+        noteDetection();
+
         if (!isWarmedUp || isRestarting) return;
 
         // call doResilience
         doResilience();
 
-        // if device name or channels changed, call the lambda function to reload the current preset
+        // if device name or channels changed, let the host pick up the new device (the graph itself is kept)
         auto* currentDevice = deviceManager.getCurrentAudioDevice();
         juce::String currentName = (currentDevice != nullptr) ? currentDevice->getName() : juce::String();
         juce::BigInteger currentInputChannels = (currentDevice != nullptr) ? currentDevice->getActiveInputChannels() : juce::BigInteger();
@@ -65,15 +147,17 @@ public:
         }
     }
 
-    // callback every 1 sec (except during initial 5 sec warmup)
+    // the poll (after an initial 5 sec warmup), and the short settle after a device event
     void timerCallback() override
     {
         if (!isWarmedUp)
-        {
             isWarmedUp = true;
-            startTimer(1000);
-            return;
-        }
+
+        startTimer(pollMs);
+
+        // a rescan now and then catches anything no event reported
+        if (juce::Time::getMillisecondCounter() - lastRescanTime >= (uint32) fallbackRescanMs)
+            devicesNeedRescanning = true;
 
         // call doResilience
         doResilience();
@@ -85,12 +169,23 @@ public:
         if (juce::Component::getCurrentlyModalComponent() != nullptr)
             return;
 
+        // whatever happens in this pass is timed from the event that prompted it, or from now for a poll
+        detectedMs = pendingDetectionMs > 0.0 ? std::exchange(pendingDetectionMs, 0.0) : juce::Time::getMillisecondCounterHiRes();
+
         uint32 now = juce::Time::getMillisecondCounter();
-        bool wokeFromSleep = (now > lastTimeCheck + 4000);
+        bool wokeFromSleep = (now > lastTimeCheck + pollMs + 4000);
         lastTimeCheck = now;
 
-        // try to get saved Xml state; bail if there is no saved state or saved state doesn't specify target device
-        auto savedState = getAppProperties().getUserSettings()->getXmlValue ("audioDeviceState");
+        if (wokeFromSleep)
+            devicesNeedRescanning = true;
+
+        if (targetIsStale)
+        {
+            savedState = getAppProperties().getUserSettings()->getXmlValue ("audioDeviceState");
+            targetIsStale = false;
+        }
+
+        // bail if there is no saved state or saved state doesn't specify target device
         if (savedState == nullptr)
             return;
         juce::String savedInputDeviceName = savedState->getStringAttribute("audioInputDeviceName");
@@ -99,16 +194,81 @@ public:
         if (!isTargetDeviceSaved)
             return;
 
-        // if target device is not physically present, null currentDevice and bail
-        bool isTargetPhysicallyPresent = isDeviceAvailable(savedInputDeviceName) && isDeviceAvailable(savedOutputDeviceName);
+        if (devicesNeedRescanning)
+            rescanDevices();
+
+        // the target first, then the preset's failover devices in order
+        juce::Array<DeviceChoice> candidates { { savedState->getStringAttribute("deviceType"), savedInputDeviceName, savedOutputDeviceName } };
+
+        if (getFailoverList != nullptr)
+            for (auto& choice : getFailoverList())
+                candidates.addIfNotAlreadyThere(choice);
+
+        int chosen = -1;
+
+        for (int i = 0; i < candidates.size() && chosen < 0; ++i)
+            if (isAvailable(candidates.getReference(i)))
+                chosen = i;
+
+        const bool targetIsPresent = chosen == 0;
+
+        if (targetWasPresent && ! targetIsPresent)
+            telemetry.record(ResilienceTelemetry::Event::disconnect, savedOutputDeviceName, detectedMs);
+
+        switchTo(candidates, chosen, wokeFromSleep);
+
+        if (wokeFromSleep)
+            telemetry.record(ResilienceTelemetry::Event::wakeFromSleep, savedOutputDeviceName, detectedMs);
+        else if (targetIsPresent && ! targetWasPresent)
+            telemetry.record(ResilienceTelemetry::Event::reconnect, savedOutputDeviceName, detectedMs);
+
+        targetWasPresent = targetIsPresent;
+
+        // only once the device manager has let go of whatever it had before
+        updateStandby(candidates, chosen);
+    }
+
+private:
+    static constexpr int pollMs = 1000;
+    static constexpr int fallbackRescanMs = 10000;
+    static constexpr int eventSettleMs = 250;
+
+    juce::AudioDeviceManager& deviceManager;
+    ResilienceTelemetry telemetry { deviceManager };
+    double pendingDetectionMs = 0.0, detectedMs = 0.0;
+    bool targetWasPresent = true;
+    uint32 lastTimeCheck;
+    bool isRestarting = false;
+    bool isWarmedUp = false;
+    juce::String lastDeviceName;
+    juce::BigInteger lastInputChannels;
+    juce::BigInteger lastOutputChannels;
+
+    std::unique_ptr<juce::XmlElement> savedState;
+    bool targetIsStale = true;
+    bool devicesNeedRescanning = true;
+    uint32 lastRescanTime = 0;
+    std::map<juce::String, juce::StringArray> availableDeviceNames;    // by type name
+
+    // candidates[0] is the saved target; chosen is the first one present, or -1 if none is
+    void switchTo(const juce::Array<DeviceChoice>& candidates, int chosen, bool wokeFromSleep)
+    {
+        // if neither the target nor any failover device is physically present, null currentDevice and bail
         auto* currentDevice = deviceManager.getCurrentAudioDevice();
-        if (!isTargetPhysicallyPresent)
+        if (chosen < 0)
         {
             if (currentDevice != nullptr)
                 forceNullDevice();
             return;
         }
 
+        if (chosen > 0)
+        {
+            if (wokeFromSleep || !isSelected(candidates.getReference(chosen)) || currentDevice == nullptr || !currentDevice->isPlaying())
+                failOverTo(candidates.getReference(chosen));
+            return;
+        }
+
         // if we just woke from sleep (and target device is physically present), enforce config then bail
         if (wokeFromSleep)
         {
@@ -119,42 +279,256 @@ public:
         // if target device is physically present but not selected in currentSetup, or if it is selected but not playing, enforce config
         juce::AudioDeviceManager::AudioDeviceSetup currentSetup;
         deviceManager.getAudioDeviceSetup(currentSetup);
-        bool isTargetSelected = (currentSetup.inputDeviceName == savedInputDeviceName) &&
-                                (currentSetup.outputDeviceName == savedOutputDeviceName);
+        bool isTargetSelected = (currentSetup.inputDeviceName == candidates.getReference(0).inputDeviceName) &&
+                                (currentSetup.outputDeviceName == candidates.getReference(0).outputDeviceName);
         if (!isTargetSelected || (currentDevice != nullptr && !currentDevice->isPlaying()))
         {
                 enforceConfiguration(savedState.get());
         }
     }
 
-private:
-    juce::AudioDeviceManager& deviceManager;
-    uint32 lastTimeCheck;
-    bool isRestarting = false;
-    bool isWarmedUp = false;
-    juce::String lastDeviceName;
-    juce::BigInteger lastInputChannels;
-    juce::BigInteger lastOutputChannels;
-
-    bool isDeviceAvailable(const juce::String& name)
+    void rescanDevices()
     {
+        availableDeviceNames.clear();
+
         for (auto* type : deviceManager.getAvailableDeviceTypes())
         {
             type->scanForDevices();
-            if (type->getDeviceNames(true).contains(name)) return true;
-            if (type->getDeviceNames(false).contains(name)) return true;
+
+            auto& names = availableDeviceNames[type->getTypeName()];
+            names.addArray(type->getDeviceNames(true));
+            names.addArray(type->getDeviceNames(false));
         }
-        return false;
+
+        devicesNeedRescanning = false;
+        lastRescanTime = juce::Time::getMillisecondCounter();
+    }
+
+    // the same name can belong to more than one type (e.g. ALSA and JACK), so it has to be there under the
+    // one asked for; a state saved without a type can match any of them
+    bool isDeviceAvailable(const juce::String& typeName, const juce::String& name) const
+    {
+        if (typeName.isEmpty())
+        {
+            for (auto& [type, names] : availableDeviceNames)
+                if (names.contains(name))
+                    return true;
+
+            return false;
+        }
+
+        auto it = availableDeviceNames.find(typeName);
+        return it != availableDeviceNames.end() && it->second.contains(name);
+    }
+
+    // a failover device may be output-only
+    bool isAvailable(const DeviceChoice& choice) const
+    {
+        return isDeviceAvailable(choice.typeName, choice.outputDeviceName)
+            && (choice.inputDeviceName.isEmpty() || isDeviceAvailable(choice.typeName, choice.inputDeviceName));
+    }
+
+    bool isSelected(const DeviceChoice& choice) const
+    {
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        deviceManager.getAudioDeviceSetup(setup);
+
+        return deviceManager.getCurrentAudioDeviceType() == choice.typeName
+            && setup.inputDeviceName == choice.inputDeviceName
+            && setup.outputDeviceName == choice.outputDeviceName;
+    }
+
+    juce::AudioIODeviceType* findType(const juce::String& typeName) const
+    {
+        for (auto* type : deviceManager.getAvailableDeviceTypes())
+            if (type->getTypeName() == typeName)
+                return type;
+
+        return nullptr;
+    }
+
+    // opens a failover device at the target's rate and buffer size, without making it the saved target
+    void failOverTo(const DeviceChoice& choice)
+    {
+        if (isRestarting) return;
+        isRestarting = true;
+
+        // the device manager has to open the device itself, so the standby lets go of it first
+        if (standbyChoice == choice)
+            closeStandby();
+
+        if (deviceManager.getCurrentAudioDeviceType() != choice.typeName)
+            deviceManager.setCurrentAudioDeviceType(choice.typeName, false);
+
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        deviceManager.getAudioDeviceSetup(setup);
+        setup.inputDeviceName = choice.inputDeviceName;
+        setup.outputDeviceName = choice.outputDeviceName;
+        setup.sampleRate = savedState->getDoubleAttribute("audioDeviceRate", setup.sampleRate);
+        setup.bufferSize = savedState->getIntAttribute("audioDeviceBufferSize", setup.bufferSize);
+        setup.useDefaultInputChannels = setup.useDefaultOutputChannels = true;
+
+        const auto startMs = juce::Time::getMillisecondCounterHiRes();
+        auto error = deviceManager.setAudioDeviceSetup(setup, false);
+        telemetry.record(ResilienceTelemetry::Event::failover, choice.outputDeviceName, detectedMs,
+                         juce::Time::getMillisecondCounterHiRes() - startMs);
+
+        juce::Logger::writeToLog(error.isEmpty() ? "Failed over to " + choice.outputDeviceName
+                                                 : "Couldn't fail over to " + choice.outputDeviceName + ": " + error);
+        isRestarting = false;
+    }
+
+    // keeps the next available device after the chosen one open and running, or closes it
+    void updateStandby(const juce::Array<DeviceChoice>& candidates, int chosen)
+    {
+        standbyWasEnabled = isStandbyEnabled();
+        std::optional<DeviceChoice> wanted;
+
+        if (standbyWasEnabled && chosen >= 0)
+            for (int i = chosen + 1; i < candidates.size() && ! wanted.has_value(); ++i)
+                if (isAvailable(candidates.getReference(i)))
+                    wanted = candidates.getReference(i);
+
+        if (wanted == standbyChoice && (standbyDevice != nullptr || ! wanted.has_value()))
+            return;
+
+        closeStandby();
+
+        if (! wanted.has_value())
+            return;
+
+        auto* type = findType(wanted->typeName);
+        std::unique_ptr<juce::AudioIODevice> device(type != nullptr ? type->createDevice(wanted->outputDeviceName, wanted->inputDeviceName)
+                                                                    : nullptr);
+        if (device == nullptr)
+            return;
+
+        juce::BigInteger inputs, outputs;
+        inputs.setRange(0, device->getInputChannelNames().size(), true);
+        outputs.setRange(0, device->getOutputChannelNames().size(), true);
+
+        const auto error = device->open(inputs, outputs, savedState->getDoubleAttribute("audioDeviceRate", 0.0),
+                                        savedState->getIntAttribute("audioDeviceBufferSize", 0));
+        if (error.isNotEmpty())
+        {
+            juce::Logger::writeToLog("Couldn't open " + wanted->outputDeviceName + " as a standby: " + error);
+            return;
+        }
+
+        device->start(&silence);
+        standbyDevice = std::move(device);
+        standbyChoice = wanted;
+    }
+
+    void closeStandby()
+    {
+        if (standbyDevice != nullptr)
+        {
+            standbyDevice->stop();
+            standbyDevice->close();
+        }
+
+        standbyDevice = nullptr;
+        standbyChoice.reset();
+    }
+
+    FailoverListProvider getFailoverList;
+    SilentAudioCallback silence;
+    std::unique_ptr<juce::AudioIODevice> standbyDevice;
+    std::optional<DeviceChoice> standbyChoice;
+    bool standbyWasEnabled = false;
+
+    // called from the watcher thread
+    void deviceListMayHaveChanged()
+    {
+        triggerAsyncUpdate();
+    }
+
+    void handleAsyncUpdate() override
+    {
+        devicesNeedRescanning = true;
+        noteDetection();
+
+        // a hot-plug usually creates or removes several nodes in a burst, so let it settle first
+        if (isWarmedUp)
+            startTimer(eventSettleMs);
+    }
+
+   #if JUCE_LINUX
+    // ALSA creates and removes the nodes under /dev/snd as cards come and go
+    class DeviceNodeWatcher : private juce::Thread
+    {
+    public:
+        explicit DeviceNodeWatcher(std::function<void()> callback)
+            : juce::Thread("Audio Device Watcher"), onChange(std::move(callback))
+        {
+            startThread(juce::Thread::Priority::background);
+        }
+
+        ~DeviceNodeWatcher() override
+        {
+            stopThread(2000);
+        }
+
+    private:
+        std::function<void()> onChange;
+
+        void run() override
+        {
+            const auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+            if (fd < 0)
+                return;
+
+            if (inotify_add_watch(fd, "/dev/snd", IN_CREATE | IN_DELETE | IN_ATTRIB) < 0)
+            {
+                close(fd);
+                return;
+            }
+
+            alignas(inotify_event) char buffer[4096];
+
+            while (! threadShouldExit())
+            {
+                pollfd pfd { fd, POLLIN, 0 };
+
+                if (poll(&pfd, 1, 250) <= 0)
+                    continue;
+
+                bool changed = false;
+
+                while (read(fd, buffer, sizeof(buffer)) > 0)
+                    changed = true;
+
+                if (changed)
+                    onChange();
+            }
+
+            close(fd);
+        }
+    };
+
+    std::unique_ptr<DeviceNodeWatcher> deviceNodeWatcher;
+   #endif
+
+    // the first event of a burst is when the problem was detected
+    void noteDetection()
+    {
+        if (pendingDetectionMs == 0.0)
+            pendingDetectionMs = juce::Time::getMillisecondCounterHiRes();
     }
 
     void enforceConfiguration(XmlElement* savedState)
     {
         if (isRestarting) return;
         isRestarting = true;
+        const auto startMs = juce::Time::getMillisecondCounterHiRes();
         // close and re-initialize device using saved state (without fallback to default device is target is not available)
         deviceManager.closeAudioDevice();
         bool granted = RuntimePermissions::isGranted (RuntimePermissions::recordAudio);
         deviceManager.initialise (granted ? 256 : 0, 256, savedState, false);
+        telemetry.record(ResilienceTelemetry::Event::enforcedConfiguration, savedState->getStringAttribute("audioOutputDeviceName"),
+                         detectedMs, juce::Time::getMillisecondCounterHiRes() - startMs);
         isRestarting = false;
     }
 
@@ -162,9 +536,11 @@ private:
     {
         if (isRestarting) return;
         isRestarting = true;
+        const auto startMs = juce::Time::getMillisecondCounterHiRes();
         // close device and clear previous state by using default-constructed setup
         juce::AudioDeviceManager::AudioDeviceSetup setup;
         deviceManager.setAudioDeviceSetup(setup, false);
+        telemetry.record(ResilienceTelemetry::Event::forcedNullDevice, {}, detectedMs, juce::Time::getMillisecondCounterHiRes() - startMs);
         isRestarting = false;
     }
 
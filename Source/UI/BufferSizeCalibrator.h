@@ -0,0 +1,263 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include "GraphEditorPanel.h"
+
+// Steps through the current device's buffer sizes (smallest first) with the current preset running,
+// and picks the smallest one that renders every callback within budget (less a safety margin) with no xruns.
+// Results are stored per device and preset in the user settings.
+class BufferSizeCalibrator : private juce::Timer
+{
+public:
+    using FinishedCallback = std::function<void(int bufferSize)>;
+
+    BufferSizeCalibrator(juce::AudioDeviceManager& dm, GraphDocumentComponent& g)
+        : deviceManager(dm), graphHolder(g)
+    {
+    }
+
+    ~BufferSizeCalibrator() override
+    {
+        stopTimer();
+    }
+
+    // called with the chosen buffer size, or 0 if nothing passed and the original setup was restored
+    FinishedCallback onFinished;
+
+    bool isRunning() const { return isTimerRunning(); }
+
+    // returns false if there is no running device to calibrate
+    bool start()
+    {
+        if (isRunning())
+            return false;
+
+        auto* device = deviceManager.getCurrentAudioDevice();
+        if (device == nullptr || !device->isPlaying() || graphHolder.getRenderEngine() == nullptr)
+            return false;
+
+        candidates = device->getAvailableBufferSizes();
+        candidates.sort();
+        if (candidates.isEmpty())
+            return false;
+
+        deviceManager.getAudioDeviceSetup(originalSetup);
+        deviceKey = getDeviceKey();
+        presetKey = getPresetKey();
+        candidateIndex = -1;
+
+        if (!tryNextCandidate())
+            return false;
+
+        startTimer(tickIntervalMs);
+        return true;
+    }
+
+    void cancel()
+    {
+        if (!isRunning())
+            return;
+
+        stopTimer();
+        deviceManager.setAudioDeviceSetup(originalSetup, true);
+    }
+
+    // applies the stored result for the current device and preset, if there is one
+    bool applyStoredResult()
+    {
+        if (isRunning())
+            return false;
+
+        auto* device = deviceManager.getCurrentAudioDevice();
+        auto bufferSize = getStoredBufferSize(getDeviceKey(), getPresetKey());
+        if (device == nullptr || bufferSize <= 0 || !device->getAvailableBufferSizes().contains(bufferSize))
+            return false;
+
+        if (device->getCurrentBufferSizeSamples() == bufferSize)
+            return true;
+
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        deviceManager.getAudioDeviceSetup(setup);
+        setup.bufferSize = bufferSize;
+        return deviceManager.setAudioDeviceSetup(setup, true).isEmpty();
+    }
+
+    // fraction of each callback's duration that must be left unused, e.g. 0.25 allows a peak load of 75%
+    static double getSafetyMargin()
+    {
+        return juce::jlimit(0.0, 0.9, getAppProperties().getUserSettings()->getDoubleValue("bufferSizeSafetyMargin", 0.25));
+    }
+
+private:
+    static constexpr int tickIntervalMs = 100;
+    static constexpr int settleTimeMs = 750;
+    static constexpr int measureTimeMs = 3000;
+    static constexpr int minCallbacksPerWindow = 20;
+
+    enum class Phase { settling, measuring };
+
+    juce::AudioDeviceManager& deviceManager;
+    GraphDocumentComponent& graphHolder;
+
+    juce::AudioDeviceManager::AudioDeviceSetup originalSetup;
+    juce::String deviceKey, presetKey;
+    juce::Array<int> candidates;
+    int candidateIndex = -1;
+
+    Phase phase = Phase::settling;
+    uint32 phaseStartTime = 0;
+    int xrunsAtStart = 0;
+
+    void timerCallback() override
+    {
+        // bail if the device went away or was changed underneath us
+        auto* device = deviceManager.getCurrentAudioDevice();
+        if (device == nullptr || getDeviceKey() != deviceKey)
+        {
+            stopTimer();
+            return;
+        }
+
+        auto elapsed = juce::Time::getMillisecondCounter() - phaseStartTime;
+
+        if (phase == Phase::settling)
+        {
+            if (elapsed < (uint32) settleTimeMs)
+                return;
+
+            if (auto* engine = graphHolder.getRenderEngine())
+                engine->resetCallbackStats();
+
+            xrunsAtStart = device->getXRunCount();
+            phase = Phase::measuring;
+            phaseStartTime = juce::Time::getMillisecondCounter();
+            return;
+        }
+
+        if (elapsed < (uint32) measureTimeMs)
+            return;
+
+        if (candidatePassed(*device))
+        {
+            finish(candidates[candidateIndex]);
+            return;
+        }
+
+        if (!tryNextCandidate())
+            finish(0);
+    }
+
+    bool candidatePassed(juce::AudioIODevice& device) const
+    {
+        auto* engine = graphHolder.getRenderEngine();
+        if (engine == nullptr || !device.isPlaying() || device.getCurrentBufferSizeSamples() != candidates[candidateIndex])
+            return false;
+
+        auto stats = engine->getCallbackStats();
+
+        // devices that can't count xruns report -1
+        auto xruns = device.getXRunCount();
+        bool hadXRuns = xruns >= 0 && xrunsAtStart >= 0 && xruns > xrunsAtStart;
+
+        return stats.numCallbacks >= minCallbacksPerWindow
+            && stats.numOverBudget == 0
+            && !hadXRuns
+            && stats.peakLoad <= 1.0 - getSafetyMargin();
+    }
+
+    bool tryNextCandidate()
+    {
+        while (++candidateIndex < candidates.size())
+        {
+            auto setup = originalSetup;
+            setup.bufferSize = candidates[candidateIndex];
+
+            if (deviceManager.setAudioDeviceSetup(setup, true).isEmpty())
+            {
+                phase = Phase::settling;
+                phaseStartTime = juce::Time::getMillisecondCounter();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void finish(int bufferSize)
+    {
+        stopTimer();
+
+        auto setup = originalSetup;
+        if (bufferSize > 0)
+        {
+            setup.bufferSize = bufferSize;
+            storeResult(bufferSize);
+        }
+        deviceManager.setAudioDeviceSetup(setup, true);
+
+        if (onFinished != nullptr)
+            onFinished(bufferSize);
+    }
+
+    juce::String getDeviceKey() const
+    {
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        deviceManager.getAudioDeviceSetup(setup);
+        return deviceManager.getCurrentAudioDeviceType() + "|" + setup.inputDeviceName + "|" + setup.outputDeviceName
+             + "|" + juce::String(setup.sampleRate);
+    }
+
+    juce::String getPresetKey() const
+    {
+        if (auto* g = graphHolder.graph.get())
+            return g->getFile().getFullPathName();
+        return {};
+    }
+
+    static int getStoredBufferSize(const juce::String& device, const juce::String& preset)
+    {
+        if (auto xml = getAppProperties().getUserSettings()->getXmlValue("bufferSizeCalibrations"))
+            for (auto* e : xml->getChildWithTagNameIterator("RESULT"))
+                if (e->getStringAttribute("device") == device && e->getStringAttribute("preset") == preset)
+                    return e->getIntAttribute("bufferSize");
+        return 0;
+    }
+
+    void storeResult(int bufferSize) const
+    {
+        auto* settings = getAppProperties().getUserSettings();
+        auto xml = settings->getXmlValue("bufferSizeCalibrations");
+        if (xml == nullptr)
+            xml = std::make_unique<juce::XmlElement>("CALIBRATIONS");
+
+        juce::XmlElement* entry = nullptr;
+        for (auto* e : xml->getChildWithTagNameIterator("RESULT"))
+            if (e->getStringAttribute("device") == deviceKey && e->getStringAttribute("preset") == presetKey)
+                entry = e;
+
+        if (entry == nullptr)
+        {
+            entry = xml->createNewChildElement("RESULT");
+            entry->setAttribute("device", deviceKey);
+            entry->setAttribute("preset", presetKey);
+        }
+        entry->setAttribute("bufferSize", bufferSize);
+        entry->setAttribute("time", juce::Time::getCurrentTime().toISO8601(true));
+
+        settings->setValue("bufferSizeCalibrations", xml.get());
+        settings->saveIfNeeded();
+    }
+};
@@ -0,0 +1,270 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <bcrypt.h>
+ #pragma comment(lib, "bcrypt")
+#else
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+// A line-based control socket, listening on the loopback interface only, so it can be driven with nc or
+// a few lines of any scripting language.
+// Anything on the machine can reach the loopback interface, including a web page making a cross-protocol
+// request, so the first line of each connection has to be "auth <token>". The token is random, made
+// afresh each time the server starts, and written to a file only the user can read:
+//   (echo "auth $(cat <token file>)"; echo status) | nc 127.0.0.1 <port>
+// After that, each line is one command and gets one line back. The commands run on the message thread,
+// one at a time, through the handler; the socket thread waits for each to finish before reading the next.
+// The connection is closed at the first line that isn't the token or a command the handler knows, so a
+// stray HTTP request goes no further than its request line.
+// One client is served at a time, which is all a control connection needs.
+class ControlServer : private juce::Thread
+{
+public:
+    // called on the message thread with the command line; returns the reply, or nothing if the
+    // command isn't one it knows
+    using CommandHandler = std::function<std::optional<juce::String>(const juce::String&)>;
+
+    ControlServer(int portToUse, const juce::File& tokenFileToUse, CommandHandler handlerToUse)
+        : juce::Thread("Control Server"), port(portToUse), tokenFile(tokenFileToUse), token(createToken()),
+          handler(std::move(handlerToUse))
+    {
+        if (token.isEmpty() || ! writeTokenFile())
+        {
+            juce::Logger::writeToLog("Couldn't write the control token to " + tokenFile.getFullPathName());
+            return;
+        }
+
+        if (listener.createListener(port, "127.0.0.1"))
+        {
+            juce::Logger::writeToLog("Listening for control commands on 127.0.0.1:" + juce::String(port)
+                                       + "; the token is in " + tokenFile.getFullPathName());
+            startThread(juce::Thread::Priority::background);
+        }
+        else
+        {
+            juce::Logger::writeToLog("Couldn't listen for control commands on port " + juce::String(port));
+        }
+    }
+
+    ~ControlServer() override
+    {
+        signalThreadShouldExit();
+        listener.close();
+        stopThread(5000);
+        tokenFile.deleteFile();
+    }
+
+    bool isListening() const noexcept       { return isThreadRunning(); }
+
+private:
+    static constexpr int maxLineLength = 4096;
+    static constexpr int commandTimeoutMs = 60000;
+    static constexpr size_t tokenBytes = 32;
+
+    const int port;
+    const juce::File tokenFile;
+    const juce::String token;
+    CommandHandler handler;
+    juce::StreamingSocket listener;
+
+    static juce::String createToken()
+    {
+        juce::MemoryBlock bytes(tokenBytes, true);
+
+       #if JUCE_WINDOWS
+        if (! BCRYPT_SUCCESS(BCryptGenRandom(nullptr, static_cast<PUCHAR>(bytes.getData()), (ULONG) bytes.getSize(),
+                                             BCRYPT_USE_SYSTEM_PREFERRED_RNG)))
+            return {};
+       #else
+        juce::FileInputStream source(juce::File("/dev/urandom"));
+
+        if (! source.openedOk() || source.read(bytes.getData(), (int) bytes.getSize()) != (int) bytes.getSize())
+            return {};
+       #endif
+
+        return juce::String::toHexString(bytes.getData(), (int) bytes.getSize(), 0);
+    }
+
+    bool writeTokenFile() const
+    {
+        if (! tokenFile.getParentDirectory().createDirectory())
+            return false;
+
+       #if JUCE_WINDOWS
+        // the user's application data folder is already private to them
+        return tokenFile.replaceWithText(token);
+       #else
+        // created unreadable by anyone else before the token goes in, and never through a symlink
+        tokenFile.deleteFile();
+
+        const auto fd = ::open(tokenFile.getFullPathName().toRawUTF8(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+        if (fd < 0)
+            return false;
+
+        const auto length = (ssize_t) token.getNumBytesAsUTF8();
+        const auto ok = fchmod(fd, S_IRUSR | S_IWUSR) == 0 && ::write(fd, token.toRawUTF8(), (size_t) length) == length;
+        ::close(fd);
+        return ok;
+       #endif
+    }
+
+    // compares every character, so that the time taken doesn't say how much of a guess was right
+    bool isToken(const juce::String& candidate) const
+    {
+        if (candidate.length() != token.length())
+            return false;
+
+        int difference = 0;
+
+        for (int i = 0; i < token.length(); ++i)
+            difference |= (int) (candidate[i] ^ token[i]);
+
+        return difference == 0;
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            std::unique_ptr<juce::StreamingSocket> connection(listener.waitForNextConnection());
+
+            if (connection == nullptr)
+                continue;
+
+            serve(*connection);
+        }
+    }
+
+    void serve(juce::StreamingSocket& connection)
+    {
+        juce::MemoryBlock pending;
+        bool isAuthenticated = false;
+
+        while (! threadShouldExit() && connection.isConnected())
+        {
+            const auto ready = connection.waitUntilReady(true, 250);
+
+            if (ready < 0)
+                return;
+
+            if (ready == 0)
+                continue;
+
+            char buffer[1024];
+            const auto numRead = connection.read(buffer, (int) sizeof(buffer), false);
+
+            if (numRead <= 0)
+                return;
+
+            pending.append(buffer, (size_t) numRead);
+
+            for (;;)
+            {
+                const auto* data = static_cast<const char*>(pending.getData());
+                const auto* end = data + pending.getSize();
+                const auto* newline = std::find(data, end, '\n');
+
+                if (newline == end)
+                {
+                    if (pending.getSize() > (size_t) maxLineLength)
+                        return;
+
+                    break;
+                }
+
+                const auto line = juce::String::fromUTF8(data, (int) (newline - data)).trim();
+                pending.removeSection(0, (size_t) (newline - data) + 1);
+
+                if (line.isEmpty())
+                    continue;
+
+                if (! isAuthenticated)
+                {
+                    if (! line.startsWith("auth ") || ! isToken(line.fromFirstOccurrenceOf(" ", false, false).trim()))
+                    {
+                        juce::Logger::writeToLog("Control connection closed: it didn't start with the token");
+                        return;
+                    }
+
+                    isAuthenticated = true;
+
+                    if (! writeLine(connection, "ok"))
+                        return;
+
+                    continue;
+                }
+
+                const auto reply = runOnMessageThread(line);
+
+                if (! reply.has_value())
+                {
+                    writeLine(connection, "error unknown command " + line.upToFirstOccurrenceOf(" ", false, false).quoted()
+                                            + "; closing the connection");
+                    return;
+                }
+
+                if (! writeLine(connection, *reply))
+                    return;
+            }
+        }
+    }
+
+    static bool writeLine(juce::StreamingSocket& connection, const juce::String& text)
+    {
+        const auto line = text.replaceCharacters("\r\n", "  ") + "\n";
+        return connection.write(line.toRawUTF8(), (int) line.getNumBytesAsUTF8()) >= 0;
+    }
+
+    std::optional<juce::String> runOnMessageThread(const juce::String& line)
+    {
+        // shared, so that a command still running after a timeout has somewhere to put its reply
+        struct Call
+        {
+            juce::WaitableEvent done;
+            std::optional<juce::String> reply;
+        };
+
+        auto call = std::make_shared<Call>();
+
+        // the server, and whatever its handler calls into, may be gone by the time this runs after a timeout;
+        // both are destroyed on the message thread, so the weak reference is enough to tell
+        juce::MessageManager::callAsync([call, line, weak = juce::WeakReference<ControlServer>(this)]
+        {
+            if (auto* server = weak.get())
+                call->reply = server->handler != nullptr ? server->handler(line) : std::optional<juce::String>("error no handler");
+
+            call->done.signal();
+        });
+
+        for (int waitedMs = 0; waitedMs < commandTimeoutMs && ! threadShouldExit(); waitedMs += 100)
+            if (call->done.wait(100))
+                return call->reply;
+
+        return juce::String("error timed out");
+    }
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(ControlServer)
+};
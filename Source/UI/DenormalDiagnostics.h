@@ -0,0 +1,135 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "../Plugins/PluginGraph.h"
+
+// Measures every hosted plugin twice: once with denormals flushed to zero (the engine's normal policy)
+// and once with IEEE denormals allowed, counting subnormal samples in each plugin's output.
+// The report shows which plugins produce subnormals and what flush-to-zero saves them in CPU time.
+class DenormalDiagnostics : private juce::Timer
+{
+public:
+    explicit DenormalDiagnostics(PluginGraph& g) : graph(g) {}
+
+    ~DenormalDiagnostics() override
+    {
+        stopTimer();
+        setModeForAllNodes(HostedPluginInstance::DiagnosticMode::off);
+    }
+
+    bool isRunning() const { return isTimerRunning(); }
+
+    void start()
+    {
+        if (isRunning())
+            return;
+
+        results.clear();
+        for (auto* node : graph.graph.getNodes())
+            if (dynamic_cast<HostedPluginInstance*>(node->getProcessor()) != nullptr)
+                results.push_back({ node->nodeID, node->getProcessor()->getName() });
+
+        if (results.empty())
+        {
+            showReport("There are no plugins in the current preset to measure.");
+            return;
+        }
+
+        phase = HostedPluginInstance::DiagnosticMode::flushToZero;
+        setModeForAllNodes(phase);
+        startTimer(measureTimeMs);
+    }
+
+private:
+    static constexpr int measureTimeMs = 4000;
+
+    struct NodeResult
+    {
+        AudioProcessorGraph::NodeID nodeID;
+        juce::String name;
+        HostedPluginInstance::DiagnosticStats flushed, ieee;
+    };
+
+    PluginGraph& graph;
+    std::vector<NodeResult> results;
+    HostedPluginInstance::DiagnosticMode phase = HostedPluginInstance::DiagnosticMode::off;
+    juce::ScopedMessageBox messageBox;
+
+    HostedPluginInstance* getHosted(AudioProcessorGraph::NodeID nodeID) const
+    {
+        if (auto* node = graph.graph.getNodeForId(nodeID))
+            return dynamic_cast<HostedPluginInstance*>(node->getProcessor());
+        return nullptr;
+    }
+
+    void setModeForAllNodes(HostedPluginInstance::DiagnosticMode mode)
+    {
+        for (auto& r : results)
+            if (auto* hosted = getHosted(r.nodeID))
+                hosted->setDiagnosticMode(mode);
+    }
+
+    void timerCallback() override
+    {
+        // collect what was measured in this phase
+        for (auto& r : results)
+            if (auto* hosted = getHosted(r.nodeID))
+                (phase == HostedPluginInstance::DiagnosticMode::flushToZero ? r.flushed : r.ieee) = hosted->getDiagnosticStats();
+
+        if (phase == HostedPluginInstance::DiagnosticMode::flushToZero)
+        {
+            phase = HostedPluginInstance::DiagnosticMode::ieee;
+            setModeForAllNodes(phase);
+            return;
+        }
+
+        stopTimer();
+        phase = HostedPluginInstance::DiagnosticMode::off;
+        setModeForAllNodes(phase);
+        showReport(createReport());
+    }
+
+    juce::String createReport() const
+    {
+        juce::String report;
+
+        for (auto& r : results)
+        {
+            if (r.ieee.numBlocks == 0)
+            {
+                report << r.name << ": not processed during the measurement\n";
+                continue;
+            }
+
+            auto percent = r.ieee.numSamplesChecked > 0 ? 100.0 * (double) r.ieee.numSubnormals / (double) r.ieee.numSamplesChecked : 0.0;
+
+            report << r.name << ": "
+                   << (r.ieee.numSubnormals > 0 ? juce::String(r.ieee.numSubnormals) + " subnormal samples (" + juce::String(percent, 2) + "%)"
+                                                : juce::String("no subnormals"))
+                   << ", " << juce::String(r.flushed.getMicrosecondsPerBlock(), 1) << " us/block flushed vs "
+                   << juce::String(r.ieee.getMicrosecondsPerBlock(), 1) << " us/block IEEE\n";
+        }
+
+        return report;
+    }
+
+    void showReport(const juce::String& text)
+    {
+        juce::Logger::writeToLog("Denormal diagnostics:\n" + text);
+
+        auto options = juce::MessageBoxOptions::makeOptionsOk(juce::MessageBoxIconType::InfoIcon, "Denormal Diagnostics", text);
+        messageBox = juce::AlertWindow::showScopedAsync(options, nullptr);
+    }
+};
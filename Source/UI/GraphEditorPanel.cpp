@@ -48,6 +48,7 @@
 #include "GraphEditorPanel.h"
 #include "../Plugins/InternalPlugins.h"
 #include "MainHostWindow.h"
+#include "PluginSearchIndex.h"
 
 //==============================================================================
 #if JUCE_IOS
@@ -299,22 +300,30 @@ struct GraphEditorPanel::PluginComponent final : public Component,
     void paint (Graphics& g) override
     {
         auto boxArea = getLocalBounds().reduced (4, pinSize);
-        bool isBypassed = false;
+        bool isBypassed = false, isWatchdogTripped = false;
 
         if (auto* f = graph.graph.getNodeForId (pluginID))
+        {
             isBypassed = f->isBypassed();
 
+            if (auto* hosted = dynamic_cast<HostedPluginInstance*> (f->getProcessor()))
+                isWatchdogTripped = hosted->isWatchdogTripped();
+        }
+
         auto boxColour = findColour (TextEditor::backgroundColourId);
 
         if (isBypassed)
             boxColour = boxColour.brighter();
 
+        if (isWatchdogTripped)
+            boxColour = boxColour.interpolatedWith (Colours::red, 0.4f);
+
         g.setColour (boxColour);
         g.fillRect (boxArea.toFloat());
 
         g.setColour (findColour (TextEditor::textColourId));
         g.setFont (font);
-        g.drawFittedText (getName(), boxArea, Justification::centred, 2);
+        g.drawFittedText (isWatchdogTripped ? getName() + "\n(bypassed by watchdog)" : getName(), boxArea, Justification::centred, 3);
     }
 
     void resized() override
@@ -457,6 +466,30 @@ struct GraphEditorPanel::PluginComponent final : public Component,
 
         menu->addSeparator();
         menu->addItem ("Configure Audio I/O", [this] { showWindow (PluginWindow::Type::audioIO); });
+
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (getProcessor()))
+        {
+            addBlockSizeSubMenu (*hosted, *menu);
+            addPrecisionSubMenu (*hosted, *menu);
+
+            if (hosted->isWatchdogTripped())
+                menu->addItem ("Re-arm Watchdog", [this] { rearmWatchdog(); });
+
+            menu->addItem ("Allow Denormals (IEEE)", true, hosted->areDenormalsAllowed(),
+                           [this, allowed = hosted->areDenormalsAllowed()] { graph.setNodeDenormalsAllowed (pluginID, ! allowed); });
+
+            menu->addItem ("Prepare on Another Thread", true, hosted->isConcurrentPrepareAllowed(),
+                           [this, allowed = hosted->isConcurrentPrepareAllowed()] { graph.setNodeConcurrentPrepareAllowed (pluginID, ! allowed); });
+
+            if (auto* node = graph.graph.getNodeForId (pluginID))
+            {
+                const auto isSandboxed = static_cast<bool> (node->properties ["sandboxed"]);
+
+                menu->addItem ("Run in Separate Process", true, isSandboxed,
+                               [this, isSandboxed] { graph.setNodeSandboxed (pluginID, ! isSandboxed); });
+            }
+        }
+
         menu->addItem ("Test state save/load", [this] { testStateSaveLoad(); });
 
        #if ! JUCE_IOS && ! JUCE_ANDROID
@@ -468,6 +501,54 @@ struct GraphEditorPanel::PluginComponent final : public Component,
         menu->showMenuAsync ({});
     }
 
+    void addBlockSizeSubMenu (const HostedPluginInstance& hosted, PopupMenu& m)
+    {
+        const auto fixed = hosted.getFixedBlockSize();
+        const auto max = hosted.getMaxBlockSize();
+
+        PopupMenu blockSizeMenu;
+        blockSizeMenu.addItem ("Off", true, fixed == 0 && max == 0, [this] { graph.setNodeBlockSizeOptions (pluginID, 0, 0); });
+        blockSizeMenu.addSeparator();
+
+        for (auto size : { 256, 512, 1024 })
+            blockSizeMenu.addItem ("Fixed " + String (size) + " samples (adds latency)", true, fixed == size,
+                                   [this, size] { graph.setNodeBlockSizeOptions (pluginID, size, 0); });
+
+        blockSizeMenu.addSeparator();
+
+        for (auto size : { 256, 512, 1024, 2048 })
+            blockSizeMenu.addItem ("At most " + String (size) + " samples", true, fixed == 0 && max == size,
+                                   [this, size] { graph.setNodeBlockSizeOptions (pluginID, 0, size); });
+
+        m.addSubMenu ("Block Size", blockSizeMenu);
+    }
+
+    void addPrecisionSubMenu (const HostedPluginInstance& hosted, PopupMenu& m)
+    {
+        using Preference = HostedPluginInstance::PrecisionPreference;
+
+        const auto current = hosted.getPrecisionPreference();
+        const auto canUseDouble = hosted.getInner().supportsDoublePrecisionProcessing();
+
+        PopupMenu precisionMenu;
+        precisionMenu.addItem ("Automatic", true, current == Preference::automatic,
+                               [this] { graph.setNodePrecisionPreference (pluginID, Preference::automatic); });
+        precisionMenu.addItem ("32-bit Float", true, current == Preference::singlePrecision,
+                               [this] { graph.setNodePrecisionPreference (pluginID, Preference::singlePrecision); });
+        precisionMenu.addItem ("64-bit Double", canUseDouble, current == Preference::doublePrecision,
+                               [this] { graph.setNodePrecisionPreference (pluginID, Preference::doublePrecision); });
+
+        m.addSubMenu ("Processing Precision", precisionMenu);
+    }
+
+    void rearmWatchdog()
+    {
+        if (auto* hosted = dynamic_cast<HostedPluginInstance*> (getProcessor()))
+            hosted->rearmWatchdog();
+
+        repaint();
+    }
+
     void testStateSaveLoad()
     {
         if (auto* processor = getProcessor())
@@ -769,6 +850,186 @@ struct GraphEditorPanel::ConnectorComponent final : public Component,
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConnectorComponent)
 };
 
+//==============================================================================
+struct GraphEditorPanel::SearchPalette final : public Component,
+                                               private ListBoxModel,
+                                               private Timer
+{
+    SearchPalette (GraphEditorPanel& p, const PluginSearchIndex& i, Point<int> pos)
+        : panel (p), index (i), position (pos)
+    {
+        searchBox.setTextToShowWhenEmpty ("Search plug-ins...", Colours::grey);
+        searchBox.onTextChange = [this] { updateResults(); };
+        searchBox.onReturnKey  = [this] { choose (resultsList.getSelectedRow()); };
+        searchBox.onEscapeKey  = [this] { panel.hideSearchPalette(); };
+        searchBox.onFocusLost  = [this] { closeIfFocusHasLeft(); };
+        searchBox.onArrowKey   = [this] (int delta)
+        {
+            if (! results.empty())
+                resultsList.selectRow (jlimit (0, (int) results.size() - 1, resultsList.getSelectedRow() + delta));
+        };
+        addAndMakeVisible (searchBox);
+
+        resultsList.setModel (this);
+        resultsList.setRowHeight (rowHeight);
+        addAndMakeVisible (resultsList);
+
+        setSize (360, searchBoxHeight + rowHeight * numVisibleRows);
+    }
+
+    ~SearchPalette() override
+    {
+        // a plugin that was prepared but not chosen would only be taking up memory
+        panel.graph.cancelPreparedPlugin();
+    }
+
+    void grabFocus()
+    {
+        searchBox.grabKeyboardFocus();
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId).brighter (0.1f));
+        g.setColour (Colours::grey);
+        g.drawRect (getLocalBounds());
+    }
+
+    void resized() override
+    {
+        auto r = getLocalBounds().reduced (1);
+        searchBox.setBounds (r.removeFromTop (searchBoxHeight));
+        resultsList.setBounds (r);
+    }
+
+    bool keyPressed (const KeyPress& key) override
+    {
+        if (key == KeyPress::escapeKey)
+        {
+            panel.hideSearchPalette();
+            return true;
+        }
+
+        return false;
+    }
+
+    //==============================================================================
+    int getNumRows() override
+    {
+        return (int) results.size();
+    }
+
+    void paintListBoxItem (int row, Graphics& g, int width, int height, bool isSelected) override
+    {
+        if (! isPositiveAndBelow (row, (int) results.size()))
+            return;
+
+        if (isSelected)
+            g.fillAll (getLookAndFeel().findColour (TextEditor::highlightColourId));
+
+        const auto& type = index.getType (results[(size_t) row].index);
+        auto r = Rectangle<int> (width, height).reduced (6, 2);
+
+        g.setColour (getLookAndFeel().findColour (Label::textColourId));
+        g.setFont (FontOptions ((float) height * 0.45f, Font::bold));
+        g.drawFittedText (type.name, r.removeFromTop (height / 2), Justification::centredLeft, 1);
+
+        StringArray details { type.manufacturerName, type.category, type.pluginFormatName };
+        details.removeEmptyStrings();
+
+        g.setColour (Colours::grey);
+        g.setFont (FontOptions ((float) height * 0.35f));
+        g.drawFittedText (details.joinIntoString (" - "), r, Justification::centredLeft, 1);
+    }
+
+    void selectedRowsChanged (int) override
+    {
+        // only worth starting on a plugin the selection has settled on
+        startTimer (prepareDelayMs);
+    }
+
+    void listBoxItemClicked (int row, const MouseEvent&) override
+    {
+        choose (row);
+    }
+
+    void returnKeyPressed (int row) override
+    {
+        choose (row);
+    }
+
+private:
+    struct SearchBox final : public TextEditor
+    {
+        std::function<void (int)> onArrowKey;
+
+        bool keyPressed (const KeyPress& key) override
+        {
+            if (onArrowKey != nullptr && (key == KeyPress::upKey || key == KeyPress::downKey))
+            {
+                onArrowKey (key == KeyPress::upKey ? -1 : 1);
+                return true;
+            }
+
+            return TextEditor::keyPressed (key);
+        }
+    };
+
+    static constexpr int searchBoxHeight = 28;
+    static constexpr int rowHeight = 36;
+    static constexpr int numVisibleRows = 8;
+    static constexpr int maxResults = 50;
+    static constexpr int prepareDelayMs = 250;
+
+    GraphEditorPanel& panel;
+    const PluginSearchIndex& index;
+    Point<int> position;
+
+    SearchBox searchBox;
+    ListBox resultsList;
+    std::vector<PluginSearchIndex::Match> results;
+
+    void updateResults()
+    {
+        results = index.search (searchBox.getText(), maxResults);
+        resultsList.updateContent();
+        resultsList.selectRow (0);
+        resultsList.repaint();
+    }
+
+    void timerCallback() override
+    {
+        stopTimer();
+
+        const auto row = resultsList.getSelectedRow();
+
+        if (isPositiveAndBelow (row, (int) results.size()))
+            panel.graph.preparePlugin (index.getType (results[(size_t) row].index));
+    }
+
+    void choose (int row)
+    {
+        if (! isPositiveAndBelow (row, (int) results.size()))
+            return;
+
+        panel.createNewPlugin (PluginDescriptionAndPreference { index.getType (results[(size_t) row].index),
+                                                                PluginDescriptionAndPreference::UseARA::no },
+                               position);
+        panel.hideSearchPalette();
+    }
+
+    void closeIfFocusHasLeft()
+    {
+        // clicking the results list moves the focus without leaving the palette
+        MessageManager::callAsync ([safeThis = SafePointer<SearchPalette> (this)]
+        {
+            if (safeThis != nullptr && ! safeThis->hasKeyboardFocus (true))
+                safeThis->panel.hideSearchPalette();
+        });
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SearchPalette)
+};
 
 //==============================================================================
 GraphEditorPanel::GraphEditorPanel (PluginGraph& g)  : graph (g)
@@ -779,6 +1040,7 @@ GraphEditorPanel::GraphEditorPanel (PluginGraph& g)  : graph (g)
 
 GraphEditorPanel::~GraphEditorPanel()
 {
+    searchPalette = nullptr;
     graph.removeChangeListener (this);
     draggingConnector = nullptr;
     nodes.clear();
@@ -822,6 +1084,35 @@ void GraphEditorPanel::createNewPlugin (const PluginDescriptionAndPreference& de
     graph.addPlugin (desc, position.toDouble() / Point<double> ((double) getWidth(), (double) getHeight()));
 }
 
+void GraphEditorPanel::showSearchPalette (Point<int> position)
+{
+    if (auto* mainWindow = findParentComponentOfClass<MainHostWindow>())
+    {
+        searchPalette.reset (new SearchPalette (*this, mainWindow->getPluginSearchIndex(), position));
+        addAndMakeVisible (searchPalette.get());
+
+        searchPalette->setBounds (searchPalette->getBounds().withPosition (position)
+                                                            .constrainedWithin (getLocalBounds()));
+        searchPalette->grabFocus();
+    }
+}
+
+void GraphEditorPanel::hideSearchPalette()
+{
+    if (searchPalette == nullptr)
+        return;
+
+    // this gets called from the palette's own callbacks, so it can't be deleted straight away
+    searchPalette->setVisible (false);
+
+    MessageManager::callAsync ([safeThis = SafePointer<GraphEditorPanel> (this),
+                                palette = SafePointer<Component> (searchPalette.get())]
+    {
+        if (safeThis != nullptr && palette != nullptr && safeThis->searchPalette.get() == palette.getComponent())
+            safeThis->searchPalette = nullptr;
+    });
+}
+
 GraphEditorPanel::PluginComponent* GraphEditorPanel::getComponentForPlugin (AudioProcessorGraph::NodeID nodeID) const
 {
     for (auto* fc : nodes)
@@ -860,13 +1151,36 @@ void GraphEditorPanel::resized()
     updateComponents();
 }
 
+void GraphEditorPanel::visibilityChanged()
+{
+    updateIfStale();
+}
+
+void GraphEditorPanel::parentHierarchyChanged()
+{
+    updateIfStale();
+}
+
 void GraphEditorPanel::changeListenerCallback (ChangeBroadcaster*)
 {
-    updateComponents();
+    // the window usually starts hidden, so there's no point building components for a graph
+    // nobody can see; the change is caught up with once the panel is showing again
+    if (isShowing())
+        updateComponents();
+    else
+        isStale = true;
+}
+
+void GraphEditorPanel::updateIfStale()
+{
+    if (isStale && isShowing())
+        updateComponents();
 }
 
 void GraphEditorPanel::updateComponents()
 {
+    isStale = false;
+
     for (int i = nodes.size(); --i >= 0;)
         if (graph.graph.getNodeForId (nodes.getUnchecked (i)->pluginID) == nullptr)
             nodes.remove (i);
@@ -906,19 +1220,19 @@ void GraphEditorPanel::updateComponents()
 
 void GraphEditorPanel::showPopupMenu (Point<int> mousePos)
 {
-    menu.reset (new PopupMenu);
-
     if (auto* mainWindow = findParentComponentOfClass<MainHostWindow>())
     {
-        mainWindow->addPluginsToMenu (*menu);
+        auto& pluginMenu = mainWindow->getPluginMenu();
 
-        menu->showMenuAsync ({},
-                             ModalCallbackFunction::create ([this, mousePos] (int r)
-                                                            {
-                                                                if (auto* mainWin = findParentComponentOfClass<MainHostWindow>())
-                                                                    if (const auto chosen = mainWin->getChosenType (r))
-                                                                        createNewPlugin (*chosen, mousePos);
-                                                            }));
+        pluginMenu.showMenuAsync ({},
+                                  ModalCallbackFunction::create ([this, mousePos] (int r)
+                                                                 {
+                                                                     if (r == MainHostWindow::searchPluginsMenuID)
+                                                                         showSearchPalette (mousePos);
+                                                                     else if (auto* mainWin = findParentComponentOfClass<MainHostWindow>())
+                                                                         if (const auto chosen = mainWin->getChosenType (r))
+                                                                             createNewPlugin (*chosen, mousePos);
+                                                                 }));
     }
 }
 
@@ -1228,8 +1542,7 @@ GraphDocumentComponent::GraphDocumentComponent (AudioPluginFormatManager& fm,
                                                 KnownPluginList& kpl)
     : graph (new PluginGraph (fm, kpl)),
       deviceManager (dm),
-      pluginList (kpl),
-      graphPlayer (getAppProperties().getUserSettings()->getBoolValue ("doublePrecisionProcessing", false))
+      pluginList (kpl)
 {
     init();
 
@@ -1245,7 +1558,18 @@ void GraphDocumentComponent::init()
 
     graphPanel.reset (new GraphEditorPanel (*graph));
     addAndMakeVisible (graphPanel.get());
-    graphPlayer.setProcessor (&graph->graph);
+
+    renderEngine.reset (new GraphRenderEngine (graph->graph));
+    renderEngine->setProcessingRate (graph->getProcessingRate());
+    renderEngine->setMaxGraphBlockSize (graph->getMaxGraphBlockSize());
+    renderEngine->onGraphAboutToBePrepared = [this] (double rate, int blockSize, AudioProcessor::ProcessingPrecision precision)
+    {
+        graph->prepareNodesAhead (rate, blockSize, precision);
+    };
+    renderEngine->onGraphPrepared = [this] { graph->finishPreparingNodesAhead(); };
+    graph->addChangeListener (this);
+    graphPlayer.setDoublePrecisionProcessing (graph->shouldUseDoublePrecision());
+    graphPlayer.setProcessor (renderEngine.get());
 
     keyState.addListener (&graphPlayer.getMidiMessageCollector());
 
@@ -1328,16 +1652,25 @@ void GraphDocumentComponent::releaseGraph()
     statusBar = nullptr;
 
     graphPlayer.setProcessor (nullptr);
+    renderEngine = nullptr;
+
+    if (graph != nullptr)
+        graph->removeChangeListener (this);
+
     graph = nullptr;
 }
 
 void GraphDocumentComponent::setPlaybackActive(bool isActive)
 {
     if(isActive) {
-        graphPlayer.setProcessor(&graph->graph);
+        graphPlayer.setProcessor(renderEngine.get());
     }
     else {
         graphPlayer.setProcessor(nullptr);
+
+        // detaching alone leaves the graph prepared for a quick restart; a preset load wants it released
+        if (renderEngine != nullptr)
+            renderEngine->releaseGraph();
     }
 }
 
@@ -1396,19 +1729,40 @@ void GraphDocumentComponent::checkAvailableWidth()
     }
 }
 
-void GraphDocumentComponent::setDoublePrecision (bool doublePrecision)
+bool GraphDocumentComponent::closeAnyOpenPluginWindows()
 {
-    graphPlayer.setDoublePrecisionProcessing (doublePrecision);
+    return graphPanel->graph.closeAnyOpenPluginWindows();
 }
 
-bool GraphDocumentComponent::closeAnyOpenPluginWindows()
+void GraphDocumentComponent::changeListenerCallback (ChangeBroadcaster* source)
 {
-    return graphPanel->graph.closeAnyOpenPluginWindows();
+    if (graph != nullptr && source == graph.get())
+        updateRenderEngineSettings();
+    else
+        updateMidiOutput();
 }
 
-void GraphDocumentComponent::changeListenerCallback (ChangeBroadcaster*)
+void GraphDocumentComponent::updateRenderEngineSettings()
 {
-    updateMidiOutput();
+    if (renderEngine == nullptr)
+        return;
+
+    // the player re-prepares the engine itself if the precision changes
+    graphPlayer.setDoublePrecisionProcessing (graph->shouldUseDoublePrecision());
+
+    if ((approximatelyEqual (renderEngine->getProcessingRate(), graph->getProcessingRate())
+            && renderEngine->getMaxGraphBlockSize() == graph->getMaxGraphBlockSize()))
+        return;
+
+    renderEngine->setProcessingRate (graph->getProcessingRate());
+    renderEngine->setMaxGraphBlockSize (graph->getMaxGraphBlockSize());
+
+    // re-attaching the engine makes the player prepare it again with the new settings
+    if (graphPlayer.getCurrentProcessor() != nullptr)
+    {
+        graphPlayer.setProcessor (nullptr);
+        graphPlayer.setProcessor (renderEngine.get());
+    }
 }
 
 void GraphDocumentComponent::updateMidiOutput()
@@ -47,6 +47,7 @@
 #pragma once
 
 #include "../Plugins/PluginGraph.h"
+#include "../Plugins/GraphRenderEngine.h"
 
 class MainHostWindow;
 
@@ -67,6 +68,8 @@ public:
 
     void paint (Graphics&) override;
     void resized() override;
+    void visibilityChanged() override;
+    void parentHierarchyChanged() override;
 
     void mouseDown (const MouseEvent&) override;
     void mouseUp   (const MouseEvent&) override;
@@ -77,9 +80,16 @@ public:
     //==============================================================================
     void updateComponents();
 
+    /** Catches up with any graph changes that arrived while the panel couldn't be seen. */
+    void updateIfStale();
+
     //==============================================================================
     void showPopupMenu (Point<int> position);
 
+    /** Shows a type-ahead search for plugins to add at the given position. */
+    void showSearchPalette (Point<int> position);
+    void hideSearchPalette();
+
     //==============================================================================
     void beginConnectorDrag (AudioProcessorGraph::NodeAndChannel source,
                              AudioProcessorGraph::NodeAndChannel dest,
@@ -98,7 +108,9 @@ private:
     OwnedArray<PluginComponent> nodes;
     OwnedArray<ConnectorComponent> connectors;
     std::unique_ptr<ConnectorComponent> draggingConnector;
-    std::unique_ptr<PopupMenu> menu;
+
+    struct SearchPalette;
+    std::unique_ptr<SearchPalette> searchPalette;
 
     PluginComponent* getComponentForPlugin (AudioProcessorGraph::NodeID) const;
     ConnectorComponent* getComponentForConnection (const AudioProcessorGraph::Connection&) const;
@@ -106,6 +118,7 @@ private:
 
     //==============================================================================
     Point<int> originalTouchPos;
+    bool isStale = false;
 
     void timerCallback() override;
 
@@ -133,7 +146,6 @@ public:
 
     //==============================================================================
     void createNewPlugin (const PluginDescriptionAndPreference&, Point<int> position);
-    void setDoublePrecision (bool doublePrecision);
     bool closeAnyOpenPluginWindows();
 
     //==============================================================================
@@ -157,11 +169,14 @@ public:
 
     void setPlaybackActive(bool isActive);
 
+    GraphRenderEngine* getRenderEngine() const noexcept     { return renderEngine.get(); }
+
 private:
     //==============================================================================
     AudioDeviceManager& deviceManager;
     KnownPluginList& pluginList;
 
+    std::unique_ptr<GraphRenderEngine> renderEngine;
     AudioProcessorPlayer graphPlayer;
     MidiKeyboardState keyState;
     MidiOutput* midiOutput = nullptr;
@@ -188,6 +203,7 @@ private:
     void init();
     void checkAvailableWidth();
     void updateMidiOutput();
+    void updateRenderEngineSettings();
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphDocumentComponent)
@@ -0,0 +1,208 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MainHostWindow.h"
+#include "AudioResilienceManager.h"
+#include "ControlServer.h"
+#include "../Plugins/DualClockAudioIODevice.h"
+#include "../Plugins/NullAudioIODevice.h"
+#include "../Plugins/GraphRenderEngine.h"
+#include "../Plugins/InternalPlugins.h"
+#include "../Plugins/PluginDatabase.h"
+
+// Runs a preset on the saved device with no window, tray icon, editor or menus, for machines with no
+// display (curve --headless [preset] [--control-port=N]).
+// It owns the same pieces the editor would: the plugin formats and list, the device manager, the graph
+// with its render engine and player, and the resilience manager. Nothing is created that needs a display;
+// plugin windows a preset saved as open stay closed. It's controlled through a ControlServer on the
+// loopback interface, whose token is in ControlToken next to the settings file:
+//   status          the preset, device, rate, block size, CPU load and xrun count
+//   load <file>     loads a preset
+//   reload          loads the current preset again
+//   quit            shuts down
+class HeadlessHost : private juce::ChangeListener
+{
+public:
+    static constexpr int defaultControlPort = 17600;
+
+    explicit HeadlessHost(int controlPort = defaultControlPort)
+    {
+        juce::addDefaultFormatsToManager(formatManager);
+        formatManager.addFormat(std::make_unique<InternalPluginFormat>());
+
+        DualClockAudioIODeviceType::addTo(deviceManager);
+        NullAudioIODeviceType::addTo(deviceManager, NullAudioIODeviceType::Options::fromXml(getAppProperties().getUserSettings()
+                                                                                              ->getXmlValue("nullAudioDevice").get()));
+
+        // the saved device or nothing; with no one to pick another, a default device would only surprise
+        auto savedState = getAppProperties().getUserSettings()->getXmlValue("audioDeviceState");
+
+        if (savedState != nullptr && savedState->getStringAttribute("audioInputDeviceName") != ""
+                                  && savedState->getStringAttribute("audioOutputDeviceName") != "")
+            deviceManager.initialise(256, 256, savedState.get(), false);
+
+        pluginDatabase = std::make_unique<PluginDatabase>(getAppProperties().getUserSettings()->getFile().getSiblingFile("PluginDatabase.bin"));
+
+        if (pluginDatabase->open())
+            pluginDatabase->addTypesTo(knownPluginList);
+
+        InternalPluginFormat internalFormat;
+
+        for (auto& t : internalFormat.getAllTypes())
+            knownPluginList.addType(t);
+
+        graph = std::make_unique<PluginGraph>(formatManager, knownPluginList);
+        graph->setPluginWindowsEnabled(false);
+        graph->setPluginDatabase(pluginDatabase.get());
+        graph->addChangeListener(this);
+
+        renderEngine = std::make_unique<GraphRenderEngine>(graph->graph);
+        renderEngine->onGraphAboutToBePrepared = [this](double rate, int blockSize, juce::AudioProcessor::ProcessingPrecision precision)
+        {
+            graph->prepareNodesAhead(rate, blockSize, precision);
+        };
+        renderEngine->onGraphPrepared = [this] { graph->finishPreparingNodesAhead(); };
+
+        updateRenderEngineSettings();
+        player.setProcessor(renderEngine.get());
+
+        deviceManager.addAudioCallback(&player);
+        deviceManager.addMidiInputDeviceCallback({}, &player.getMidiMessageCollector());
+
+        resilienceManager = std::make_unique<AudioResilienceManager>(deviceManager, nullptr, [this]
+        {
+            juce::Array<AudioResilienceManager::DeviceChoice> choices;
+
+            for (auto& d : graph->getFailoverDevices())
+                choices.add({ d.typeName, d.inputDeviceName, d.outputDeviceName });
+
+            return choices;
+        });
+
+        juce::Process::setPriority(juce::Process::HighPriority);
+
+        controlServer = std::make_unique<ControlServer>(controlPort,
+                                                        getAppProperties().getUserSettings()->getFile().getSiblingFile("ControlToken"),
+                                                        [this](const juce::String& line) { return handleCommand(line); });
+    }
+
+    ~HeadlessHost() override
+    {
+        controlServer = nullptr;
+        resilienceManager = nullptr;
+
+        deviceManager.removeAudioCallback(&player);
+        deviceManager.removeMidiInputDeviceCallback({}, &player.getMidiMessageCollector());
+        player.setProcessor(nullptr);
+
+        renderEngine = nullptr;
+        graph->removeChangeListener(this);
+        graph = nullptr;
+
+        deviceManager.closeAudioDevice();
+    }
+
+    // the graph is released while it loads, as it is in the editor
+    juce::Result loadPreset(const juce::File& file)
+    {
+        player.setProcessor(nullptr);
+        renderEngine->releaseGraph();
+
+        auto result = graph->loadFrom(file, false, false);
+
+        updateRenderEngineSettings();
+        player.setProcessor(renderEngine.get());
+
+        juce::Logger::writeToLog(result.wasOk() ? "Loaded " + file.getFullPathName()
+                                                : "Couldn't load " + file.getFullPathName() + ": " + result.getErrorMessage());
+        return result;
+    }
+
+private:
+    juce::AudioPluginFormatManager formatManager;
+    juce::KnownPluginList knownPluginList;
+    juce::AudioDeviceManager deviceManager;
+    std::unique_ptr<PluginDatabase> pluginDatabase;
+    std::unique_ptr<PluginGraph> graph;
+    std::unique_ptr<GraphRenderEngine> renderEngine;
+    juce::AudioProcessorPlayer player;
+    std::unique_ptr<AudioResilienceManager> resilienceManager;
+    std::unique_ptr<ControlServer> controlServer;
+
+    void changeListenerCallback(juce::ChangeBroadcaster*) override
+    {
+        updateRenderEngineSettings();
+    }
+
+    void updateRenderEngineSettings()
+    {
+        player.setDoublePrecisionProcessing(graph->shouldUseDoublePrecision());
+
+        if (juce::approximatelyEqual(renderEngine->getProcessingRate(), graph->getProcessingRate())
+              && renderEngine->getMaxGraphBlockSize() == graph->getMaxGraphBlockSize())
+            return;
+
+        renderEngine->setProcessingRate(graph->getProcessingRate());
+        renderEngine->setMaxGraphBlockSize(graph->getMaxGraphBlockSize());
+
+        // re-attaching the engine makes the player prepare it again with the new settings
+        if (player.getCurrentProcessor() != nullptr)
+        {
+            player.setProcessor(nullptr);
+            player.setProcessor(renderEngine.get());
+        }
+    }
+
+    std::optional<juce::String> handleCommand(const juce::String& line)
+    {
+        const auto command = line.upToFirstOccurrenceOf(" ", false, false).toLowerCase();
+        const auto argument = line.fromFirstOccurrenceOf(" ", false, false).trim().unquoted();
+
+        if (command == "status")
+        {
+            auto* device = deviceManager.getCurrentAudioDevice();
+            juce::String reply("ok");
+            reply << " preset=" << graph->getFile().getFullPathName().quoted()
+                  << " device=" << (device != nullptr ? device->getName() : juce::String()).quoted()
+                  << " playing=" << (device != nullptr && device->isPlaying() ? "yes" : "no")
+                  << " rate=" << (device != nullptr ? device->getCurrentSampleRate() : 0.0)
+                  << " block=" << (device != nullptr ? device->getCurrentBufferSizeSamples() : 0)
+                  << " cpu=" << juce::String(100.0 * deviceManager.getCpuUsage(), 1)
+                  << " xruns=" << deviceManager.getXRunCount();
+            return reply;
+        }
+
+        if (command == "load" || command == "reload")
+        {
+            const auto file = command == "reload" ? graph->getFile()
+                                                  : juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+
+            if (! file.existsAsFile())
+                return "error no such file " + file.getFullPathName().quoted();
+
+            const auto result = loadPreset(file);
+            return result.wasOk() ? juce::String("ok") : "error " + result.getErrorMessage();
+        }
+
+        if (command == "quit")
+        {
+            juce::JUCEApplication::getInstance()->systemRequestedQuit();
+            return "ok";
+        }
+
+        // the server closes the connection, in case this isn't a control client at all
+        return std::nullopt;
+    }
+};
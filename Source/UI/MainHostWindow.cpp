@@ -46,10 +46,54 @@
 
 #include <JuceHeader.h>
 #include "MainHostWindow.h"
+#include "BufferSizeCalibrator.h"
+#include "DenormalDiagnostics.h"
+#include "PluginWatchdog.h"
+#include "PluginScanCache.h"
+#include "PluginScanQuarantine.h"
+#include "AudioResilienceManager.h"
+#include "../Plugins/DualClockAudioIODevice.h"
+#include "../Plugins/NullAudioIODevice.h"
+#include "PluginFolderWatcher.h"
+#include "StartupProfiler.h"
+#include "PluginSearchIndex.h"
 #include "../Plugins/InternalPlugins.h"
+#include "../Plugins/PluginDatabase.h"
 
 constexpr const char* scanModeKey = "pluginScanMode";
 
+// processing rates offered in the Options menu; zero means "follow the device"
+static constexpr double processingRates[] = { 0.0, 44100.0, 48000.0, 88200.0, 96000.0 };
+static constexpr int processingRateMenuIDBase = 300;
+
+static constexpr int maxGraphBlockSizes[] = { 0, 128, 256, 512, 1024, 2048 };
+static constexpr int maxGraphBlockSizeMenuIDBase = 320;
+
+static constexpr int calibrateBufferSizeMenuID = 340;
+static constexpr int calibrateOnReconnectMenuID = 341;
+static constexpr int denormalDiagnosticsMenuID = 342;
+
+// watchdog budgets as a share of the buffer period, and cool-downs before re-arming; zero turns each off
+static constexpr double watchdogBudgetShares[] = { 0.0, 0.5, 0.75, 1.0 };
+static constexpr int watchdogBudgetMenuIDBase = 350;
+static constexpr int watchdogCooldowns[] = { 0, 10, 30, 120 };
+static constexpr int watchdogCooldownMenuIDBase = 360;
+static constexpr int watchdogRearmAllMenuID = 370;
+
+static constexpr int watchPluginFoldersMenuID = 380;
+
+// how long one plugin file may take to scan before it's killed and quarantined, and when quarantined ones are retried
+static constexpr int scanTimeLimits[] = { 10, 30, 60, 120 };
+static constexpr int scanTimeLimitMenuIDBase = 390;
+static constexpr int quarantineRetryMenuIDBase = 395;
+
+// the preset's device failover list; clicking a listed device removes it
+static constexpr int failoverAddCurrentMenuID = 400;
+static constexpr int failoverClearMenuID = 401;
+static constexpr int failoverStandbyMenuID = 402;
+static constexpr int failoverRemoveMenuIDBase = 410;
+static constexpr int maxFailoverDevices = 16;
+
 //==============================================================================
 class Superprocess final : private ChildProcessCoordinator
 {
@@ -119,7 +163,9 @@ class CustomPluginScanner final : public KnownPluginList::CustomScanner,
                                   private ChangeListener
 {
 public:
-    CustomPluginScanner()
+    explicit CustomPluginScanner (PluginScanQuarantine& q)
+        : quarantine (q),
+          scanCache (getAppProperties().getUserSettings()->getFile().getSiblingFile ("PluginScanCache.xml"))
     {
         if (auto* file = getAppProperties().getUserSettings())
             file->addChangeListener (this);
@@ -133,61 +179,95 @@ public:
             file->removeChangeListener (this);
     }
 
+    // Called concurrently from each of the plugin list's scanning threads
     bool findPluginTypesFor (AudioPluginFormat& format,
                              OwnedArray<PluginDescription>& result,
                              const String& fileOrIdentifier) override
     {
+        // unchanged files get the descriptions from their last scan, without loading the binary
+        const auto identity = scanCache.identify (fileOrIdentifier);
+
+        if (identity.has_value() && scanCache.lookup (format.getName(), fileOrIdentifier, *identity, result))
+            return true;
+
+        const auto scanStartMs = Time::getMillisecondCounterHiRes();
+        auto outcome = Outcome::succeeded;
+
         if (scanInProcess)
         {
-            superprocess = nullptr;
+            clearIdleWorkers();
             format.findAllTypesForFile (result, fileOrIdentifier);
-            return true;
+        }
+        else
+        {
+            outcome = addPluginDescriptions (format.getName(), fileOrIdentifier, result);
         }
 
-        if (addPluginDescriptions (format.getName(), fileOrIdentifier, result))
+        if (shouldExit())
             return true;
 
-        superprocess = nullptr;
-        return false;
+        quarantine.record (format.getName(), fileOrIdentifier, outcome, (Time::getMillisecondCounterHiRes() - scanStartMs) / 1000.0);
+
+        // returning false puts the file on the blacklist, and the quarantine decides when it comes off again
+        if (outcome != Outcome::succeeded)
+            return false;
+
+        if (identity.has_value())
+            scanCache.store (format.getName(), fileOrIdentifier, *identity, result);
+
+        return true;
     }
 
     void scanFinished() override
     {
-        superprocess = nullptr;
+        clearIdleWorkers();
+        scanCache.saveIfNeeded();
+        quarantine.saveIfNeeded();
     }
 
 private:
-    /*  Scans for a plugin with format 'formatName' and ID 'fileOrIdentifier' using a subprocess,
-        and adds discovered plugin descriptions to 'result'.
+    using Outcome = PluginScanQuarantine::Outcome;
+
+    /*  Scans for a plugin with format 'formatName' and ID 'fileOrIdentifier' using a subprocess
+        from the pool, and adds discovered plugin descriptions to 'result'.
 
-        Returns true on success.
+        Returns how the scan ended.
 
-        Failure indicates that the subprocess is unrecoverable and should be terminated.
+        If the plugin crashed or hung its subprocess, that subprocess is killed rather than
+        returned to the pool, and the next scan launches a fresh one.
     */
-    bool addPluginDescriptions (const String& formatName,
-                                const String& fileOrIdentifier,
-                                OwnedArray<PluginDescription>& result)
+    Outcome addPluginDescriptions (const String& formatName,
+                                   const String& fileOrIdentifier,
+                                   OwnedArray<PluginDescription>& result)
     {
-        if (superprocess == nullptr)
-            superprocess = std::make_unique<Superprocess>();
+        auto worker = acquireWorker();
 
         MemoryBlock block;
         MemoryOutputStream stream { block, true };
         stream.writeString (formatName);
         stream.writeString (fileOrIdentifier);
 
-        if (! superprocess->sendMessageToWorker (block))
-            return false;
+        if (! worker->sendMessageToWorker (block))
+            return Outcome::crashed;
+
+        const auto deadline = Time::getMillisecondCounter() + (uint32) scanTimeoutSeconds.load() * 1000;
 
         for (;;)
         {
+            // the worker is still busy with this file, so it can't go back in the pool
             if (shouldExit())
-                return true;
+                return Outcome::succeeded;
 
-            const auto response = superprocess->getResponse();
+            const auto response = worker->getResponse();
 
             if (response.state == Superprocess::State::timeout)
-                continue;
+            {
+                if (Time::getMillisecondCounter() < deadline)
+                    continue;
+
+                Logger::writeToLog ("Timed out scanning " + fileOrIdentifier);
+                return Outcome::timedOut;
+            }
 
             if (response.xml != nullptr)
             {
@@ -200,14 +280,54 @@ private:
                 }
             }
 
-            return (response.state == Superprocess::State::gotResult);
+            if (response.state != Superprocess::State::gotResult)
+                return Outcome::crashed;
+
+            releaseWorker (std::move (worker));
+            return Outcome::succeeded;
+        }
+    }
+
+    std::unique_ptr<Superprocess> acquireWorker()
+    {
+        {
+            const std::lock_guard<std::mutex> lock { poolMutex };
+
+            if (! idleWorkers.empty())
+            {
+                auto worker = std::move (idleWorkers.back());
+                idleWorkers.pop_back();
+                return worker;
+            }
+        }
+
+        return std::make_unique<Superprocess>();
+    }
+
+    void releaseWorker (std::unique_ptr<Superprocess> worker)
+    {
+        const std::lock_guard<std::mutex> lock { poolMutex };
+        idleWorkers.push_back (std::move (worker));
+    }
+
+    void clearIdleWorkers()
+    {
+        std::vector<std::unique_ptr<Superprocess>> workers;
+
+        {
+            const std::lock_guard<std::mutex> lock { poolMutex };
+            workers.swap (idleWorkers);
         }
     }
 
     void handleChange()
     {
         if (auto* file = getAppProperties().getUserSettings())
-            scanInProcess = (file->getIntValue (scanModeKey) == 0);
+        {
+            scanInProcess = (file->getIntValue (scanModeKey, 1) == 0);
+            scanTimeoutSeconds = jmax (1, file->getIntValue ("pluginScanTimeoutSeconds", 60));
+            scanCache.setUsesContentHash (file->getBoolValue ("pluginScanCacheUsesContentHash", false));
+        }
     }
 
     void changeListenerCallback (ChangeBroadcaster*) override
@@ -215,9 +335,15 @@ private:
         handleChange();
     }
 
-    std::unique_ptr<Superprocess> superprocess;
+    // workers that finished their last file cleanly and can take another; busy ones are owned by their scanning thread
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<Superprocess>> idleWorkers;
 
     std::atomic<bool> scanInProcess { true };
+    std::atomic<int> scanTimeoutSeconds { 60 };
+
+    PluginScanQuarantine& quarantine;
+    PluginScanCache scanCache;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CustomPluginScanner)
 };
@@ -237,6 +363,9 @@ public:
         // always use out-of-process plugin scanning
         getAppProperties().getUserSettings()->setValue (scanModeKey, 1); // hard codes to out-of-process
 
+        // each scanning thread gets its own scanner process, so one slow or crashing plugin doesn't hold up the rest
+        setNumberOfThreadsForScanning (SystemStats::getNumCpus());
+
         handleResize();
     }
 
@@ -267,6 +396,12 @@ public:
         auto deadMansPedalFile = getAppProperties().getUserSettings()
                                    ->getFile().getSiblingFile ("RecentlyCrashedPluginsList");
 
+        // anything a crashed in-process scan left behind goes into quarantine, and anything whose
+        // quarantine is up comes off the blacklist so the next scan picks it up
+        owner.scanQuarantine->takeInDeadMansPedal (deadMansPedalFile);
+        owner.scanQuarantine->releaseDue (owner.knownPluginList);
+        owner.scanQuarantine->saveIfNeeded();
+
         setContentOwned (new CustomPluginListComponent (pluginFormatManager,
                                                         owner.knownPluginList,
                                                         deadMansPedalFile,
@@ -289,6 +424,8 @@ public:
 
     void closeButtonPressed() override
     {
+        // the search paths may have been edited
+        owner.updatePluginFolderWatcher();
         owner.pluginListWindow = nullptr;
     }
 
@@ -299,7 +436,7 @@ private:
 };
 
 //==============================================================================
-MainHostWindow::MainHostWindow()
+MainHostWindow::MainHostWindow (bool deferNonAudioStartup)
     : DocumentWindow (JUCEApplication::getInstance()->getApplicationName(),
                       LookAndFeel::getDefaultLookAndFeel().findColour (ResizableWindow::backgroundColourId),
                       DocumentWindow::allButtons)
@@ -307,6 +444,12 @@ MainHostWindow::MainHostWindow()
     addDefaultFormatsToManager (formatManager);
     formatManager.addFormat (std::make_unique<InternalPluginFormat>());
 
+    getStartupProfiler().mark ("plugin formats");
+
+    DualClockAudioIODeviceType::addTo (deviceManager);
+    NullAudioIODeviceType::addTo (deviceManager, NullAudioIODeviceType::Options::fromXml (getAppProperties().getUserSettings()
+                                                                                            ->getXmlValue ("nullAudioDevice").get()));
+
     auto safeThis = SafePointer<MainHostWindow> (this);
     RuntimePermissions::request (RuntimePermissions::recordAudio,
                                  [safeThis] (bool granted) mutable
@@ -323,6 +466,8 @@ MainHostWindow::MainHostWindow()
                                         juce::AudioDeviceManager::AudioDeviceSetup setup;
                                         safeThis->deviceManager.setAudioDeviceSetup(setup, false);
                                     }
+
+                                    getStartupProfiler().mark ("audio device");
                                  });
 
    #if JUCE_IOS || JUCE_ANDROID
@@ -333,13 +478,18 @@ MainHostWindow::MainHostWindow()
     centreWithSize (800, 600);
    #endif
 
-    knownPluginList.setCustomScanner (std::make_unique<CustomPluginScanner>());
+    scanQuarantine.reset (new PluginScanQuarantine (getAppProperties().getUserSettings()->getFile().getSiblingFile ("PluginScanQuarantine.xml")));
+    auto customScanner = std::make_unique<CustomPluginScanner> (*scanQuarantine);
+    auto* pluginScanner = customScanner.get();
+    knownPluginList.setCustomScanner (std::move (customScanner));
 
     graphHolder.reset (new GraphDocumentComponent (formatManager, deviceManager, knownPluginList));
+    getStartupProfiler().mark ("graph document");
 
-    // always use double-precision processing
-    if (graphHolder != nullptr)
-        graphHolder->setDoublePrecision (true);
+    bufferSizeCalibrator.reset (new BufferSizeCalibrator (deviceManager, *graphHolder));
+
+    pluginWatchdog.reset (new PluginWatchdog (*graphHolder->graph));
+    pluginWatchdog->addChangeListener (this);
 
     setContentNonOwned (graphHolder.get(), false);
 
@@ -347,28 +497,75 @@ MainHostWindow::MainHostWindow()
 
     restoreWindowStateFromString (getAppProperties().getUserSettings()->getValue ("mainWindowPos"));
 
-    setVisible (true);
-
     InternalPluginFormat internalFormat;
     internalTypes = internalFormat.getAllTypes();
 
-    if (auto savedPluginList = getAppProperties().getUserSettings()->getXmlValue ("pluginList"))
-        knownPluginList.recreateFromXml (*savedPluginList);
+    // only the indexes for now, so a saved graph can still find plugins that have moved;
+    // building the list itself can wait
+    pluginDatabase.reset (new PluginDatabase (getAppProperties().getUserSettings()->getFile().getSiblingFile ("PluginDatabase.bin")));
+    pluginDatabaseOpened = pluginDatabase->open();
+
+    if (auto* g = graphHolder->graph.get())
+        g->setPluginDatabase (pluginDatabase.get());
+
+    getStartupProfiler().mark ("plugin database");
+
+    if (auto* g = graphHolder->graph.get())
+        g->addChangeListener (this);
+
+    addKeyListener (getCommandManager().getKeyMappings());
+
+    Process::setPriority (Process::HighPriority);
+
+    getCommandManager().setFirstCommandTarget (this);
+
+    if (! deferNonAudioStartup)
+    {
+        finishStartup();
+        setVisible (true);
+    }
+}
+
+void MainHostWindow::finishStartup()
+{
+    if (startupFinished)
+        return;
+
+    startupFinished = true;
+
+    if (pluginDatabaseOpened)
+    {
+        pluginDatabase->addTypesTo (knownPluginList);
+    }
+    else
+    {
+        // older versions kept the list as XML in the settings file
+        if (auto savedPluginList = getAppProperties().getUserSettings()->getXmlValue ("pluginList"))
+            knownPluginList.recreateFromXml (*savedPluginList);
+    }
 
     for (auto& t : internalTypes)
         knownPluginList.addType (t);
 
+    pluginDatabase->sync (knownPluginList);
+    getAppProperties().getUserSettings()->removeValue ("pluginList");
+
     pluginSortMethod = (KnownPluginList::SortMethod) getAppProperties().getUserSettings()
                             ->getIntValue ("pluginSortMethod", KnownPluginList::sortByManufacturer);
 
     knownPluginList.addChangeListener (this);
 
-    if (auto* g = graphHolder->graph.get())
-        g->addChangeListener (this);
+    getStartupProfiler().mark ("plugin list");
 
-    addKeyListener (getCommandManager().getKeyMappings());
-
-    Process::setPriority (Process::HighPriority);
+    // the list owns the scanner and outlives the watcher
+    pluginFolderWatcher.reset (new PluginFolderWatcher (knownPluginList, formatManager, *scanQuarantine,
+                                                        [pluginScanner] (AudioPluginFormat& format,
+                                                                         OwnedArray<PluginDescription>& found,
+                                                                         const String& fileOrIdentifier)
+                                                        {
+                                                            return pluginScanner->findPluginTypesFor (format, found, fileOrIdentifier);
+                                                        }));
+    updatePluginFolderWatcher();
 
   #if JUCE_IOS || JUCE_ANDROID
     graphHolder->burgerMenu.setModel (this);
@@ -380,12 +577,17 @@ MainHostWindow::MainHostWindow()
    #endif
   #endif
 
-    getCommandManager().setFirstCommandTarget (this);
+    getStartupProfiler().mark ("menus and folder watcher");
 }
 
 MainHostWindow::~MainHostWindow()
 {
     pluginListWindow = nullptr;
+    pluginFolderWatcher = nullptr;
+    bufferSizeCalibrator = nullptr;
+    denormalDiagnostics = nullptr;
+    pluginWatchdog->removeChangeListener (this);
+    pluginWatchdog = nullptr;
     knownPluginList.removeChangeListener (this);
 
     if (auto* g = graphHolder->graph.get())
@@ -411,6 +613,30 @@ void MainHostWindow::closeButtonPressed()
     setVisible(false);
 }
 
+void MainHostWindow::visibilityChanged()
+{
+    DocumentWindow::visibilityChanged();
+
+    if (! isVisible())
+        return;
+
+    // shown before the deferred part of startup got its turn
+    finishStartup();
+
+    // the graph panel ignores changes while it's hidden
+    if (graphHolder != nullptr && graphHolder->graphPanel != nullptr)
+        graphHolder->graphPanel->updateIfStale();
+}
+
+void MainHostWindow::minimisationStateChanged (bool isNowMinimised)
+{
+    DocumentWindow::minimisationStateChanged (isNowMinimised);
+
+    // un-minimising doesn't change any component's visibility, so the panel wouldn't hear about it
+    if (! isNowMinimised && graphHolder != nullptr && graphHolder->graphPanel != nullptr)
+        graphHolder->graphPanel->updateIfStale();
+}
+
 struct AsyncQuitRetrier final : private Timer
 {
     AsyncQuitRetrier()   { startTimer (500); }
@@ -473,15 +699,15 @@ void MainHostWindow::changeListenerCallback (ChangeBroadcaster* changed)
 {
     if (changed == &knownPluginList)
     {
+        pluginMenuNeedsRebuilding = true;
+        pluginSearchIndexNeedsRebuilding = true;
+        startTimer (pluginMenuRebuildDelayMs);
         menuItemsChanged();
 
         // save the plugin list every time it gets changed, so that if we're scanning
         // and it crashes, we've still saved the previous ones
-        if (auto savedPluginList = std::unique_ptr<XmlElement> (knownPluginList.createXml()))
-        {
-            getAppProperties().getUserSettings()->setValue ("pluginList", savedPluginList.get());
-            getAppProperties().saveIfNeeded();
-        }
+        if (pluginDatabase != nullptr)
+            pluginDatabase->sync (knownPluginList);
     }
     else if (graphHolder != nullptr && changed == graphHolder->graph.get())
     {
@@ -493,6 +719,14 @@ void MainHostWindow::changeListenerCallback (ChangeBroadcaster* changed)
 
         setName (title);
     }
+    else if (changed == pluginWatchdog.get())
+    {
+        // bypassed nodes are drawn differently
+        if (graphHolder != nullptr && graphHolder->graphPanel != nullptr)
+            graphHolder->graphPanel->repaint();
+
+        menuItemsChanged();
+    }
 }
 
 StringArray MainHostWindow::getMenuBarNames()
@@ -535,10 +769,8 @@ PopupMenu MainHostWindow::getMenuForIndex (int topLevelMenuIndex, const String&
     }
     else if (topLevelMenuIndex == 1)
     {
-        // "Plugins" menu
-        PopupMenu pluginsMenu;
-        addPluginsToMenu (pluginsMenu);
-        menu.addSubMenu ("Create Plug-in", pluginsMenu);
+        // "Plugins" menu; the menu bar takes its menus by value, so this is the one copy of the cached menu
+        menu.addSubMenu ("Create Plug-in", getPluginMenu());
         menu.addSeparator();
         menu.addItem (250, "Delete All Plug-ins");
     }
@@ -558,7 +790,137 @@ PopupMenu MainHostWindow::getMenuForIndex (int topLevelMenuIndex, const String&
 
         menu.addSeparator();
         menu.addCommandItem (&getCommandManager(), CommandIDs::showAudioSettings);
-        menu.addCommandItem (&getCommandManager(), CommandIDs::toggleDoublePrecision);
+
+        if (graphHolder != nullptr && graphHolder->graph != nullptr)
+        {
+            const auto currentRate = graphHolder->graph->getProcessingRate();
+
+            PopupMenu rateMenu;
+
+            for (int i = 0; i < (int) std::size (processingRates); ++i)
+            {
+                const auto rate = processingRates[i];
+                rateMenu.addItem (processingRateMenuIDBase + i,
+                                  rate > 0.0 ? String (rate / 1000.0, 1) + " kHz" : String ("Follow Device"),
+                                  true,
+                                  approximatelyEqual (currentRate, rate));
+            }
+
+            menu.addSubMenu ("Processing Rate", rateMenu);
+
+            const auto currentMaxBlockSize = graphHolder->graph->getMaxGraphBlockSize();
+
+            PopupMenu blockSizeMenu;
+
+            for (int i = 0; i < (int) std::size (maxGraphBlockSizes); ++i)
+            {
+                const auto size = maxGraphBlockSizes[i];
+                blockSizeMenu.addItem (maxGraphBlockSizeMenuIDBase + i,
+                                       size > 0 ? String (size) + " samples" : String ("No Limit"),
+                                       true,
+                                       currentMaxBlockSize == size);
+            }
+
+            menu.addSubMenu ("Maximum Graph Block Size", blockSizeMenu);
+
+            PopupMenu calibrationMenu;
+            calibrationMenu.addItem (calibrateBufferSizeMenuID, "Calibrate Now for This Preset",
+                                     bufferSizeCalibrator != nullptr && ! bufferSizeCalibrator->isRunning());
+            calibrationMenu.addItem (calibrateOnReconnectMenuID, "Recalibrate at Startup and After Device Reconnect",
+                                     true, isCalibrateOnReconnectEnabled());
+
+            menu.addSubMenu ("Buffer Size Calibration", calibrationMenu);
+
+            PopupMenu failoverMenu;
+            const auto& failoverDevices = graphHolder->graph->getFailoverDevices();
+            const auto currentDevice = getCurrentFailoverDevice();
+
+            if (! failoverDevices.isEmpty())
+                failoverMenu.addSectionHeader ("If the Audio Settings Device Goes Away, Use");
+
+            for (int i = 0; i < jmin (maxFailoverDevices, failoverDevices.size()); ++i)
+            {
+                const auto& d = failoverDevices.getReference (i);
+                auto name = d.outputDeviceName;
+
+                if (d.inputDeviceName.isNotEmpty() && d.inputDeviceName != d.outputDeviceName)
+                    name << " / " << d.inputDeviceName;
+
+                failoverMenu.addItem (failoverRemoveMenuIDBase + i,
+                                      String (i + 1) + ". " + name + " (" + d.typeName + ")",
+                                      true, currentDevice.has_value() && *currentDevice == d);
+            }
+
+            if (! failoverDevices.isEmpty())
+                failoverMenu.addSectionHeader ("Click a Device to Remove It");
+
+            failoverMenu.addSeparator();
+            failoverMenu.addItem (failoverAddCurrentMenuID, "Add Current Device",
+                                  currentDevice.has_value() && ! failoverDevices.contains (*currentDevice)
+                                    && failoverDevices.size() < maxFailoverDevices);
+            failoverMenu.addItem (failoverClearMenuID, "Clear List", ! failoverDevices.isEmpty());
+            failoverMenu.addSeparator();
+            failoverMenu.addItem (failoverStandbyMenuID, "Keep the Next Device Open as a Standby",
+                                  true, AudioResilienceManager::isStandbyEnabled());
+
+            menu.addSubMenu ("Device Failover", failoverMenu);
+
+            menu.addItem (denormalDiagnosticsMenuID, "Run Denormal Diagnostics",
+                          denormalDiagnostics == nullptr || ! denormalDiagnostics->isRunning());
+
+            PopupMenu watchdogMenu;
+            const auto currentBudget = PluginWatchdog::getBudgetShare();
+            const auto currentCooldown = PluginWatchdog::getCooldownSeconds();
+
+            for (int i = 0; i < (int) std::size (watchdogBudgetShares); ++i)
+            {
+                const auto share = watchdogBudgetShares[i];
+                watchdogMenu.addItem (watchdogBudgetMenuIDBase + i,
+                                      share > 0.0 ? "Bypass Plugins Taking Over " + String (roundToInt (share * 100.0)) + "% of the Buffer Period"
+                                                  : String ("Off"),
+                                      true,
+                                      approximatelyEqual (currentBudget, share));
+            }
+
+            watchdogMenu.addSeparator();
+
+            for (int i = 0; i < (int) std::size (watchdogCooldowns); ++i)
+            {
+                const auto seconds = watchdogCooldowns[i];
+                watchdogMenu.addItem (watchdogCooldownMenuIDBase + i,
+                                      seconds > 0 ? "Re-arm After " + String (seconds) + " Seconds" : String ("Re-arm Manually"),
+                                      currentBudget > 0.0,
+                                      currentCooldown == seconds);
+            }
+
+            watchdogMenu.addSeparator();
+            watchdogMenu.addItem (watchdogRearmAllMenuID, "Re-arm All Bypassed Plugins",
+                                  pluginWatchdog != nullptr && ! pluginWatchdog->getTrippedNodes().empty());
+
+            menu.addSubMenu ("Plugin Watchdog", watchdogMenu);
+
+            menu.addItem (watchPluginFoldersMenuID, "Watch Plugin Folders for Changes", true, PluginFolderWatcher::isEnabled());
+
+            PopupMenu scanLimitsMenu;
+            const auto currentLimit = getAppProperties().getUserSettings()->getIntValue ("pluginScanTimeoutSeconds", 60);
+
+            for (int i = 0; i < (int) std::size (scanTimeLimits); ++i)
+                scanLimitsMenu.addItem (scanTimeLimitMenuIDBase + i,
+                                        "Quarantine Plugins Taking Over " + String (scanTimeLimits[i]) + " Seconds to Scan",
+                                        true, currentLimit == scanTimeLimits[i]);
+
+            scanLimitsMenu.addSeparator();
+
+            const auto currentPolicy = PluginScanQuarantine::getRetryPolicy();
+            const char* policyNames[] = { "Never Retry Quarantined Plugins",
+                                          "Retry Quarantined Plugins When They're Updated",
+                                          "Retry When Updated or After a While" };
+
+            for (int i = 0; i < (int) std::size (policyNames); ++i)
+                scanLimitsMenu.addItem (quarantineRetryMenuIDBase + i, policyNames[i], true, (int) currentPolicy == i);
+
+            menu.addSubMenu ("Plugin Scanning", scanLimitsMenu);
+        }
 
         if (autoScaleOptionAvailable)
             menu.addCommandItem (&getCommandManager(), CommandIDs::autoScalePluginWindows);
@@ -616,8 +978,103 @@ void MainHostWindow::menuItemSelected (int menuItemID, int /*topLevelMenuIndex*/
 
         getAppProperties().getUserSettings()->setValue ("pluginSortMethod", (int) pluginSortMethod);
 
+        pluginMenuNeedsRebuilding = true;
+        startTimer (pluginMenuRebuildDelayMs);
+        menuItemsChanged();
+    }
+    else if (isPositiveAndBelow (menuItemID - processingRateMenuIDBase, (int) std::size (processingRates)))
+    {
+        if (graphHolder != nullptr)
+            if (auto* graph = graphHolder->graph.get())
+                graph->setProcessingRate (processingRates[menuItemID - processingRateMenuIDBase]);
+
+        menuItemsChanged();
+    }
+    else if (menuItemID == calibrateBufferSizeMenuID)
+    {
+        calibrateBufferSize();
+    }
+    else if (menuItemID == denormalDiagnosticsMenuID)
+    {
+        runDenormalDiagnostics();
+    }
+    else if (isPositiveAndBelow (menuItemID - watchdogBudgetMenuIDBase, (int) std::size (watchdogBudgetShares)))
+    {
+        PluginWatchdog::setBudgetShare (watchdogBudgetShares[menuItemID - watchdogBudgetMenuIDBase]);
+        menuItemsChanged();
+    }
+    else if (isPositiveAndBelow (menuItemID - watchdogCooldownMenuIDBase, (int) std::size (watchdogCooldowns)))
+    {
+        PluginWatchdog::setCooldownSeconds (watchdogCooldowns[menuItemID - watchdogCooldownMenuIDBase]);
+        menuItemsChanged();
+    }
+    else if (isPositiveAndBelow (menuItemID - scanTimeLimitMenuIDBase, (int) std::size (scanTimeLimits)))
+    {
+        // the scanner picks this up through its settings listener
+        getAppProperties().getUserSettings()->setValue ("pluginScanTimeoutSeconds", scanTimeLimits[menuItemID - scanTimeLimitMenuIDBase]);
+        menuItemsChanged();
+    }
+    else if (isPositiveAndBelow (menuItemID - quarantineRetryMenuIDBase, 3))
+    {
+        PluginScanQuarantine::setRetryPolicy ((PluginScanQuarantine::RetryPolicy) (menuItemID - quarantineRetryMenuIDBase));
+        menuItemsChanged();
+    }
+    else if (menuItemID == failoverAddCurrentMenuID || menuItemID == failoverClearMenuID
+              || isPositiveAndBelow (menuItemID - failoverRemoveMenuIDBase, maxFailoverDevices))
+    {
+        if (graphHolder != nullptr)
+        {
+            if (auto* graph = graphHolder->graph.get())
+            {
+                auto devices = graph->getFailoverDevices();
+
+                if (menuItemID == failoverClearMenuID)
+                    devices.clear();
+                else if (menuItemID != failoverAddCurrentMenuID)
+                    devices.remove (menuItemID - failoverRemoveMenuIDBase);
+                else if (const auto current = getCurrentFailoverDevice())
+                    devices.addIfNotAlreadyThere (*current);
+
+                graph->setFailoverDevices (devices);
+            }
+        }
+
         menuItemsChanged();
     }
+    else if (menuItemID == failoverStandbyMenuID)
+    {
+        // the resilience manager picks this up through its settings listener
+        AudioResilienceManager::setStandbyEnabled (! AudioResilienceManager::isStandbyEnabled());
+        menuItemsChanged();
+    }
+    else if (menuItemID == watchPluginFoldersMenuID)
+    {
+        PluginFolderWatcher::setEnabled (! PluginFolderWatcher::isEnabled());
+        updatePluginFolderWatcher();
+        menuItemsChanged();
+    }
+    else if (menuItemID == watchdogRearmAllMenuID)
+    {
+        if (pluginWatchdog != nullptr)
+            pluginWatchdog->rearmAll();
+    }
+    else if (menuItemID == calibrateOnReconnectMenuID)
+    {
+        getAppProperties().getUserSettings()->setValue ("calibrateBufferSizeOnReconnect", ! isCalibrateOnReconnectEnabled());
+        menuItemsChanged();
+    }
+    else if (isPositiveAndBelow (menuItemID - maxGraphBlockSizeMenuIDBase, (int) std::size (maxGraphBlockSizes)))
+    {
+        if (graphHolder != nullptr)
+            if (auto* graph = graphHolder->graph.get())
+                graph->setMaxGraphBlockSize (maxGraphBlockSizes[menuItemID - maxGraphBlockSizeMenuIDBase]);
+
+        menuItemsChanged();
+    }
+    else if (menuItemID == searchPluginsMenuID)
+    {
+        getCommandManager().invokeDirectly (CommandIDs::searchPlugins, true);
+    }
     else
     {
         if (const auto chosen = getChosenType (menuItemID))
@@ -626,6 +1083,17 @@ void MainHostWindow::menuItemSelected (int menuItemID, int /*topLevelMenuIndex*/
     }
 }
 
+std::optional<PluginGraph::FailoverDevice> MainHostWindow::getCurrentFailoverDevice() const
+{
+    if (deviceManager.getCurrentAudioDevice() == nullptr)
+        return std::nullopt;
+
+    AudioDeviceManager::AudioDeviceSetup setup;
+    deviceManager.getAudioDeviceSetup (setup);
+
+    return PluginGraph::FailoverDevice { deviceManager.getCurrentAudioDeviceType(), setup.inputDeviceName, setup.outputDeviceName };
+}
+
 void MainHostWindow::menuBarActivated (bool isActivated)
 {
     if (isActivated && graphHolder != nullptr)
@@ -638,17 +1106,6 @@ void MainHostWindow::createPlugin (const PluginDescriptionAndPreference& desc, P
         graphHolder->createNewPlugin (desc, pos);
 }
 
-static bool containsDuplicateNames (const Array<PluginDescription>& plugins, const String& name)
-{
-    int matches = 0;
-
-    for (auto& p : plugins)
-        if (p.name == name && ++matches > 1)
-            return true;
-
-    return false;
-}
-
 static constexpr int menuIDBase = 0x324503f4;
 
 static void addToMenu (const KnownPluginList::PluginTree& tree,
@@ -671,11 +1128,17 @@ static void addToMenu (const KnownPluginList::PluginTree& tree,
         m.addItem (menuID, pluginName, true, false);
     };
 
+    // counted up front, so spotting duplicates stays linear in the size of the folder
+    HashMap<String, int> nameCounts;
+
+    for (auto& plugin : tree.plugins)
+        nameCounts.set (plugin.name, nameCounts[plugin.name] + 1);
+
     for (auto& plugin : tree.plugins)
     {
         auto name = plugin.name;
 
-        if (containsDuplicateNames (tree.plugins, name))
+        if (nameCounts[name] > 1)
             name << " (" << plugin.pluginFormatName << ')';
 
         addPlugin (PluginDescriptionAndPreference { plugin, PluginDescriptionAndPreference::UseARA::no }, name);
@@ -690,17 +1153,21 @@ static void addToMenu (const KnownPluginList::PluginTree& tree,
     }
 }
 
-void MainHostWindow::addPluginsToMenu (PopupMenu& m)
+PopupMenu& MainHostWindow::getPluginMenu()
 {
-    if (graphHolder != nullptr)
-    {
-        int i = 0;
+    rebuildPluginMenuIfNeeded();
+    return cachedPluginMenu;
+}
 
-        for (auto& t : internalTypes)
-            m.addItem (++i, t.name + " (" + t.pluginFormatName + ")");
-    }
+void MainHostWindow::rebuildPluginMenuIfNeeded()
+{
+    // the tree only depends on the list and the sort order, so it's rebuilt when either of
+    // those changes rather than every time a menu opens
+    if (! pluginMenuNeedsRebuilding)
+        return;
 
-    m.addSeparator();
+    pluginMenuNeedsRebuilding = false;
+    stopTimer();
 
     auto pluginDescriptions = knownPluginList.getTypes();
 
@@ -712,7 +1179,38 @@ void MainHostWindow::addPluginsToMenu (PopupMenu& m)
 
     auto tree = KnownPluginList::createTree (pluginDescriptions, pluginSortMethod);
     pluginDescriptionsAndPreference = {};
-    addToMenu (*tree, m, pluginDescriptions, pluginDescriptionsAndPreference);
+    cachedPluginMenu = {};
+
+    cachedPluginMenu.addItem (searchPluginsMenuID, "Search Plug-ins...");
+    cachedPluginMenu.addSeparator();
+
+    int i = 0;
+
+    for (auto& t : internalTypes)
+        cachedPluginMenu.addItem (++i, t.name + " (" + t.pluginFormatName + ")");
+
+    cachedPluginMenu.addSeparator();
+    addToMenu (*tree, cachedPluginMenu, pluginDescriptions, pluginDescriptionsAndPreference);
+}
+
+void MainHostWindow::timerCallback()
+{
+    // rebuilds the menu once the list has stopped changing, so that opening it doesn't have to
+    rebuildPluginMenuIfNeeded();
+}
+
+const PluginSearchIndex& MainHostWindow::getPluginSearchIndex()
+{
+    if (pluginSearchIndex == nullptr)
+        pluginSearchIndex.reset (new PluginSearchIndex());
+
+    if (pluginSearchIndexNeedsRebuilding)
+    {
+        pluginSearchIndexNeedsRebuilding = false;
+        pluginSearchIndex->rebuild (knownPluginList.getTypes());
+    }
+
+    return *pluginSearchIndex;
 }
 
 std::optional<PluginDescriptionAndPreference> MainHostWindow::getChosenType (const int menuID) const
@@ -748,10 +1246,10 @@ void MainHostWindow::getAllCommands (Array<CommandID>& commands)
                              #endif
                               CommandIDs::showPluginListEditor,
                               CommandIDs::showAudioSettings,
-                              CommandIDs::toggleDoublePrecision,
                               CommandIDs::aboutBox,
                               CommandIDs::allWindowsForward,
-                              CommandIDs::autoScalePluginWindows
+                              CommandIDs::autoScalePluginWindows,
+                              CommandIDs::searchPlugins
                             };
 
     commands.addArray (ids, numElementsInArray (ids));
@@ -797,10 +1295,6 @@ void MainHostWindow::getCommandInfo (const CommandID commandID, ApplicationComma
         result.addDefaultKeypress ('a', ModifierKeys::commandModifier);
         break;
 
-    case CommandIDs::toggleDoublePrecision:
-        updatePrecisionMenuItem (result);
-        break;
-
     case CommandIDs::aboutBox:
         result.setInfo ("About...", {}, category, 0);
         break;
@@ -814,6 +1308,11 @@ void MainHostWindow::getCommandInfo (const CommandID commandID, ApplicationComma
         updateAutoScaleMenuItem (result);
         break;
 
+    case CommandIDs::searchPlugins:
+        result.setInfo ("Search Plug-ins...", "Finds a plug-in by name and adds it to the graph", category, 0);
+        result.addDefaultKeypress ('f', ModifierKeys::commandModifier);
+        break;
+
     default:
         break;
     }
@@ -876,21 +1375,6 @@ bool MainHostWindow::perform (const InvocationInfo& info)
         showAudioSettings();
         break;
 
-    case CommandIDs::toggleDoublePrecision:
-        if (auto* props = getAppProperties().getUserSettings())
-        {
-            auto newIsDoublePrecision = ! isDoublePrecisionProcessingEnabled();
-            props->setValue ("doublePrecisionProcessing", var (newIsDoublePrecision));
-
-            ApplicationCommandInfo cmdInfo (info.commandID);
-            updatePrecisionMenuItem (cmdInfo);
-            menuItemsChanged();
-
-            if (graphHolder != nullptr)
-                graphHolder->setDoublePrecision (newIsDoublePrecision);
-        }
-        break;
-
     case CommandIDs::autoScalePluginWindows:
         if (auto* props = getAppProperties().getUserSettings())
         {
@@ -917,6 +1401,16 @@ bool MainHostWindow::perform (const InvocationInfo& info)
         break;
     }
 
+    case CommandIDs::searchPlugins:
+        if (graphHolder != nullptr && graphHolder->graphPanel != nullptr)
+        {
+            setVisible (true);
+
+            auto* panel = graphHolder->graphPanel.get();
+            panel->showSearchPalette ({ panel->getWidth() / 4, panel->getHeight() / 4 });
+        }
+        break;
+
     default:
         return false;
     }
@@ -1015,24 +1509,18 @@ void MainHostWindow::filesDropped (const StringArray& files, int x, int y)
     }
 }
 
-bool MainHostWindow::isDoublePrecisionProcessingEnabled()
-{
-    if (auto* props = getAppProperties().getUserSettings())
-        return props->getBoolValue ("doublePrecisionProcessing", false);
-
-    return false;
-}
-
 bool MainHostWindow::isAutoScalePluginWindowsEnabled()
 {
     // always auto-scale plugin windows
     return true;
 }
 
-void MainHostWindow::updatePrecisionMenuItem (ApplicationCommandInfo& info)
+bool MainHostWindow::isCalibrateOnReconnectEnabled()
 {
-    info.setInfo ("Double Floating-Point Precision Rendering", {}, "General", 0);
-    info.setTicked (isDoublePrecisionProcessingEnabled());
+    if (auto* props = getAppProperties().getUserSettings())
+        return props->getBoolValue ("calibrateBufferSizeOnReconnect", false);
+
+    return false;
 }
 
 void MainHostWindow::updateAutoScaleMenuItem (ApplicationCommandInfo& info)
@@ -1052,6 +1540,61 @@ void MainHostWindow::loadPreset(juce::File file)
     {
         graphHolder->setPlaybackActive(true);
     }
+
+    applyCalibratedBufferSize();
+}
+
+void MainHostWindow::calibrateBufferSize()
+{
+    if (bufferSizeCalibrator == nullptr)
+        return;
+
+    bufferSizeCalibrator->onFinished = [] (int bufferSize)
+    {
+        Logger::writeToLog (bufferSize > 0 ? "Buffer size calibrated to " + String (bufferSize) + " samples"
+                                           : String ("Buffer size calibration found no glitch-free size; keeping the previous setting"));
+    };
+
+    if (! bufferSizeCalibrator->start())
+        Logger::writeToLog ("Buffer size calibration needs a running audio device");
+
+    menuItemsChanged();
+}
+
+void MainHostWindow::applyCalibratedBufferSize()
+{
+    if (bufferSizeCalibrator != nullptr)
+        bufferSizeCalibrator->applyStoredResult();
+}
+
+void MainHostWindow::runDenormalDiagnostics()
+{
+    if (graphHolder == nullptr || graphHolder->graph == nullptr)
+        return;
+
+    if (denormalDiagnostics == nullptr)
+        denormalDiagnostics.reset (new DenormalDiagnostics (*graphHolder->graph));
+
+    denormalDiagnostics->start();
+}
+
+void MainHostWindow::updatePluginFolderWatcher()
+{
+    if (pluginFolderWatcher == nullptr)
+        return;
+
+    if (PluginFolderWatcher::isEnabled())
+        pluginFolderWatcher->start();
+    else
+        pluginFolderWatcher->stop();
+}
+
+void MainHostWindow::handleDeviceReconnected()
+{
+    if (isCalibrateOnReconnectEnabled())
+        calibrateBufferSize();
+    else
+        applyCalibratedBufferSize();
 }
 
 void MainHostWindow::saveAsPreset()
@@ -1083,4 +1626,4 @@ void MainHostWindow::showAboutBox()
         + "VST is a registered trademark of Steinberg Media Technologies GmbH.";
 
     juce::NativeMessageBox::showMessageBoxAsync (juce::AlertWindow::InfoIcon, "About " + juce::JUCEApplication::getInstance()->getApplicationName(), msg);
-}
\ No newline at end of file
+}
\ No newline at end of file
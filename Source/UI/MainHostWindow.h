@@ -63,8 +63,8 @@ namespace CommandIDs
     static const int showAudioSettings      = 0x30200;
     static const int aboutBox               = 0x30300;
     static const int allWindowsForward      = 0x30400;
-    static const int toggleDoublePrecision  = 0x30500;
     static const int autoScalePluginWindows = 0x30600;
+    static const int searchPlugins          = 0x30700;
 }
 
 //==============================================================================
@@ -72,6 +72,9 @@ ApplicationCommandManager& getCommandManager();
 ApplicationProperties& getAppProperties();
 bool isOnTouchDevice();
 
+class StartupProfiler;
+StartupProfiler& getStartupProfiler();
+
 //==============================================================================
 enum class AutoScale
 {
@@ -94,20 +97,36 @@ void addPluginAutoScaleOptionsSubMenu (AudioPluginInstance*, PopupMenu&);
 
 constexpr const char* processUID = "juceaudiopluginhost";
 
+class BufferSizeCalibrator;
+class DenormalDiagnostics;
+class PluginWatchdog;
+class PluginFolderWatcher;
+class PluginDatabase;
+class PluginSearchIndex;
+class PluginScanQuarantine;
+
 //==============================================================================
 class MainHostWindow final : public DocumentWindow,
                              public MenuBarModel,
                              public ApplicationCommandTarget,
                              public ChangeListener,
-                             public FileDragAndDropTarget
+                             public FileDragAndDropTarget,
+                             private Timer
 {
 public:
     //==============================================================================
-    MainHostWindow();
+    /** With deferNonAudioStartup set, only the device and the graph are set up, and the window stays
+        hidden; finishStartup() must then be called to build the plugin list and the menus.
+    */
+    explicit MainHostWindow (bool deferNonAudioStartup = false);
     ~MainHostWindow() override;
 
+    void finishStartup();
+
     //==============================================================================
     void closeButtonPressed() override;
+    void visibilityChanged() override;
+    void minimisationStateChanged (bool isNowMinimised) override;
     void changeListenerCallback (ChangeBroadcaster*) override;
 
     bool isInterestedInFileDrag (const StringArray& files) override;
@@ -130,8 +149,15 @@ public:
 
     void createPlugin (const PluginDescriptionAndPreference&, Point<int> pos);
 
-    void addPluginsToMenu (PopupMenu&);
+    /** The menu of every plugin that can be created, with a search entry at the top. It's cached
+        and only rebuilt after the list or its sort order changes, so show it directly rather
+        than copying it into another menu.
+    */
+    PopupMenu& getPluginMenu();
+    static constexpr int searchPluginsMenuID = 0x7ff00000;
+
     std::optional<PluginDescriptionAndPreference> getChosenType (int menuID) const;
+    const PluginSearchIndex& getPluginSearchIndex();
 
     std::unique_ptr<GraphDocumentComponent> graphHolder;
 
@@ -142,25 +168,48 @@ public:
     juce::AudioDeviceManager& getDeviceManager() { return deviceManager; }
     void showAboutBox();
 
+    void calibrateBufferSize();
+    void applyCalibratedBufferSize();
+    void handleDeviceReconnected();
+    void runDenormalDiagnostics();
+    PluginWatchdog* getPluginWatchdog() const noexcept      { return pluginWatchdog.get(); }
+    void updatePluginFolderWatcher();
+
 private:
     //==============================================================================
-    static bool isDoublePrecisionProcessingEnabled();
     static bool isAutoScalePluginWindowsEnabled();
+    static bool isCalibrateOnReconnectEnabled();
 
-    static void updatePrecisionMenuItem (ApplicationCommandInfo& info);
     static void updateAutoScaleMenuItem (ApplicationCommandInfo& info);
 
+    void rebuildPluginMenuIfNeeded();
+    void timerCallback() override;
+    std::optional<PluginGraph::FailoverDevice> getCurrentFailoverDevice() const;
+
     //==============================================================================
     AudioDeviceManager deviceManager;
     AudioPluginFormatManager formatManager;
 
     std::vector<PluginDescription> internalTypes;
+    std::unique_ptr<PluginScanQuarantine> scanQuarantine;   // outlives the list, whose scanner uses it
     KnownPluginList knownPluginList;
-    KnownPluginList::SortMethod pluginSortMethod;
+    KnownPluginList::SortMethod pluginSortMethod = KnownPluginList::sortByManufacturer;
     Array<PluginDescriptionAndPreference> pluginDescriptionsAndPreference;
+    PopupMenu cachedPluginMenu;
+    bool pluginMenuNeedsRebuilding = true;
+    static constexpr int pluginMenuRebuildDelayMs = 300;    // a scan changes the list once per plug-in
+    std::unique_ptr<PluginSearchIndex> pluginSearchIndex;
+    bool pluginSearchIndexNeedsRebuilding = true;
 
     class PluginListWindow;
     std::unique_ptr<PluginListWindow> pluginListWindow;
 
+    std::unique_ptr<BufferSizeCalibrator> bufferSizeCalibrator;
+    std::unique_ptr<DenormalDiagnostics> denormalDiagnostics;
+    std::unique_ptr<PluginWatchdog> pluginWatchdog;
+    std::unique_ptr<PluginFolderWatcher> pluginFolderWatcher;
+    std::unique_ptr<PluginDatabase> pluginDatabase;
+    bool pluginDatabaseOpened = false, startupFinished = false;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainHostWindow)
 };
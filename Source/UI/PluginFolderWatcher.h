@@ -0,0 +1,393 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include "PluginScanQuarantine.h"
+
+#if JUCE_LINUX
+ #include <sys/inotify.h>
+ #include <poll.h>
+ #include <unistd.h>
+#endif
+
+// Watches the plugin search paths and rescans only the bundles that appear, change or disappear,
+// on a background-priority thread. Scans go through the function it's given (the list's custom scanner),
+// so they run in the out-of-process scanner pool and use the scan cache. The list itself is only touched
+// on the message thread: that's where it decides what needs scanning and adds each result as it comes back.
+// Uses inotify on Linux; elsewhere it polls each search path down to the same depth.
+class PluginFolderWatcher : private juce::Thread
+{
+public:
+    // scans one file or bundle from the watcher's thread, returning false if the scan failed
+    using ScanFunction = std::function<bool(juce::AudioPluginFormat&, juce::OwnedArray<juce::PluginDescription>&, const juce::String&)>;
+
+    PluginFolderWatcher(juce::KnownPluginList& listToUpdate, juce::AudioPluginFormatManager& formats,
+                        PluginScanQuarantine& q, ScanFunction scanFunction)
+        : juce::Thread("Plugin Folder Watcher"), list(listToUpdate), formatManager(formats), quarantine(q),
+          scanFile(std::move(scanFunction)) {}
+
+    ~PluginFolderWatcher() override
+    {
+        stop();
+    }
+
+    static bool isEnabled()             { return getAppProperties().getUserSettings()->getBoolValue("watchPluginFolders", true); }
+    static void setEnabled(bool b)      { getAppProperties().getUserSettings()->setValue("watchPluginFolders", b); }
+
+    // (re)reads the search paths from the settings and starts watching them; call on the message thread
+    void start()
+    {
+        stop();
+
+        roots.clear();
+
+        for (auto* format : formatManager.getFormats())
+        {
+            if (! format->canScanForPlugins())
+                continue;
+
+            auto path = juce::PluginListComponent::getLastSearchPath(*getAppProperties().getUserSettings(), *format);
+
+            for (int i = 0; i < path.getNumPaths(); ++i)
+                if (path[i].isDirectory())
+                    roots.push_back({ path[i], format });
+        }
+
+        if (! roots.empty())
+            startThread(juce::Thread::Priority::background);
+    }
+
+    void stop()
+    {
+        stopThread(4000);
+    }
+
+private:
+    static constexpr int settleTimeMs = 2000;   // installers write many files; wait for them to finish
+    static constexpr int maxWatchDepth = 8;
+
+    struct Root
+    {
+        juce::File folder;
+        juce::AudioPluginFormat* format;
+    };
+
+    struct ScanJob
+    {
+        juce::String file;
+        juce::AudioPluginFormat* format = nullptr;
+    };
+
+    using Candidates = std::set<std::pair<juce::String, juce::AudioPluginFormat*>>;
+
+    juce::KnownPluginList& list;
+    juce::AudioPluginFormatManager& formatManager;
+    PluginScanQuarantine& quarantine;
+    const ScanFunction scanFile;
+    std::vector<Root> roots;
+
+    std::mutex scanQueueLock;
+    std::vector<ScanJob> scanQueue;
+
+    std::set<juce::String> pendingPaths;
+    juce::uint32 lastChangeMs = 0;
+
+    void noteChange(const juce::String& path)
+    {
+        pendingPaths.insert(path);
+        lastChangeMs = juce::Time::getMillisecondCounter();
+    }
+
+    void run() override
+    {
+       #if JUCE_LINUX
+        const auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if (fd < 0)
+        {
+            juce::Logger::writeToLog("Couldn't start watching plugin folders");
+            return;
+        }
+
+        std::map<int, juce::String> watches;
+
+        for (auto& root : roots)
+            addWatches(fd, watches, root.folder, 0);
+
+        alignas(inotify_event) char buffer[8192];
+
+        while (! threadShouldExit())
+        {
+            pollfd pfd { fd, POLLIN, 0 };
+
+            if (poll(&pfd, 1, 250) > 0)
+            {
+                for (;;)
+                {
+                    const auto numRead = read(fd, buffer, sizeof(buffer));
+
+                    if (numRead <= 0)
+                        break;
+
+                    for (auto* p = buffer; p < buffer + numRead;)
+                    {
+                        const auto* event = reinterpret_cast<const inotify_event*>(p);
+                        p += sizeof(inotify_event) + event->len;
+
+                        auto it = watches.find(event->wd);
+
+                        if (it == watches.end())
+                            continue;
+
+                        if (event->mask & IN_IGNORED)
+                        {
+                            watches.erase(it);
+                            continue;
+                        }
+
+                        const auto path = event->len > 0 ? juce::File(it->second).getChildFile(event->name).getFullPathName()
+                                                         : it->second;
+
+                        if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                            addWatches(fd, watches, juce::File(path), 1);
+
+                        noteChange(path);
+                    }
+                }
+            }
+
+            processPendingIfSettled();
+            scanQueued();
+        }
+
+        close(fd);
+       #else
+        auto snapshot = takeSnapshot();
+
+        while (! threadShouldExit())
+        {
+            wait(5000);
+
+            auto newSnapshot = takeSnapshot();
+
+            for (auto& [path, modified] : newSnapshot)
+                if (auto it = snapshot.find(path); it == snapshot.end() || it->second != modified)
+                    noteChange(path);
+
+            for (auto& [path, modified] : snapshot)
+                if (newSnapshot.find(path) == newSnapshot.end())
+                    noteChange(path);
+
+            snapshot.swap(newSnapshot);
+            processPendingIfSettled();
+            scanQueued();
+        }
+       #endif
+    }
+
+   #if JUCE_LINUX
+    void addWatches(int fd, std::map<int, juce::String>& watches, const juce::File& folder, int depth)
+    {
+        if (depth > maxWatchDepth || ! folder.isDirectory())
+            return;
+
+        const auto wd = inotify_add_watch(fd, folder.getFullPathName().toRawUTF8(),
+                                          IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF);
+
+        if (wd < 0)
+            return;
+
+        watches[wd] = folder.getFullPathName();
+
+        for (const auto& entry : juce::RangedDirectoryIterator(folder, false, "*", juce::File::findDirectories))
+            addWatches(fd, watches, entry.getFile(), depth + 1);
+    }
+   #else
+    std::map<juce::String, juce::int64> takeSnapshot() const
+    {
+        std::map<juce::String, juce::int64> snapshot;
+
+        for (auto& root : roots)
+            addToSnapshot(snapshot, root.folder, 0);
+
+        return snapshot;
+    }
+
+    // goes as deep as the inotify watches do, so that a binary replaced inside a bundle is seen too
+    static void addToSnapshot(std::map<juce::String, juce::int64>& snapshot, const juce::File& folder, int depth)
+    {
+        for (const auto& entry : juce::RangedDirectoryIterator(folder, false, "*", juce::File::findFilesAndDirectories))
+        {
+            snapshot[entry.getFile().getFullPathName()] = entry.getModificationTime().toMilliseconds();
+
+            if (entry.isDirectory() && depth < maxWatchDepth)
+                addToSnapshot(snapshot, entry.getFile(), depth + 1);
+        }
+    }
+   #endif
+
+    void processPendingIfSettled()
+    {
+        if (pendingPaths.empty() || juce::Time::getMillisecondCounter() - lastChangeMs < (juce::uint32) settleTimeMs)
+            return;
+
+        // map each changed path to the plugin file or bundle that contains it
+        Candidates candidates;
+        std::set<juce::String> removedPaths;
+
+        for (auto& path : pendingPaths)
+        {
+            if (! juce::File(path).exists())
+                removedPaths.insert(path);
+
+            for (auto& root : roots)
+                if (auto candidate = findCandidate(juce::File(path), root); candidate.isNotEmpty())
+                    candidates.insert({ candidate, root.format });
+        }
+
+        pendingPaths.clear();
+
+        juce::MessageManager::callAsync([weak = juce::WeakReference<PluginFolderWatcher>(this), candidates, removedPaths]
+        {
+            if (auto* watcher = weak.get())
+                watcher->applyChanges(candidates, removedPaths);
+        });
+    }
+
+    // called on the message thread; queues whatever needs scanning for the watcher's thread
+    void applyChanges(const Candidates& candidates, const std::set<juce::String>& removedPaths)
+    {
+        // anything that lived at or inside a path that has gone
+        for (auto& type : list.getTypes())
+        {
+            for (auto& removed : removedPaths)
+            {
+                if (type.fileOrIdentifier == removed || type.fileOrIdentifier.startsWith(removed + juce::File::getSeparatorString()))
+                {
+                    list.removeType(type);
+                    juce::Logger::writeToLog("Plugin folder watcher removed " + type.fileOrIdentifier);
+                    break;
+                }
+            }
+        }
+
+        std::vector<ScanJob> jobs;
+
+        for (auto& [candidate, format] : candidates)
+        {
+            // a quarantined bundle that has just been updated deserves another try
+            quarantine.releaseDue(list, candidate);
+
+            if (needsScan(candidate, *format))
+                jobs.push_back({ candidate, format });
+        }
+
+        if (jobs.empty())
+            return;
+
+        {
+            const std::lock_guard<std::mutex> lock(scanQueueLock);
+            scanQueue.insert(scanQueue.end(), jobs.begin(), jobs.end());
+        }
+
+        notify();
+    }
+
+    // the same test KnownPluginList::scanAndAddFile makes: new bundles and ones whose modification time
+    // has changed get scanned, and blacklisted ones wait until the quarantine releases them
+    bool needsScan(const juce::String& file, juce::AudioPluginFormat& format) const
+    {
+        if (list.getBlacklistedFiles().contains(file))
+            return false;
+
+        bool isListed = false;
+
+        for (auto& type : list.getTypes())
+        {
+            if (type.fileOrIdentifier != file || type.pluginFormatName != format.getName())
+                continue;
+
+            if (format.pluginNeedsRescanning(type))
+                return true;
+
+            isListed = true;
+        }
+
+        return ! isListed;
+    }
+
+    void scanQueued()
+    {
+        while (! threadShouldExit())
+        {
+            ScanJob job;
+            bool isLast;
+
+            {
+                const std::lock_guard<std::mutex> lock(scanQueueLock);
+
+                if (scanQueue.empty())
+                    return;
+
+                job = scanQueue.front();
+                scanQueue.erase(scanQueue.begin());
+                isLast = scanQueue.empty();
+            }
+
+            juce::OwnedArray<juce::PluginDescription> found;
+            const auto succeeded = scanFile(*job.format, found, job.file);
+
+            juce::Array<juce::PluginDescription> types;
+
+            for (auto* type : found)
+                types.add(*type);
+
+            juce::MessageManager::callAsync([weak = juce::WeakReference<PluginFolderWatcher>(this), job, succeeded, types, isLast]
+            {
+                if (auto* watcher = weak.get())
+                    watcher->applyScan(job, succeeded, types, isLast);
+            });
+        }
+    }
+
+    // called on the message thread with each scan's result, so the list updates as each one finishes
+    void applyScan(const ScanJob& job, bool succeeded, const juce::Array<juce::PluginDescription>& types, bool isLast)
+    {
+        if (! succeeded)
+            list.addToBlacklist(job.file);
+
+        for (auto& type : types)
+            list.addType(type);
+
+        if (isLast)
+            list.scanFinished();
+    }
+
+    static juce::String findCandidate(juce::File f, const Root& root)
+    {
+        if (! f.isAChildOf(root.folder))
+            return {};
+
+        for (; f != root.folder; f = f.getParentDirectory())
+            if (root.format->fileMightContainThisPluginType(f.getFullPathName()))
+                return f.getFullPathName();
+
+        return {};
+    }
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginFolderWatcher)
+};
@@ -0,0 +1,209 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <mutex>
+#include <optional>
+
+// Remembers what findAllTypesForFile returned for each plugin file or bundle, keyed by format and path,
+// and valid only while the file's size and modification time (and optionally a content hash) are unchanged.
+// Lets a rescan skip loading every binary that hasn't changed since it was last scanned.
+// Safe to use from several scanning threads at once.
+class PluginScanCache
+{
+public:
+    explicit PluginScanCache(juce::File cacheFileToUse) : cacheFile(std::move(cacheFileToUse))
+    {
+        load();
+    }
+
+    struct FileIdentity
+    {
+        juce::int64 size = 0;
+        juce::int64 modificationTime = 0;
+        juce::String hash;
+
+        bool operator==(const FileIdentity& other) const
+        {
+            return size == other.size && modificationTime == other.modificationTime && hash == other.hash;
+        }
+    };
+
+    // hashing catches changes that keep the same size and mtime, at the cost of reading every binary
+    void setUsesContentHash(bool shouldHash) { usesContentHash = shouldHash; }
+
+    // returns nullopt for identifiers that aren't files on disk (e.g. AudioUnit IDs), which are never cached
+    std::optional<FileIdentity> identify(const juce::String& fileOrIdentifier) const
+    {
+        return identify(fileOrIdentifier, usesContentHash);
+    }
+
+    static std::optional<FileIdentity> identify(const juce::String& fileOrIdentifier, bool withContentHash)
+    {
+        if (! juce::File::isAbsolutePath(fileOrIdentifier))
+            return std::nullopt;
+
+        juce::File f(fileOrIdentifier);
+
+        if (! f.exists())
+            return std::nullopt;
+
+        FileIdentity identity;
+        juce::MemoryOutputStream hashInput;
+
+        auto addFile = [&](const juce::File& file)
+        {
+            identity.size += file.getSize();
+            identity.modificationTime = juce::jmax(identity.modificationTime, file.getLastModificationTime().toMilliseconds());
+
+            if (withContentHash)
+                hashInput << juce::MD5(file).toHexString();
+        };
+
+        // bundles are directories, and updating one usually only touches the files inside it
+        if (f.isDirectory())
+        {
+            for (const auto& entry : juce::RangedDirectoryIterator(f, true, "*", juce::File::findFiles))
+                addFile(entry.getFile());
+        }
+        else
+        {
+            addFile(f);
+        }
+
+        if (withContentHash)
+            identity.hash = juce::MD5(hashInput.getMemoryBlock()).toHexString();
+
+        return identity;
+    }
+
+    bool lookup(const juce::String& formatName, const juce::String& fileOrIdentifier, const FileIdentity& identity,
+                juce::OwnedArray<juce::PluginDescription>& result) const
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = entries.find(getKey(formatName, fileOrIdentifier));
+
+        if (it == entries.end() || ! (it->second.identity == identity))
+            return false;
+
+        for (auto& d : it->second.descriptions)
+            result.add(new juce::PluginDescription(d));
+
+        return true;
+    }
+
+    void store(const juce::String& formatName, const juce::String& fileOrIdentifier, const FileIdentity& identity,
+               const juce::OwnedArray<juce::PluginDescription>& found)
+    {
+        Entry entry;
+        entry.formatName = formatName;
+        entry.fileOrIdentifier = fileOrIdentifier;
+        entry.identity = identity;
+
+        for (auto* d : found)
+            entry.descriptions.push_back(*d);
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        entries[getKey(formatName, fileOrIdentifier)] = std::move(entry);
+        needsSaving = true;
+    }
+
+    void clear()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        needsSaving = true;
+    }
+
+    void saveIfNeeded()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        if (! needsSaving)
+            return;
+
+        juce::XmlElement xml("PLUGINSCANCACHE");
+        xml.setAttribute("version", cacheVersion);
+
+        for (auto& [key, entry] : entries)
+        {
+            auto* e = xml.createNewChildElement("ENTRY");
+            e->setAttribute("format", entry.formatName);
+            e->setAttribute("path", entry.fileOrIdentifier);
+            e->setAttribute("size", juce::String(entry.identity.size));
+            e->setAttribute("modified", juce::String(entry.identity.modificationTime));
+
+            if (entry.identity.hash.isNotEmpty())
+                e->setAttribute("hash", entry.identity.hash);
+
+            for (auto& d : entry.descriptions)
+                e->addChildElement(d.createXml().release());
+        }
+
+        if (xml.writeTo(cacheFile))
+            needsSaving = false;
+    }
+
+private:
+    static constexpr int cacheVersion = 1;
+
+    struct Entry
+    {
+        juce::String formatName, fileOrIdentifier;
+        FileIdentity identity;
+        std::vector<juce::PluginDescription> descriptions;
+    };
+
+    juce::File cacheFile;
+    mutable std::mutex mutex;
+    std::map<juce::String, Entry> entries;
+    bool needsSaving = false;
+    std::atomic<bool> usesContentHash { false };
+
+    static juce::String getKey(const juce::String& formatName, const juce::String& fileOrIdentifier)
+    {
+        return formatName + "|" + fileOrIdentifier;
+    }
+
+    void load()
+    {
+        auto xml = juce::parseXMLIfTagMatches(cacheFile, "PLUGINSCANCACHE");
+
+        // anything from an older layout is simply rescanned
+        if (xml == nullptr || xml->getIntAttribute("version") != cacheVersion)
+            return;
+
+        for (auto* e : xml->getChildWithTagNameIterator("ENTRY"))
+        {
+            Entry entry;
+            entry.formatName = e->getStringAttribute("format");
+            entry.fileOrIdentifier = e->getStringAttribute("path");
+            entry.identity.size = e->getStringAttribute("size").getLargeIntValue();
+            entry.identity.modificationTime = e->getStringAttribute("modified").getLargeIntValue();
+            entry.identity.hash = e->getStringAttribute("hash");
+
+            for (auto* child : e->getChildIterator())
+            {
+                juce::PluginDescription d;
+
+                if (d.loadFromXml(*child))
+                    entry.descriptions.push_back(d);
+            }
+
+            entries[getKey(entry.formatName, entry.fileOrIdentifier)] = std::move(entry);
+        }
+    }
+};
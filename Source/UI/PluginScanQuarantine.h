@@ -0,0 +1,245 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <mutex>
+#include "MainHostWindow.h"
+#include "PluginScanCache.h"
+
+// Records how long each plugin file or bundle took to scan and how the scan ended, and keeps the ones
+// that crashed or blew the scan-time budget in quarantine.
+// A failed scan still puts the file on the KnownPluginList's blacklist, which is what stops later scans
+// from touching it. The quarantine decides when it gets another go: never, once the file has changed
+// (usually an update), or also after a back-off that doubles with each failure.
+// Files left in JUCE's dead-man's pedal by a crashed in-process scan are taken in as crashes too.
+// Safe to use from several scanning threads at once.
+class PluginScanQuarantine
+{
+public:
+    enum class Outcome
+    {
+        succeeded,
+        crashed,
+        timedOut
+    };
+
+    enum class RetryPolicy
+    {
+        never,
+        whenChanged,
+        whenChangedOrAfterBackoff
+    };
+
+    explicit PluginScanQuarantine(juce::File fileToUse) : file(std::move(fileToUse))
+    {
+        load();
+    }
+
+    static RetryPolicy getRetryPolicy()
+    {
+        return (RetryPolicy) juce::jlimit(0, 2, getAppProperties().getUserSettings()->getIntValue("pluginQuarantineRetryPolicy",
+                                                                                                  (int) RetryPolicy::whenChangedOrAfterBackoff));
+    }
+
+    static void setRetryPolicy(RetryPolicy policy)
+    {
+        getAppProperties().getUserSettings()->setValue("pluginQuarantineRetryPolicy", (int) policy);
+    }
+
+    void record(const juce::String& formatName, const juce::String& fileOrIdentifier, Outcome outcome, double seconds)
+    {
+        const auto identity = PluginScanCache::identify(fileOrIdentifier, false);
+
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+
+            auto& e = entries[fileOrIdentifier];
+            e.formatName = formatName;
+            e.outcome = outcome;
+            e.lastScanSeconds = seconds;
+            e.lastAttempt = juce::Time::getCurrentTime();
+            e.size = identity.has_value() ? identity->size : 0;
+            e.modificationTime = identity.has_value() ? identity->modificationTime : 0;
+            e.numFailures = outcome == Outcome::succeeded ? 0 : e.numFailures + 1;
+
+            needsSaving = true;
+        }
+
+        if (outcome == Outcome::crashed)
+            juce::Logger::writeToLog("Quarantined " + fileOrIdentifier + " after it crashed the scanner");
+        else if (outcome == Outcome::timedOut)
+            juce::Logger::writeToLog("Quarantined " + fileOrIdentifier + " after it took more than "
+                                     + juce::String(juce::roundToInt(seconds)) + " s to scan");
+        else if (seconds >= slowScanSeconds)
+            juce::Logger::writeToLog("Scanning " + fileOrIdentifier + " took " + juce::String(seconds, 1) + " s");
+    }
+
+    // takes in whatever a crashed in-process scan left in the dead-man's pedal file
+    void takeInDeadMansPedal(const juce::File& pedalFile)
+    {
+        juce::StringArray lines;
+        pedalFile.readLines(lines);
+        lines.removeEmptyStrings();
+
+        for (auto& line : lines)
+            if (! isQuarantined(line))
+                record({}, line, Outcome::crashed, 0.0);
+    }
+
+    bool isQuarantined(const juce::String& fileOrIdentifier) const
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(fileOrIdentifier);
+        return it != entries.end() && it->second.outcome != Outcome::succeeded;
+    }
+
+    // Takes files off the list's blacklist once the retry policy says they've earned another scan.
+    // Pass a file to consider only that one. Returns the number released.
+    int releaseDue(juce::KnownPluginList& list, const juce::String& onlyThisFile = {})
+    {
+        const auto policy = getRetryPolicy();
+        int numReleased = 0;
+
+        if (policy == RetryPolicy::never)
+            return 0;
+
+        for (auto& blacklisted : list.getBlacklistedFiles())
+        {
+            if (onlyThisFile.isNotEmpty() && blacklisted != onlyThisFile)
+                continue;
+
+            if (! isDue(blacklisted, policy))
+                continue;
+
+            list.removeFromBlacklist(blacklisted);
+            juce::Logger::writeToLog("Released " + blacklisted + " from quarantine for another scan");
+            ++numReleased;
+        }
+
+        return numReleased;
+    }
+
+    void saveIfNeeded()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        if (! needsSaving)
+            return;
+
+        juce::XmlElement xml("PLUGINSCANQUARANTINE");
+        xml.setAttribute("version", fileVersion);
+
+        for (auto& [path, e] : entries)
+        {
+            auto* child = xml.createNewChildElement("FILE");
+            child->setAttribute("path", path);
+            child->setAttribute("format", e.formatName);
+            child->setAttribute("outcome", toString(e.outcome));
+            child->setAttribute("seconds", e.lastScanSeconds);
+            child->setAttribute("failures", e.numFailures);
+            child->setAttribute("lastAttempt", juce::String(e.lastAttempt.toMilliseconds()));
+            child->setAttribute("size", juce::String(e.size));
+            child->setAttribute("modified", juce::String(e.modificationTime));
+        }
+
+        if (xml.writeTo(file))
+            needsSaving = false;
+    }
+
+private:
+    static constexpr int fileVersion = 1;
+    static constexpr double slowScanSeconds = 5.0;
+    static constexpr int maxBackoffDays = 30;
+
+    struct Entry
+    {
+        juce::String formatName;
+        Outcome outcome = Outcome::succeeded;
+        double lastScanSeconds = 0.0;
+        int numFailures = 0;
+        juce::Time lastAttempt;
+        juce::int64 size = 0, modificationTime = 0;
+    };
+
+    const juce::File file;
+    mutable std::mutex mutex;
+    std::map<juce::String, Entry> entries;
+    bool needsSaving = false;
+
+    bool isDue(const juce::String& fileOrIdentifier, RetryPolicy policy) const
+    {
+        const auto identity = PluginScanCache::identify(fileOrIdentifier, false);
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(fileOrIdentifier);
+
+        // blacklisted by hand, or before there was a quarantine; that's the user's call
+        if (it == entries.end() || it->second.outcome == Outcome::succeeded)
+            return false;
+
+        const auto& e = it->second;
+
+        if (identity.has_value() && (identity->size != e.size || identity->modificationTime != e.modificationTime))
+            return true;
+
+        if (policy != RetryPolicy::whenChangedOrAfterBackoff)
+            return false;
+
+        const auto backoffDays = juce::jmin(maxBackoffDays, 1 << juce::jlimit(0, 5, e.numFailures - 1));
+        return juce::Time::getCurrentTime() - e.lastAttempt >= juce::RelativeTime::days(backoffDays);
+    }
+
+    static juce::String toString(Outcome outcome)
+    {
+        switch (outcome)
+        {
+            case Outcome::crashed:      return "crashed";
+            case Outcome::timedOut:     return "timedOut";
+            case Outcome::succeeded:    break;
+        }
+
+        return "succeeded";
+    }
+
+    static Outcome outcomeFromString(const juce::String& s)
+    {
+        if (s == "crashed")     return Outcome::crashed;
+        if (s == "timedOut")    return Outcome::timedOut;
+
+        return Outcome::succeeded;
+    }
+
+    void load()
+    {
+        auto xml = juce::parseXMLIfTagMatches(file, "PLUGINSCANQUARANTINE");
+
+        if (xml == nullptr || xml->getIntAttribute("version") != fileVersion)
+            return;
+
+        for (auto* child : xml->getChildWithTagNameIterator("FILE"))
+        {
+            Entry e;
+            e.formatName = child->getStringAttribute("format");
+            e.outcome = outcomeFromString(child->getStringAttribute("outcome"));
+            e.lastScanSeconds = child->getDoubleAttribute("seconds");
+            e.numFailures = child->getIntAttribute("failures");
+            e.lastAttempt = juce::Time(child->getStringAttribute("lastAttempt").getLargeIntValue());
+            e.size = child->getStringAttribute("size").getLargeIntValue();
+            e.modificationTime = child->getStringAttribute("modified").getLargeIntValue();
+
+            entries[child->getStringAttribute("path")] = e;
+        }
+    }
+};
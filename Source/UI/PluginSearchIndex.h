@@ -0,0 +1,200 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// A type-ahead index over the known plugins' names, manufacturers, categories and formats.
+// Every word is broken into trigrams, plus its first one and two characters for short queries, and each
+// one maps to the plugins that contain it. A search only has to walk the lists for the query's own grams,
+// so it costs microseconds however many plugins there are. Matches are ranked by how many of the query's
+// grams they share, weighted by field, so a typo or a missing word still finds the plugin.
+class PluginSearchIndex
+{
+public:
+    struct Match
+    {
+        int index;
+        float score;
+    };
+
+    void rebuild(const juce::Array<juce::PluginDescription>& typesToIndex)
+    {
+        types.assign(typesToIndex.begin(), typesToIndex.end());
+        postings.clear();
+        names.clear();
+
+        for (int i = 0; i < (int) types.size(); ++i)
+        {
+            const auto& t = types[(size_t) i];
+            const juce::String fields[] = { t.name, t.manufacturerName, t.category, t.pluginFormatName };
+
+            // one posting per gram and plugin, remembering the best field it appeared in
+            std::unordered_map<Key, float> best;
+
+            for (int f = 0; f < numFields; ++f)
+                forEachGram(normalise(fields[f]), [&](Key key)
+                {
+                    auto& weight = best[key];
+                    weight = juce::jmax(weight, fieldWeights[f]);
+                });
+
+            for (auto& [key, weight] : best)
+                postings[key].push_back({ i, weight });
+
+            names.push_back(normalise(t.name));
+        }
+
+        scores.assign(types.size(), 0.0f);
+        counts.assign(types.size(), 0);
+    }
+
+    int getNumTypes() const noexcept                                { return (int) types.size(); }
+    const juce::PluginDescription& getType(int index) const         { return types[(size_t) index]; }
+
+    // best first; a plugin has to share at least half the query's grams to count as a match
+    std::vector<Match> search(const juce::String& query, int maxResults) const
+    {
+        const auto q = normalise(query);
+        std::vector<Key> keys;
+        forEachGram(q, [&](Key key) { keys.push_back(key); });
+
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        if (keys.empty())
+            return {};
+
+        touched.clear();
+
+        for (auto key : keys)
+        {
+            auto it = postings.find(key);
+
+            if (it == postings.end())
+                continue;
+
+            for (auto& p : it->second)
+            {
+                if (counts[(size_t) p.index]++ == 0)
+                    touched.push_back(p.index);
+
+                scores[(size_t) p.index] += p.weight;
+            }
+        }
+
+        std::vector<Match> matches;
+
+        for (auto i : touched)
+        {
+            auto score = scores[(size_t) i];
+            const auto numShared = counts[(size_t) i];
+            scores[(size_t) i] = 0.0f;
+            counts[(size_t) i] = 0;
+
+            if (numShared * 2 < (int) keys.size())
+                continue;
+
+            // typing the start of the name is the strongest hint there is
+            const auto& name = names[(size_t) i];
+
+            if (name.startsWith(q))
+                score += 8.0f;
+            else if (name.contains(q))
+                score += 4.0f;
+
+            matches.push_back({ i, score });
+        }
+
+        const auto numResults = juce::jmin((size_t) juce::jmax(0, maxResults), matches.size());
+
+        std::partial_sort(matches.begin(), matches.begin() + (std::ptrdiff_t) numResults, matches.end(),
+                          [this](const Match& a, const Match& b)
+                          {
+                              if (! juce::approximatelyEqual(a.score, b.score))
+                                  return a.score > b.score;
+
+                              // shorter names are the more specific match
+                              return names[(size_t) a.index].length() < names[(size_t) b.index].length();
+                          });
+
+        matches.resize(numResults);
+        return matches;
+    }
+
+private:
+    enum { nameField, manufacturerField, categoryField, formatField, numFields };
+    static constexpr float fieldWeights[numFields] = { 4.0f, 2.0f, 1.0f, 1.0f };
+
+    // three 21-bit characters, with the top bit marking a word prefix rather than a trigram
+    using Key = juce::uint64;
+
+    struct Posting
+    {
+        int index;
+        float weight;
+    };
+
+    std::vector<juce::PluginDescription> types;
+    std::vector<juce::String> names;
+    std::unordered_map<Key, std::vector<Posting>> postings;
+
+    mutable std::vector<float> scores;
+    mutable std::vector<int> counts, touched;
+
+    static juce::String normalise(const juce::String& s)
+    {
+        auto lower = s.toLowerCase();
+        juce::String result;
+        result.preallocateBytes(lower.getNumBytesAsUTF8());
+
+        for (auto c : lower)
+            result += juce::CharacterFunctions::isLetterOrDigit(c) ? c : (juce::juce_wchar) ' ';
+
+        return result.trim();
+    }
+
+    static Key pack(const juce::juce_wchar* chars, int numChars, bool isPrefix)
+    {
+        Key key = isPrefix ? (Key) 1 << 63 : 0;
+
+        for (int i = 0; i < numChars; ++i)
+            key |= (Key) (chars[i] & 0x1fffff) << (21 * i);
+
+        return key;
+    }
+
+    template <typename Callback>
+    static void forEachGram(const juce::String& text, Callback&& callback)
+    {
+        for (auto& word : juce::StringArray::fromTokens(text, " ", {}))
+        {
+            if (word.isEmpty())
+                continue;
+
+            std::vector<juce::juce_wchar> chars;
+
+            for (auto c : word)
+                chars.push_back(c);
+
+            for (int n = 1; n <= 2 && n <= (int) chars.size(); ++n)
+                callback(pack(chars.data(), n, true));
+
+            for (size_t i = 0; i + 3 <= chars.size(); ++i)
+                callback(pack(chars.data() + i, 3, false));
+        }
+    }
+};
@@ -0,0 +1,155 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include "MainHostWindow.h"
+
+// The message-thread half of the per-node watchdog in HostedPluginInstance.
+// Keeps every hosted plugin's watchdog options in line with the user settings, notices when one
+// trips (the audio thread has already bypassed it by then), and re-arms it after the cool-down.
+// Listeners get a change message whenever the set of bypassed nodes changes.
+class PluginWatchdog : public juce::ChangeBroadcaster, private juce::Timer
+{
+public:
+    explicit PluginWatchdog(PluginGraph& g) : graph(g)
+    {
+        startTimer(pollIntervalMs);
+    }
+
+    ~PluginWatchdog() override
+    {
+        stopTimer();
+    }
+
+    // settings
+    static double getBudgetShare()       { return getAppProperties().getUserSettings()->getDoubleValue("watchdogBudgetShare", 0.0); }
+    static int getCooldownSeconds()      { return getAppProperties().getUserSettings()->getIntValue("watchdogCooldownSeconds", 0); }
+
+    static void setBudgetShare(double share)       { getAppProperties().getUserSettings()->setValue("watchdogBudgetShare", share); }
+    static void setCooldownSeconds(int seconds)    { getAppProperties().getUserSettings()->setValue("watchdogCooldownSeconds", seconds); }
+
+    struct TrippedNode
+    {
+        AudioProcessorGraph::NodeID nodeID;
+        juce::String name;
+    };
+
+    std::vector<TrippedNode> getTrippedNodes() const
+    {
+        std::vector<TrippedNode> tripped;
+
+        for (auto* node : graph.graph.getNodes())
+            if (auto* hosted = dynamic_cast<HostedPluginInstance*>(node->getProcessor()))
+                if (hosted->isWatchdogTripped())
+                    tripped.push_back({ node->nodeID, hosted->getName() });
+
+        return tripped;
+    }
+
+    void rearm(AudioProcessorGraph::NodeID nodeID)
+    {
+        if (auto* node = graph.graph.getNodeForId(nodeID))
+        {
+            if (auto* hosted = dynamic_cast<HostedPluginInstance*>(node->getProcessor()))
+            {
+                hosted->rearmWatchdog();
+                juce::Logger::writeToLog("Watchdog re-armed " + hosted->getName());
+            }
+        }
+
+        timerCallback();
+    }
+
+    void rearmAll()
+    {
+        for (auto& t : getTrippedNodes())
+            rearm(t.nodeID);
+    }
+
+    // the name of the plugin that tripped most recently, for notifications
+    const juce::String& getLastTrippedName() const { return lastTrippedName; }
+
+private:
+    static constexpr int pollIntervalMs = 250;
+
+    struct NodeState
+    {
+        int tripCount = 0;
+        juce::uint32 trippedAtMs = 0;
+        bool tripped = false;
+    };
+
+    PluginGraph& graph;
+    std::map<juce::uint32, NodeState> states;
+    juce::String lastTrippedName;
+
+    void timerCallback() override
+    {
+        HostedPluginInstance::WatchdogOptions options;
+        options.budgetShare = getBudgetShare();
+        options.windowSize = getAppProperties().getUserSettings()->getIntValue("watchdogWindowBlocks", options.windowSize);
+        options.maxOverruns = getAppProperties().getUserSettings()->getIntValue("watchdogMaxOverruns", options.maxOverruns);
+
+        const auto cooldownMs = (juce::uint32) juce::jmax(0, getCooldownSeconds()) * 1000;
+        const auto now = juce::Time::getMillisecondCounter();
+        bool changed = false;
+
+        std::map<juce::uint32, NodeState> newStates;
+
+        for (auto* node : graph.graph.getNodes())
+        {
+            auto* hosted = dynamic_cast<HostedPluginInstance*>(node->getProcessor());
+
+            if (hosted == nullptr)
+                continue;
+
+            // cheap enough to do every time, and it picks up nodes added since the last poll
+            hosted->setWatchdogOptions(options);
+
+            auto state = states[node->nodeID.uid];
+            const auto tripCount = hosted->getWatchdogTripCount();
+
+            // a node that was recreated starts counting again from zero
+            if (tripCount > state.tripCount)
+            {
+                state.trippedAtMs = now;
+                lastTrippedName = hosted->getName();
+
+                juce::Logger::writeToLog("Watchdog bypassed " + lastTrippedName + " after it took "
+                                         + juce::String(juce::roundToInt(hosted->getWatchdogTripLoad() * 100.0))
+                                         + "% of the buffer period");
+            }
+
+            state.tripCount = tripCount;
+
+            if (hosted->isWatchdogTripped() && cooldownMs > 0 && now - state.trippedAtMs >= cooldownMs)
+            {
+                hosted->rearmWatchdog();
+                juce::Logger::writeToLog("Watchdog re-armed " + hosted->getName() + " after its cool-down");
+            }
+
+            const auto tripped = hosted->isWatchdogTripped();
+            changed = changed || tripped != state.tripped;
+            state.tripped = tripped;
+
+            newStates[node->nodeID.uid] = state;
+        }
+
+        states.swap(newStates);
+
+        if (changed)
+            sendChangeMessage();
+    }
+};
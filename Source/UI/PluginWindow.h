@@ -48,6 +48,7 @@
 
 #include "../Plugins/IOConfigurationWindow.h"
 #include "../Plugins/ARAPlugin.h"
+#include "../Plugins/HostedPluginInstance.h"
 
 inline String getFormatSuffix (const AudioProcessor* plugin)
 {
@@ -290,9 +291,13 @@ private:
 
     float getDesktopScaleFactor() const override     { return 1.0f; }
 
-    static AudioProcessorEditor* createProcessorEditor (AudioProcessor& processor,
+    static AudioProcessorEditor* createProcessorEditor (AudioProcessor& hostedProcessor,
                                                         PluginWindow::Type type)
     {
+        // editors that talk to the plugin directly need the plugin itself, not Curve's wrapper around it
+        auto& processor = type == PluginWindow::Type::audioIO ? hostedProcessor
+                                                              : HostedPluginInstance::unwrap (hostedProcessor);
+
         if (type == PluginWindow::Type::normal)
         {
             if (processor.hasEditor())
@@ -0,0 +1,217 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "MainHostWindow.h"
+#include "AudioResilienceManager.h"
+#include "../Plugins/SimulatedAudioIODevice.h"
+
+// Measures how long the AudioResilienceManager takes to get audio going again, by running it against a
+// simulated device type and failing the devices on cue (curve --benchmark-recovery).
+// Device A is the saved target and device B is its failover. Each trial injects one fault and waits for
+// the first record from the manager's telemetry that expects audio, then reports the time from the fault
+// to detection, and from detection to the first audio callback.
+// It uses its own device manager, and must be run with a settings file of its own, because the manager
+// reads the saved target from the settings. The app quits with the results when it's done.
+class RecoveryBenchmark : private juce::Timer
+{
+public:
+    RecoveryBenchmark()
+    {
+        auto type = std::make_unique<SimulatedAudioIODeviceType>();
+        simulated = type.get();
+        deviceManager.addAudioDeviceType(std::move(type));
+
+        // without a device type of its own, the manager only has the simulated one
+        deviceManager.setCurrentAudioDeviceType(simulated->getTypeName(), false);
+
+        juce::AudioDeviceManager::AudioDeviceSetup setup;
+        setup.outputDeviceName = setup.inputDeviceName = targetName;
+        setup.sampleRate = 48000.0;
+        setup.bufferSize = 256;
+        deviceManager.initialise(2, 2, nullptr, false, {}, &setup);
+
+        auto* settings = getAppProperties().getUserSettings();
+        settings->setValue("keepFailoverStandbyOpen", false);
+        settings->setValue("audioDeviceState", deviceManager.createStateXml().get());
+
+        resilienceManager = std::make_unique<AudioResilienceManager>(deviceManager, nullptr, [this]
+        {
+            return juce::Array<AudioResilienceManager::DeviceChoice> { { simulated->getTypeName(), failoverName, failoverName } };
+        });
+
+        resilienceManager->getTelemetry().onRecordFinished = [this](const ResilienceTelemetry::Record& r) { recordFinished(r); };
+
+        for (int i = 0; i < numTrials; ++i)
+        {
+            trials.push_back({ "target vanishes", [this] { simulated->setDevicePresent(targetName, false); } });
+            trials.push_back({ "target returns", [this] { simulated->setDevicePresent(targetName, true); } });
+        }
+
+        for (int i = 0; i < numTrials; ++i)
+            trials.push_back({ "sample rate changes", [this, i] { simulated->setSupportedSampleRate(targetName, i % 2 == 0 ? 44100.0 : 48000.0); } });
+
+        // only the safety-net poll notices these, so they take a while
+        for (int i = 0; i < numStallTrials; ++i)
+            trials.push_back({ "driver stalls", [this] { simulated->setSupportedSampleRate(targetName, 0.0); simulated->stall(targetName); } });
+
+        std::cout << "Waiting for the resilience manager to warm up..." << std::endl;
+        startTimer(warmUpMs);
+    }
+
+    ~RecoveryBenchmark() override
+    {
+        stopTimer();
+        resilienceManager = nullptr;
+        deviceManager.closeAudioDevice();
+    }
+
+private:
+    static constexpr const char* targetName = "Simulated Device A";
+    static constexpr const char* failoverName = "Simulated Device B";
+    static constexpr int numTrials = 6;
+    static constexpr int numStallTrials = 3;
+    static constexpr int warmUpMs = 6000;
+    static constexpr int settleMs = 1000;
+    static constexpr double trialTimeoutMs = 20000.0;
+
+    struct Trial
+    {
+        juce::String scenario;
+        std::function<void()> inject;
+        double faultMs = 0.0;
+        juce::String handledAs;
+        double detectionMs = -1.0, recoveryMs = -1.0;
+    };
+
+    juce::AudioDeviceManager deviceManager;
+    SimulatedAudioIODeviceType* simulated = nullptr;
+    std::unique_ptr<AudioResilienceManager> resilienceManager;
+    std::vector<Trial> trials;
+    size_t currentTrial = 0;
+    bool isRunningTrial = false;
+
+    void timerCallback() override
+    {
+        if (isRunningTrial)
+        {
+            auto& t = trials[currentTrial];
+
+            if (juce::Time::getMillisecondCounterHiRes() - t.faultMs < trialTimeoutMs)
+                return;
+
+            t.handledAs = "timed out";
+            finishTrial();
+            return;
+        }
+
+        if (currentTrial >= trials.size())
+        {
+            stopTimer();
+            report();
+            return;
+        }
+
+        auto& t = trials[currentTrial];
+        isRunningTrial = true;
+        t.faultMs = juce::Time::getMillisecondCounterHiRes();
+        t.inject();
+        startTimer(100);
+    }
+
+    void recordFinished(const ResilienceTelemetry::Record& r)
+    {
+        if (! isRunningTrial || r.event == ResilienceTelemetry::Event::disconnect
+                             || r.event == ResilienceTelemetry::Event::forcedNullDevice)
+            return;
+
+        auto& t = trials[currentTrial];
+
+        // anything detected before the fault belongs to the previous trial
+        if (r.detectedMs < t.faultMs)
+            return;
+
+        t.handledAs = ResilienceTelemetry::toString(r.event);
+        t.detectionMs = r.detectedMs - t.faultMs;
+        t.recoveryMs = r.recoveryMs;
+        finishTrial();
+    }
+
+    void finishTrial()
+    {
+        isRunningTrial = false;
+        ++currentTrial;
+        startTimer(settleMs);
+    }
+
+    static double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty())
+            return -1.0;
+
+        std::sort(values.begin(), values.end());
+        return values[juce::jmin(values.size() - 1, (size_t) ((double) values.size() * p))];
+    }
+
+    void report()
+    {
+        std::cout << "Device recovery, simulated devices, 256 samples @ 48000 Hz" << std::endl;
+        std::cout << "scenario               handled as               trials   detect ms   median ms   max ms" << std::endl;
+
+        int numFailed = 0;
+        juce::StringArray scenarios;
+
+        for (auto& t : trials)
+            scenarios.addIfNotAlreadyThere(t.scenario);
+
+        for (auto& scenario : scenarios)
+        {
+            std::vector<double> detection, recovery;
+            juce::StringArray handledAs;
+
+            for (auto& t : trials)
+            {
+                if (t.scenario != scenario)
+                    continue;
+
+                handledAs.addIfNotAlreadyThere(t.handledAs);
+
+                if (t.recoveryMs < 0.0)
+                {
+                    ++numFailed;
+                    continue;
+                }
+
+                detection.push_back(t.detectionMs);
+                recovery.push_back(t.recoveryMs);
+            }
+
+            std::cout << scenario.paddedRight(' ', 23)
+                      << handledAs.joinIntoString(", ").paddedRight(' ', 25)
+                      << juce::String((int) recovery.size()).paddedLeft(' ', 6)
+                      << juce::String(percentile(detection, 0.5), 1).paddedLeft(' ', 12)
+                      << juce::String(percentile(recovery, 0.5), 1).paddedLeft(' ', 12)
+                      << juce::String(percentile(recovery, 1.0), 1).paddedLeft(' ', 9) << std::endl;
+        }
+
+        if (numFailed > 0)
+            std::cout << numFailed << " trial(s) didn't get audio back" << std::endl;
+
+        juce::JUCEApplication::getInstance()->setApplicationReturnValue(numFailed > 0 ? 1 : 0);
+        juce::JUCEApplication::quit();
+    }
+};
@@ -0,0 +1,174 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <deque>
+#include <functional>
+#include "SilentAudioCallback.h"
+
+// Records what the AudioResilienceManager noticed and did, and how long it took from the moment a problem
+// was detected until audio was flowing again.
+// Every record except a disconnect or a forced null device waits for the first audio callback after it.
+// That callback is noticed by a silent callback that only sits on the device manager while a record is
+// waiting, so there's no cost while everything is working. Finished records are written to the log.
+class ResilienceTelemetry : private juce::Timer
+{
+public:
+    enum class Event
+    {
+        disconnect,
+        reconnect,
+        wakeFromSleep,
+        forcedNullDevice,
+        enforcedConfiguration,
+        failover
+    };
+
+    struct Record
+    {
+        Event event;
+        juce::String deviceName;
+        double detectedMs = 0.0;    // on the Time::getMillisecondCounterHiRes() clock
+        double actionMs = 0.0;      // how long the call that handled it took
+        double recoveryMs = -1.0;   // detection to first audio; negative if audio never came, or isn't expected
+        bool isFinished = false;
+    };
+
+    explicit ResilienceTelemetry(juce::AudioDeviceManager& dm) : deviceManager(dm) {}
+
+    ~ResilienceTelemetry() override
+    {
+        stopWaiting();
+    }
+
+    // call once the event has been handled, so that only audio from after it counts
+    void record(Event event, const juce::String& deviceName, double detectedMs, double actionMs = 0.0)
+    {
+        // anything still waiting has already had its audio, from before this event
+        if (isWaiting && probe.hasProcessed())
+            timerCallback();
+
+        Record r { event, deviceName, detectedMs, actionMs };
+        r.isFinished = ! expectsAudio(event);
+
+        records.push_back(r);
+
+        if (records.size() > maxRecords)
+            records.pop_front();
+
+        if (r.isFinished)
+        {
+            finished(records.back());
+            return;
+        }
+
+        if (! isWaiting)
+        {
+            probe.reset();
+            waitStartedMs = juce::Time::getMillisecondCounterHiRes();
+            deviceManager.addAudioCallback(&probe);
+            isWaiting = true;
+        }
+
+        startTimer(pollIntervalMs);
+    }
+
+    const std::deque<Record>& getRecords() const noexcept       { return records; }
+
+    // called on the message thread as each record finishes
+    std::function<void(const Record&)> onRecordFinished;
+
+    static juce::String toString(Event event)
+    {
+        switch (event)
+        {
+            case Event::disconnect:             return "disconnect";
+            case Event::reconnect:              return "reconnect";
+            case Event::wakeFromSleep:          return "wake from sleep";
+            case Event::forcedNullDevice:       return "forced null device";
+            case Event::enforcedConfiguration:  return "enforced configuration";
+            case Event::failover:               return "failover";
+        }
+
+        return {};
+    }
+
+private:
+    static constexpr int pollIntervalMs = 10;
+    static constexpr double maxWaitMs = 15000.0;
+    static constexpr size_t maxRecords = 256;
+
+    juce::AudioDeviceManager& deviceManager;
+    std::deque<Record> records;
+    bool isWaiting = false;
+    double waitStartedMs = 0.0;
+    SilentAudioCallback probe;
+
+    static bool expectsAudio(Event event)
+    {
+        return event != Event::disconnect && event != Event::forcedNullDevice;
+    }
+
+    void timerCallback() override
+    {
+        const auto audioAtMs = probe.getFirstBlockMs();
+        const auto timedOut = juce::Time::getMillisecondCounterHiRes() - waitStartedMs >= maxWaitMs;
+
+        if (audioAtMs == 0.0 && ! timedOut)
+            return;
+
+        stopWaiting();
+
+        for (auto& r : records)
+        {
+            if (r.isFinished)
+                continue;
+
+            r.recoveryMs = audioAtMs > 0.0 ? audioAtMs - r.detectedMs : -1.0;
+            r.isFinished = true;
+            finished(r);
+        }
+    }
+
+    void stopWaiting()
+    {
+        stopTimer();
+
+        if (isWaiting)
+            deviceManager.removeAudioCallback(&probe);
+
+        isWaiting = false;
+    }
+
+    void finished(const Record& r)
+    {
+        juce::String message("Audio resilience: " + toString(r.event));
+
+        if (r.deviceName.isNotEmpty())
+            message << " (" << r.deviceName << ")";
+
+        if (r.actionMs > 0.0)
+            message << ", handled in " << juce::String(r.actionMs, 1) << " ms";
+
+        if (r.recoveryMs >= 0.0)
+            message << ", audio " << juce::String(r.recoveryMs, 1) << " ms after detection";
+        else if (expectsAudio(r.event))
+            message << ", no audio within " << juce::String(juce::roundToInt(maxWaitMs / 1000.0)) << " s";
+
+        juce::Logger::writeToLog(message);
+
+        if (onRecordFinished != nullptr)
+            onRecordFinished(r);
+    }
+};
@@ -0,0 +1,48 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// An audio callback that only outputs silence, for keeping a device running with nothing to play, or for
+// noticing from the message thread when a device starts processing. It remembers when it first
+// processed a block since it was last reset, which the message thread can poll.
+class SilentAudioCallback : public juce::AudioIODeviceCallback
+{
+public:
+    // forgets any earlier blocks, so that only audio from now on counts
+    void reset() noexcept                       { firstBlockMs.store(0.0, std::memory_order_relaxed); }
+
+    // when the first block since reset() was processed, on the Time::getMillisecondCounterHiRes() clock,
+    // or 0 if there hasn't been one
+    double getFirstBlockMs() const noexcept     { return firstBlockMs.load(std::memory_order_relaxed); }
+    bool hasProcessed() const noexcept          { return getFirstBlockMs() != 0.0; }
+
+    void audioDeviceIOCallbackWithContext(const float* const*, int, float* const* outputChannelData, int numOutputChannels,
+                                          int numSamples, const juce::AudioIODeviceCallbackContext&) override
+    {
+        // the device manager sums every callback's output, so this one has to add silence
+        for (int i = 0; i < numOutputChannels; ++i)
+            if (outputChannelData[i] != nullptr)
+                juce::FloatVectorOperations::clear(outputChannelData[i], numSamples);
+
+        if (firstBlockMs.load(std::memory_order_relaxed) == 0.0)
+            firstBlockMs.store(juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+    }
+
+    void audioDeviceAboutToStart(juce::AudioIODevice*) override {}
+    void audioDeviceStopped() override {}
+
+private:
+    std::atomic<double> firstBlockMs { 0.0 };
+};
@@ -0,0 +1,125 @@
+/*
+==============================================================================
+   Copyright (c) Thomas Derham
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   CURVE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+#include "SilentAudioCallback.h"
+
+// Times each phase of startup, from launch to the first audio callback and on through whatever was
+// deferred until audio was running, and writes them to the log as one summary.
+// Phases are marked on the message thread. The first callback is noticed by a silent callback that sits
+// on the device manager only until then.
+class StartupProfiler : private juce::Timer
+{
+public:
+    StartupProfiler() : launchMs(juce::Time::getMillisecondCounterHiRes()), lastMarkMs(launchMs) {}
+
+    ~StartupProfiler() override
+    {
+        stopWaiting();
+    }
+
+    // records the time since the previous mark against this phase
+    void mark(const juce::String& phase)
+    {
+        if (summaryWritten)
+            return;
+
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        phases.push_back({ phase, now - lastMarkMs });
+        lastMarkMs = now;
+    }
+
+    // Calls back on the message thread once the device has processed its first block, or after a few
+    // seconds if it never does (no device, or one that failed to open), then writes the summary.
+    void whenAudioIsRunning(juce::AudioDeviceManager& dm, std::function<void()> callback)
+    {
+        stopWaiting();
+
+        deviceManager = &dm;
+        onAudioRunning = std::move(callback);
+        waitStartedMs = juce::Time::getMillisecondCounter();
+        probe.reset();
+
+        deviceManager->addAudioCallback(&probe);
+        startTimer(pollIntervalMs);
+    }
+
+    // call before the device manager goes away
+    void stopWaiting()
+    {
+        stopTimer();
+
+        if (deviceManager != nullptr)
+            deviceManager->removeAudioCallback(&probe);
+
+        deviceManager = nullptr;
+        onAudioRunning = nullptr;
+    }
+
+private:
+    static constexpr int pollIntervalMs = 10;
+    static constexpr int maxWaitMs = 5000;
+
+    struct Phase
+    {
+        juce::String name;
+        double durationMs;
+    };
+
+    const double launchMs;
+    double lastMarkMs;
+    std::vector<Phase> phases;
+    bool summaryWritten = false;
+
+    juce::AudioDeviceManager* deviceManager = nullptr;
+    std::function<void()> onAudioRunning;
+    juce::uint32 waitStartedMs = 0;
+    SilentAudioCallback probe;
+
+    void timerCallback() override
+    {
+        const auto audioHasRun = probe.hasProcessed();
+        const auto timedOut = juce::Time::getMillisecondCounter() - waitStartedMs >= (juce::uint32) maxWaitMs;
+
+        if (! audioHasRun && ! timedOut)
+            return;
+
+        auto callback = std::move(onAudioRunning);
+
+        stopWaiting();
+        mark(audioHasRun ? "first audio callback" : "no audio callback within " + juce::String(maxWaitMs / 1000) + " s");
+
+        if (callback != nullptr)
+            callback();
+
+        writeSummary();
+    }
+
+    void writeSummary()
+    {
+        if (summaryWritten)
+            return;
+
+        summaryWritten = true;
+
+        juce::String summary("Startup took " + juce::String(juce::roundToInt(lastMarkMs - launchMs)) + " ms:");
+
+        for (auto& phase : phases)
+            summary << juce::newLine << "  " << juce::String(phase.durationMs, 1).paddedLeft(' ', 8) << " ms  " << phase.name;
+
+        juce::Logger::writeToLog(summary);
+    }
+};
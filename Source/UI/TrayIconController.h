@@ -13,6 +13,7 @@
 
 #include "MainHostWindow.h"
 #include "GraphEditorPanel.h"
+#include "PluginWatchdog.h"
 
 inline std::unique_ptr<InputStream> createAssetInputStream (const char* resourcePath)
 {
@@ -62,6 +63,9 @@ public:
 
         if (auto* g = mainWindow.graphHolder->graph.get())
             g->addChangeListener (this);
+
+        if (auto* w = mainWindow.getPluginWatchdog())
+            w->addChangeListener (this);
     }
 
     void mouseUp(const juce::MouseEvent&) override
@@ -85,6 +89,21 @@ public:
                 else
                     menu.addItem("Show Editor", [this] { mainWindow.setVisible(true); mainWindow.toFront(true); });
 
+                // plugins the watchdog has taken out of the signal path
+                if (auto* w = mainWindow.getPluginWatchdog())
+                {
+                    auto tripped = w->getTrippedNodes();
+
+                    if (! tripped.empty())
+                    {
+                        menu.addSeparator();
+                        menu.addSectionHeader("Bypassed by watchdog");
+
+                        for (auto& t : tripped)
+                            menu.addItem("Re-arm " + t.name, [this, nodeID = t.nodeID] { if (auto* wd = mainWindow.getPluginWatchdog()) wd->rearm(nodeID); });
+                    }
+                }
+
                 menu.addSeparator();
                 menu.addSectionHeader("Presets");
                 addPresetsToMenu(menu);
@@ -92,6 +111,7 @@ public:
                 menu.addSeparator();
                 menu.addItem("Save as preset", [this] { mainWindow.saveAsPreset(); });
                 menu.addItem("Audio settings", [this] { mainWindow.showAudioSettings(); });
+                menu.addItem("Calibrate buffer size", [this] { mainWindow.calibrateBufferSize(); });
                 menu.addItem("Plugin manager", [this] { mainWindow.showPluginListWindow(); });
 
                 menu.addSeparator();
@@ -113,17 +133,40 @@ public:
                 if (source == g)
                     currentLoadedPreset = g->getFile(); // update local currentLoadedPreset when graph change occurs
             }
+
+            if (auto* w = mainWindow.getPluginWatchdog()) {
+                if (source == w)
+                    updateWatchdogStatus(*w);
+            }
         }
 
     ~TrayIconController() override
         {
             if (auto* g = mainWindow.graphHolder->graph.get())
                 g->removeChangeListener (this);
+
+            if (auto* w = mainWindow.getPluginWatchdog())
+                w->removeChangeListener (this);
         }
 
 private:
     MainHostWindow& mainWindow;
     juce::File currentLoadedPreset;
+    size_t numWatchdogBypassed = 0;
+
+    void updateWatchdogStatus(PluginWatchdog& watchdog)
+        {
+            auto numBypassed = watchdog.getTrippedNodes().size();
+
+            setIconTooltip(numBypassed > 0 ? "Curve - " + juce::String((int) numBypassed) + " plugin(s) bypassed by watchdog"
+                                           : juce::String("Curve"));
+
+            // only notify when something new has been bypassed, not when plugins are re-armed
+            if (numBypassed > numWatchdogBypassed)
+                showInfoBubble("Plugin bypassed", watchdog.getLastTrippedName() + " kept running over its time budget and has been bypassed.");
+
+            numWatchdogBypassed = numBypassed;
+        }
 
     void addPresetsToMenu(juce::PopupMenu& menu)
         {